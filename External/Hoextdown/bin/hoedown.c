@@ -0,0 +1,669 @@
+/* hoedown.c - command line driver, rendering files and directory trees
+ *
+ * It isn't part of the app. Build it on its own, from External/Hoextdown:
+ *
+ *	cc -O2 -pthread -I. -o hoedown bin/hoedown.c *.c
+ *
+ * Inputs are mapped rather than read, and rendered on a pool of threads
+ * with the extensions and flags of the app's preview (SPMarkdownParser). */
+
+#include "document.h"
+#include "html.h"
+#include "context_test.h"
+#include "version.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/*************
+ * CONSTANTS *
+ *************/
+
+/* the preview's settings, see SPMarkdownParser.m */
+#define DEF_EXTENSIONS (HOEDOWN_EXT_AUTOLINK | HOEDOWN_EXT_FENCED_CODE | \
+	HOEDOWN_EXT_FOOTNOTES | HOEDOWN_EXT_TABLES | HOEDOWN_EXT_SPAN | \
+	HOEDOWN_EXT_SANITIZE_UTF8)
+#define DEF_HTML_FLAGS (HOEDOWN_HTML_SKIP_HTML | HOEDOWN_HTML_USE_TASK_LIST)
+#define DEF_MAX_NESTING 16
+#define DEF_TOC_LEVEL 6
+
+#define DEF_OUNIT 64
+#define WRITE_UNIT (1024 * 1024)
+
+enum renderer_type {
+	RENDERER_HTML,
+	RENDERER_HTML_TOC,
+	RENDERER_CONTEXT_TEST
+};
+
+
+/*********
+ * TYPES *
+ *********/
+
+struct option_data {
+	enum renderer_type renderer;
+	int smartypants;
+	int toc_level;
+	unsigned int threads;
+	const char *output_dir;
+	int timing;
+};
+
+/* render_job • one input, along with its output until it is written */
+struct render_job {
+	char *path;
+	char *out_path;	/* NULL when writing to stdout */
+	size_t in_size;
+	hoedown_buffer *ob;
+	int failed;
+	int done;
+};
+
+struct render_pool {
+	const struct option_data *opts;
+	struct render_job *jobs;
+	size_t count;
+	size_t alloc;
+	size_t next;
+	unsigned int doc_threads;	/* threads of each document, when there are fewer inputs than threads */
+	pthread_mutex_t lock;
+	pthread_cond_t done;
+};
+
+/* output • stdout, written a large chunk at a time */
+struct output {
+	hoedown_buffer *buf;
+	int failed;
+};
+
+
+/********************
+ * INPUT COLLECTION *
+ ********************/
+
+static int
+has_markdown_extension(const char *name)
+{
+	static const char *extensions[] = { ".md", ".markdown", ".txt" };
+	const char *dot = strrchr(name, '.');
+	size_t i;
+
+	if (!dot)
+		return 0;
+
+	for (i = 0; i < sizeof(extensions) / sizeof(extensions[0]); ++i)
+		if (strcmp(dot, extensions[i]) == 0)
+			return 1;
+
+	return 0;
+}
+
+/* output_path • the output of rel in dir, with an .html extension */
+static char *
+output_path(const char *dir, const char *rel)
+{
+	const char *dot = strrchr(rel, '.'), *slash = strrchr(rel, '/');
+	size_t stem = (dot && (!slash || dot > slash)) ? (size_t)(dot - rel) : strlen(rel);
+	char *path = hoedown_malloc(strlen(dir) + stem + sizeof("/.html"));
+
+	sprintf(path, "%s/%.*s.html", dir, (int)stem, rel);
+	return path;
+}
+
+static void
+add_job(struct render_pool *pool, const char *path, const char *rel)
+{
+	struct render_job *job;
+
+	if (pool->count == pool->alloc) {
+		pool->alloc = pool->alloc ? pool->alloc * 2 : 64;
+		pool->jobs = hoedown_realloc(pool->jobs, pool->alloc * sizeof(struct render_job));
+	}
+
+	job = &pool->jobs[pool->count++];
+	memset(job, 0x0, sizeof(struct render_job));
+	job->path = strdup(path);
+	if (pool->opts->output_dir)
+		job->out_path = output_path(pool->opts->output_dir, rel);
+}
+
+static int
+compare_names(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/* add_directory • add the Markdown files of a tree, in name order; root_len is
+ * the length of the path the output tree mirrors */
+static int
+add_directory(struct render_pool *pool, const char *path, size_t root_len)
+{
+	DIR *dir;
+	struct dirent *entry;
+	char **names = NULL;
+	size_t count = 0, alloc = 0, i;
+	int ret = 1;
+
+	if ((dir = opendir(path)) == NULL) {
+		fprintf(stderr, "hoedown: %s: %s\n", path, strerror(errno));
+		return 0;
+	}
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_name[0] == '.')
+			continue;
+
+		if (count == alloc) {
+			alloc = alloc ? alloc * 2 : 32;
+			names = hoedown_realloc(names, alloc * sizeof(char *));
+		}
+		names[count++] = strdup(entry->d_name);
+	}
+	closedir(dir);
+
+	qsort(names, count, sizeof(char *), compare_names);
+
+	for (i = 0; i < count; ++i) {
+		char *child = hoedown_malloc(strlen(path) + strlen(names[i]) + 2);
+		struct stat st;
+
+		sprintf(child, "%s/%s", path, names[i]);
+
+		if (stat(child, &st) < 0) {
+			fprintf(stderr, "hoedown: %s: %s\n", child, strerror(errno));
+			ret = 0;
+		} else if (S_ISDIR(st.st_mode)) {
+			ret &= add_directory(pool, child, root_len);
+		} else if (S_ISREG(st.st_mode) && has_markdown_extension(names[i])) {
+			add_job(pool, child, child + root_len + 1);
+		}
+
+		free(child);
+		free(names[i]);
+	}
+
+	free(names);
+	return ret;
+}
+
+static int
+add_input(struct render_pool *pool, const char *path)
+{
+	struct stat st;
+	const char *base;
+	size_t len = strlen(path);
+
+	if (stat(path, &st) < 0) {
+		fprintf(stderr, "hoedown: %s: %s\n", path, strerror(errno));
+		return 0;
+	}
+
+	if (S_ISDIR(st.st_mode)) {
+		while (len > 1 && path[len - 1] == '/')
+			len--;
+		return add_directory(pool, path, len);
+	}
+
+	base = strrchr(path, '/');
+	add_job(pool, path, base ? base + 1 : path);
+	return 1;
+}
+
+
+/*************
+ * RENDERING *
+ *************/
+
+/* map_file • map an input read-only, an empty one maps to NULL */
+static int
+map_file(const char *path, const uint8_t **data, size_t *size)
+{
+	struct stat st;
+	void *map;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return 0;
+
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return 0;
+	}
+
+	*data = NULL;
+	*size = st.st_size;
+
+	if (*size) {
+		map = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			close(fd);
+			return 0;
+		}
+
+		madvise(map, *size, MADV_SEQUENTIAL);
+		*data = map;
+	}
+
+	close(fd);
+	return 1;
+}
+
+static int
+write_all(int fd, const uint8_t *data, size_t size)
+{
+	while (size) {
+		ssize_t written = write(fd, data, size);
+
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return 0;
+		}
+
+		data += written;
+		size -= written;
+	}
+
+	return 1;
+}
+
+/* make_parents • create the directories leading to a file */
+static int
+make_parents(char *path)
+{
+	char *slash;
+
+	for (slash = strchr(path + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+		*slash = '\0';
+		if (mkdir(path, 0777) < 0 && errno != EEXIST) {
+			*slash = '/';
+			return 0;
+		}
+		*slash = '/';
+	}
+
+	return 1;
+}
+
+static int
+write_file(char *path, const hoedown_buffer *ob)
+{
+	int fd, ok;
+
+	if (!make_parents(path))
+		return 0;
+
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+		return 0;
+
+	ok = write_all(fd, ob->data, ob->size);
+	return close(fd) == 0 && ok;
+}
+
+/* worker_renderer • the renderer and document of a worker: renderers keep state,
+ * each thread gets its own */
+struct worker_renderer {
+	hoedown_renderer *renderer;
+	hoedown_document *document;
+	int smartypants_pass;	/* the renderer can't do it, the output goes through SmartyPants afterwards */
+};
+
+static void
+worker_renderer_init(struct worker_renderer *wr, const struct render_pool *pool)
+{
+	const struct option_data *opts = pool->opts;
+	unsigned int threads = 1;
+
+	memset(wr, 0x0, sizeof(struct worker_renderer));
+
+	switch (opts->renderer) {
+	case RENDERER_HTML:
+		wr->renderer = hoedown_html_renderer_new(
+			DEF_HTML_FLAGS | (opts->smartypants ? HOEDOWN_HTML_SMARTYPANTS : 0), 0);
+
+		/* the plain renderer keeps no state across blocks */
+		if (!opts->smartypants)
+			threads = pool->doc_threads;
+		break;
+	case RENDERER_HTML_TOC:
+		wr->renderer = hoedown_html_toc_renderer_new(opts->toc_level);
+		wr->smartypants_pass = opts->smartypants;
+		break;
+	case RENDERER_CONTEXT_TEST:
+		wr->renderer = hoedown_context_test_renderer_new(NULL);
+		break;
+	}
+
+	wr->document = hoedown_document_new(wr->renderer, DEF_EXTENSIONS, DEF_MAX_NESTING, 0, NULL, NULL);
+	hoedown_document_set_threads(wr->document, threads);
+
+	if (opts->renderer == RENDERER_CONTEXT_TEST)
+		((hoedown_context_test_renderer_state *)wr->renderer->opaque)->doc = wr->document;
+}
+
+static void
+worker_renderer_free(struct worker_renderer *wr, const struct option_data *opts)
+{
+	hoedown_document_free(wr->document);
+
+	if (opts->renderer == RENDERER_CONTEXT_TEST)
+		hoedown_context_test_renderer_free(wr->renderer);
+	else
+		hoedown_html_renderer_free(wr->renderer);
+}
+
+static void
+render_job(struct render_job *job, struct worker_renderer *wr)
+{
+	const uint8_t *data;
+	size_t size;
+
+	if (!map_file(job->path, &data, &size)) {
+		fprintf(stderr, "hoedown: %s: %s\n", job->path, strerror(errno));
+		job->failed = 1;
+		return;
+	}
+
+	job->in_size = size;
+	job->ob = hoedown_buffer_new(DEF_OUNIT);
+	hoedown_buffer_grow(job->ob, size + (size >> 1));
+	hoedown_document_render(wr->document, job->ob, data, size);
+
+	if (data)
+		munmap((void *)data, size);
+
+	if (wr->smartypants_pass) {
+		hoedown_buffer *ob = hoedown_buffer_new(DEF_OUNIT);
+
+		hoedown_html_smartypants(ob, job->ob->data, job->ob->size);
+		hoedown_buffer_free(job->ob);
+		job->ob = ob;
+	}
+
+	if (job->out_path) {
+		if (!write_file(job->out_path, job->ob)) {
+			fprintf(stderr, "hoedown: %s: %s\n", job->out_path, strerror(errno));
+			job->failed = 1;
+		}
+
+		hoedown_buffer_free(job->ob);
+		job->ob = NULL;
+	}
+}
+
+static void *
+render_worker(void *opaque)
+{
+	struct render_pool *pool = opaque;
+	struct worker_renderer wr;
+	size_t i;
+
+	worker_renderer_init(&wr, pool);
+
+	while ((i = __sync_fetch_and_add(&pool->next, 1)) < pool->count) {
+		struct render_job *job = &pool->jobs[i];
+
+		render_job(job, &wr);
+
+		pthread_mutex_lock(&pool->lock);
+		job->done = 1;
+		pthread_cond_broadcast(&pool->done);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	worker_renderer_free(&wr, pool->opts);
+	return NULL;
+}
+
+
+/**********
+ * OUTPUT *
+ **********/
+
+static void
+output_flush(struct output *out)
+{
+	if (out->buf->size && !write_all(STDOUT_FILENO, out->buf->data, out->buf->size))
+		out->failed = 1;
+	out->buf->size = 0;
+}
+
+/* output_put • buffer small outputs, write large ones through */
+static void
+output_put(struct output *out, const hoedown_buffer *ob)
+{
+	if (out->buf->size + ob->size > WRITE_UNIT)
+		output_flush(out);
+
+	if (ob->size >= WRITE_UNIT) {
+		if (!write_all(STDOUT_FILENO, ob->data, ob->size))
+			out->failed = 1;
+	} else {
+		hoedown_buffer_put(out->buf, ob->data, ob->size);
+	}
+}
+
+/* render_stdin • render standard input to standard output, on the calling thread */
+static int
+render_stdin(struct render_pool *pool, struct output *out)
+{
+	hoedown_buffer *ib = hoedown_buffer_new(WRITE_UNIT);
+	struct render_job job;
+	struct worker_renderer wr;
+
+	if (hoedown_buffer_putf(ib, stdin)) {
+		fprintf(stderr, "hoedown: stdin: %s\n", strerror(errno));
+		hoedown_buffer_free(ib);
+		return 0;
+	}
+
+	memset(&job, 0x0, sizeof(struct render_job));
+	job.in_size = ib->size;
+	job.ob = hoedown_buffer_new(DEF_OUNIT);
+
+	worker_renderer_init(&wr, pool);
+	hoedown_document_render(wr.document, job.ob, ib->data, ib->size);
+
+	if (wr.smartypants_pass) {
+		hoedown_buffer *ob = hoedown_buffer_new(DEF_OUNIT);
+
+		hoedown_html_smartypants(ob, job.ob->data, job.ob->size);
+		hoedown_buffer_free(job.ob);
+		job.ob = ob;
+	}
+
+	worker_renderer_free(&wr, pool->opts);
+	output_put(out, job.ob);
+
+	hoedown_buffer_free(job.ob);
+	hoedown_buffer_free(ib);
+	return 1;
+}
+
+
+/********
+ * MAIN *
+ ********/
+
+static void
+print_help(const char *basename)
+{
+	printf("Usage: %s [OPTION]... [FILE | DIRECTORY]...\n\n", basename);
+	printf("Render Markdown to HTML with the settings of the Simplenote preview.\n");
+	printf("Directories are searched for .md, .markdown and .txt files. Without an\n");
+	printf("output directory, everything is rendered in order to stdout; without\n");
+	printf("input, stdin is.\n\n");
+	printf("Options:\n");
+	printf("  -o, --output=DIR     Write each input to DIR/<name>.html, mirroring directories.\n");
+	printf("  -j, --threads=N      Render on N threads [default: one per core].\n");
+	printf("  -t, --toc[=LEVEL]    Render the Table of Contents of headers up to LEVEL [default: %d].\n", DEF_TOC_LEVEL);
+	printf("  -c, --context-test   Render with the context test renderer.\n");
+	printf("  -s, --smartypants    Apply SmartyPants to the output.\n");
+	printf("  -T, --time           Print the rendered size and time to stderr.\n");
+	printf("  -h, --help           Print this help text.\n");
+	printf("  -v, --version        Print Hoedown version.\n");
+}
+
+static double
+elapsed_since(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int
+main(int argc, char **argv)
+{
+	static const struct option long_options[] = {
+		{ "output", required_argument, NULL, 'o' },
+		{ "threads", required_argument, NULL, 'j' },
+		{ "toc", optional_argument, NULL, 't' },
+		{ "context-test", no_argument, NULL, 'c' },
+		{ "smartypants", no_argument, NULL, 's' },
+		{ "time", no_argument, NULL, 'T' },
+		{ "help", no_argument, NULL, 'h' },
+		{ "version", no_argument, NULL, 'v' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	struct option_data opts;
+	struct render_pool pool;
+	struct output out;
+	struct timespec start;
+	pthread_t *handles;
+	size_t i, in_size = 0;
+	unsigned int t, workers;
+	long cores;
+	int c, ok = 1;
+
+	memset(&opts, 0x0, sizeof(struct option_data));
+	opts.renderer = RENDERER_HTML;
+	cores = sysconf(_SC_NPROCESSORS_ONLN);
+	opts.threads = cores > 0 ? (unsigned int)cores : 1;
+
+	while ((c = getopt_long(argc, argv, "o:j:t::csThv", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'o':
+			opts.output_dir = optarg;
+			break;
+		case 'j':
+			opts.threads = (unsigned int)strtoul(optarg, NULL, 10);
+			if (opts.threads < 1) {
+				fprintf(stderr, "hoedown: invalid thread count: %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 't':
+			opts.renderer = RENDERER_HTML_TOC;
+			opts.toc_level = optarg ? atoi(optarg) : DEF_TOC_LEVEL;
+			break;
+		case 'c':
+			opts.renderer = RENDERER_CONTEXT_TEST;
+			break;
+		case 's':
+			opts.smartypants = 1;
+			break;
+		case 'T':
+			opts.timing = 1;
+			break;
+		case 'h':
+			print_help(argv[0]);
+			return 0;
+		case 'v':
+			printf("Built with Hoedown " HOEDOWN_VERSION ".\n");
+			return 0;
+		default:
+			fprintf(stderr, "Try '%s --help' for more information.\n", argv[0]);
+			return 1;
+		}
+	}
+
+	memset(&pool, 0x0, sizeof(struct render_pool));
+	pool.opts = &opts;
+	pool.doc_threads = 1;
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.done, NULL);
+
+	out.buf = hoedown_buffer_new(WRITE_UNIT);
+	out.failed = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (optind == argc)
+		ok = render_stdin(&pool, &out);
+
+	for (i = optind; i < (size_t)argc; ++i)
+		ok &= add_input(&pool, argv[i]);
+
+	if (pool.count) {
+		/* with fewer inputs than threads, split the documents instead */
+		workers = opts.threads < pool.count ? opts.threads : (unsigned int)pool.count;
+		pool.doc_threads = opts.threads / workers;
+
+		handles = hoedown_calloc(workers, sizeof(pthread_t));
+		for (t = 0; t < workers; ++t) {
+			if (pthread_create(&handles[t], NULL, render_worker, &pool) != 0) {
+				fprintf(stderr, "hoedown: cannot create thread: %s\n", strerror(errno));
+				return 1;
+			}
+		}
+
+		/* outputs to stdout are written in order, as soon as they are there */
+		for (i = 0; i < pool.count; ++i) {
+			struct render_job *job = &pool.jobs[i];
+
+			pthread_mutex_lock(&pool.lock);
+			while (!job->done)
+				pthread_cond_wait(&pool.done, &pool.lock);
+			pthread_mutex_unlock(&pool.lock);
+
+			if (job->ob) {
+				output_put(&out, job->ob);
+				hoedown_buffer_free(job->ob);
+			}
+
+			in_size += job->in_size;
+			ok &= !job->failed;
+		}
+
+		for (t = 0; t < workers; ++t)
+			pthread_join(handles[t], NULL);
+		free(handles);
+	}
+
+	output_flush(&out);
+	if (out.failed) {
+		fprintf(stderr, "hoedown: stdout: %s\n", strerror(errno));
+		ok = 0;
+	}
+
+	if (opts.timing)
+		fprintf(stderr, "%zu files, %zu bytes rendered in %.3f s\n",
+			pool.count, in_size, elapsed_since(&start));
+
+	/* cleanup */
+	for (i = 0; i < pool.count; ++i) {
+		free(pool.jobs[i].path);
+		free(pool.jobs[i].out_path);
+	}
+	free(pool.jobs);
+	hoedown_buffer_free(out.buf);
+	pthread_mutex_destroy(&pool.lock);
+	pthread_cond_destroy(&pool.done);
+
+	return ok ? 0 : 1;
+}
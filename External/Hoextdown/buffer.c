@@ -5,6 +5,18 @@
 #include <string.h>
 #include <assert.h>
 
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(__SSSE3__) || (defined(__ARM_NEON) && defined(__aarch64__))
+#define HOEDOWN_UTF8_VECTOR 1
+#endif
+
 void *
 hoedown_malloc(size_t size)
 {
@@ -306,3 +318,342 @@ void hoedown_buffer_put_utf8(hoedown_buffer *buf, unsigned int c) {
 		HOEDOWN_BUFPUTSL(buf, "\xef\xbf\xbd");
 	}
 }
+
+void
+hoedown_buffer_put_utf16(hoedown_buffer *buf, const uint16_t *data, size_t size)
+{
+	size_t i = 0;
+	uint8_t *out;
+
+	assert(buf && buf->unit);
+
+	/* no code unit takes more than three bytes; a pair takes four */
+	hoedown_buffer_grow(buf, buf->size + size * 3);
+	out = buf->data + buf->size;
+
+	while (i < size) {
+		unsigned int c = data[i++];
+
+		if (c < 0x80) {
+			*out++ = c;
+
+			/* markdown is mostly ASCII, copy it without branching on width */
+			while (i < size && data[i] < 0x80)
+				*out++ = (uint8_t)data[i++];
+			continue;
+		}
+
+		if (c < 0x800) {
+			*out++ = 0xC0 | (c >> 6);
+			*out++ = 0x80 | (c & 0x3F);
+			continue;
+		}
+
+		if (c - 0xD800u < 0x800) {
+			/* a lone surrogate is replaced with U+FFFD */
+			if (c >= 0xDC00 || i >= size || data[i] - 0xDC00u >= 0x400) {
+				*out++ = 0xEF;
+				*out++ = 0xBF;
+				*out++ = 0xBD;
+				continue;
+			}
+
+			c = 0x10000 + ((c - 0xD800) << 10) + (data[i++] - 0xDC00);
+			*out++ = 0xF0 | (c >> 18);
+			*out++ = 0x80 | ((c >> 12) & 0x3F);
+			*out++ = 0x80 | ((c >> 6) & 0x3F);
+			*out++ = 0x80 | (c & 0x3F);
+			continue;
+		}
+
+		*out++ = 0xE0 | (c >> 12);
+		*out++ = 0x80 | ((c >> 6) & 0x3F);
+		*out++ = 0x80 | (c & 0x3F);
+	}
+
+	buf->size = out - buf->data;
+}
+
+/* utf8_plain_run • length of the leading run of ASCII other than NUL,
+ * sixteen bytes at a time where the target has a vector unit */
+static size_t
+utf8_plain_run(const uint8_t *data, size_t size)
+{
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 16 <= size; i += 16) {
+			__m128i chunk = _mm_loadu_si128((const __m128i *)(data + i));
+			/* high bit set, or NUL */
+			unsigned int mask = (unsigned int)(_mm_movemask_epi8(chunk) |
+				_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero)));
+
+			if (mask)
+				return i + __builtin_ctz(mask);
+		}
+	}
+#elif defined(__ARM_NEON)
+	{
+		const uint8x16_t one = vdupq_n_u8(1), last = vdupq_n_u8(0x7E);
+		for (; i + 16 <= size; i += 16) {
+			/* NUL wraps around to 0xFF, so both fall above 0x7E */
+			uint8x16_t bad = vcgtq_u8(vsubq_u8(vld1q_u8(data + i), one), last);
+			/* narrow each byte of the comparison to a nibble */
+			uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+				vshrn_n_u16(vreinterpretq_u16_u8(bad), 4)), 0);
+
+			if (mask)
+				return i + (__builtin_ctzll(mask) >> 2);
+		}
+	}
+#endif
+
+	while (i < size && data[i] - 1u < 0x7F)
+		i++;
+
+	return i;
+}
+
+/* utf8_sequence • length of the well-formed sequence starting data, or 0
+ * with the length of its ill-formed prefix in *bad (NUL counts as one) */
+static size_t
+utf8_sequence(const uint8_t *data, size_t size, size_t *bad)
+{
+	size_t i, n;
+	uint8_t lo = 0x80, hi = 0xBF;
+
+	if (data[0] != 0 && data[0] < 0x80)
+		return 1;
+
+	if (data[0] >= 0xC2 && data[0] <= 0xDF) {
+		n = 2;
+	} else if (data[0] >= 0xE0 && data[0] <= 0xEF) {
+		n = 3;
+		if (data[0] == 0xE0) lo = 0xA0;
+		if (data[0] == 0xED) hi = 0x9F;
+	} else if (data[0] >= 0xF0 && data[0] <= 0xF4) {
+		n = 4;
+		if (data[0] == 0xF0) lo = 0x90;
+		if (data[0] == 0xF4) hi = 0x8F;
+	} else {
+		*bad = 1;
+		return 0;
+	}
+
+	/* the replaced prefix is the lead and the continuation bytes that fit */
+	for (i = 1; i < n; i++) {
+		if (i >= size || data[i] < lo || data[i] > hi) {
+			*bad = i;
+			return 0;
+		}
+		lo = 0x80;
+		hi = 0xBF;
+	}
+
+	return n;
+}
+
+#ifdef HOEDOWN_UTF8_VECTOR
+
+/* Error classes of the lookup validation by Keiser and Lemire ("Validating
+ * UTF-8 In Less Than One Instruction Per Byte"): the nibbles of each byte
+ * and of the byte before it select classes from three tables, and only an
+ * ill-formed pair of bytes has a class in common in all of them. */
+#define UTF8_TOO_SHORT	(1 << 0)
+#define UTF8_TOO_LONG	(1 << 1)
+#define UTF8_OVERLONG_3	(1 << 2)
+#define UTF8_TOO_LARGE	(1 << 3)
+#define UTF8_SURROGATE	(1 << 4)
+#define UTF8_OVERLONG_2	(1 << 5)
+#define UTF8_TOO_LARGE_1000	(1 << 6)
+#define UTF8_OVERLONG_4	(1 << 6)
+#define UTF8_TWO_CONTS	(1 << 7)
+#define UTF8_CARRY	(UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+static const uint8_t UTF8_BYTE_1_HIGH[16] = {
+	/* 0___ ASCII */
+	UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+	UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+	/* 10__ continuation */
+	UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+	/* 1100, 1101 two byte lead */
+	UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+	UTF8_TOO_SHORT,
+	/* 1110 three byte lead */
+	UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+	/* 1111 four byte lead */
+	UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+};
+
+static const uint8_t UTF8_BYTE_1_LOW[16] = {
+	UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+	UTF8_CARRY | UTF8_OVERLONG_2,
+	UTF8_CARRY,
+	UTF8_CARRY,
+	UTF8_CARRY | UTF8_TOO_LARGE,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+};
+
+static const uint8_t UTF8_BYTE_2_HIGH[16] = {
+	/* 0___ ASCII */
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+	/* 1000 */
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+	/* 1001 */
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+	/* 101_ */
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+	/* 11__ lead */
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+};
+
+/* a lead in the last three bytes of a block that needs more than are left */
+static const uint8_t UTF8_INCOMPLETE[16] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1
+};
+
+#if defined(__SSSE3__)
+typedef __m128i utf8_vec;
+#define utf8_load(p)	_mm_loadu_si128((const __m128i *)(p))
+#define utf8_splat(c)	_mm_set1_epi8((char)(c))
+#define utf8_and(a, b)	_mm_and_si128((a), (b))
+#define utf8_or(a, b)	_mm_or_si128((a), (b))
+#define utf8_xor(a, b)	_mm_xor_si128((a), (b))
+#define utf8_subs(a, b)	_mm_subs_epu8((a), (b))
+#define utf8_is_zero(a)	_mm_cmpeq_epi8((a), _mm_setzero_si128())
+#define utf8_high(a)	_mm_and_si128(_mm_srli_epi16((a), 4), utf8_splat(0x0F))
+#define utf8_lookup(t, a)	_mm_shuffle_epi8(utf8_load(t), (a))
+#define utf8_prev(a, prev, n)	_mm_alignr_epi8((a), (prev), 16 - (n))
+#define utf8_any(a)	(_mm_movemask_epi8(utf8_is_zero(a)) != 0xFFFF)
+#define utf8_any_high(a)	(_mm_movemask_epi8(a) != 0)
+#else
+typedef uint8x16_t utf8_vec;
+#define utf8_load(p)	vld1q_u8(p)
+#define utf8_splat(c)	vdupq_n_u8(c)
+#define utf8_and(a, b)	vandq_u8((a), (b))
+#define utf8_or(a, b)	vorrq_u8((a), (b))
+#define utf8_xor(a, b)	veorq_u8((a), (b))
+#define utf8_subs(a, b)	vqsubq_u8((a), (b))
+#define utf8_is_zero(a)	vceqq_u8((a), vdupq_n_u8(0))
+#define utf8_high(a)	vshrq_n_u8((a), 4)
+#define utf8_lookup(t, a)	vqtbl1q_u8(utf8_load(t), (a))
+#define utf8_prev(a, prev, n)	vextq_u8((prev), (a), 16 - (n))
+#define utf8_any(a)	(vmaxvq_u8(a) != 0)
+#define utf8_any_high(a)	(vmaxvq_u8(a) >= 0x80)
+#endif
+
+/* utf8_vector_valid • checks sixteen bytes at a time, returning an offset
+ * before which data is well-formed and free of NUL; the sequence there
+ * and everything after it is left to the byte by byte check */
+static size_t
+utf8_vector_valid(const uint8_t *data, size_t size)
+{
+	utf8_vec prev = utf8_splat(0), prev_incomplete = utf8_splat(0);
+	size_t i, k;
+
+	for (i = 0; i + 16 <= size; i += 16) {
+		utf8_vec input = utf8_load(data + i);
+		utf8_vec nul = utf8_is_zero(input);
+		utf8_vec prev1, error, must23;
+
+		/* ASCII only has to complete the sequence before it */
+		if (!utf8_any_high(utf8_or(input, nul))) {
+			if (utf8_any(prev_incomplete))
+				break;
+			prev = input;
+			continue;
+		}
+
+		prev1 = utf8_prev(input, prev, 1);
+		error = utf8_and(utf8_and(
+			utf8_lookup(UTF8_BYTE_1_HIGH, utf8_high(prev1)),
+			utf8_lookup(UTF8_BYTE_1_LOW, utf8_and(prev1, utf8_splat(0x0F)))),
+			utf8_lookup(UTF8_BYTE_2_HIGH, utf8_high(input)));
+
+		/* the third and fourth bytes of a sequence must be continuations */
+		must23 = utf8_or(
+			utf8_subs(utf8_prev(input, prev, 2), utf8_splat(0xE0 - 0x80)),
+			utf8_subs(utf8_prev(input, prev, 3), utf8_splat(0xF0 - 0x80)));
+		error = utf8_xor(utf8_and(must23, utf8_splat(0x80)), error);
+
+		if (utf8_any(utf8_or(error, nul)))
+			break;
+
+		prev_incomplete = utf8_subs(input, utf8_load(UTF8_INCOMPLETE));
+		prev = input;
+	}
+
+	/* step back to the lead of a sequence cut by the last block */
+	if (utf8_any(prev_incomplete)) {
+		for (k = 1; k <= 3; k++) {
+			if (data[i - k] >= 0xC0) {
+				i -= k;
+				break;
+			}
+		}
+	}
+
+	return i;
+}
+
+#endif
+
+size_t
+hoedown_utf8_valid_length(const uint8_t *data, size_t size)
+{
+	size_t i = 0, n, bad;
+
+#ifdef HOEDOWN_UTF8_VECTOR
+	i = utf8_vector_valid(data, size);
+#endif
+
+	while (1) {
+		i += utf8_plain_run(data + i, size - i);
+		if (i >= size)
+			return size;
+
+		if ((n = utf8_sequence(data + i, size - i, &bad)) == 0)
+			return i;
+
+		i += n;
+	}
+}
+
+void
+hoedown_buffer_put_utf8_repaired(hoedown_buffer *buf, const uint8_t *data, size_t size)
+{
+	size_t i = 0, n, bad;
+
+	assert(buf && buf->unit);
+
+	/* U+FFFD is three bytes and replaces at least one */
+	hoedown_buffer_grow(buf, buf->size + size + (size >> 2));
+
+	while (i < size) {
+		n = hoedown_utf8_valid_length(data + i, size - i);
+		hoedown_buffer_put(buf, data + i, n);
+		i += n;
+
+		if (i >= size)
+			break;
+
+		utf8_sequence(data + i, size - i, &bad);
+		HOEDOWN_BUFPUTSL(buf, "\xef\xbf\xbd");
+		i += bad;
+	}
+}
@@ -110,6 +110,18 @@ void hoedown_buffer_printf(hoedown_buffer *buf, const char *fmt, ...) __attribut
 /* hoedown_buffer_put_utf8: put a Unicode character encoded as UTF-8 */
 void hoedown_buffer_put_utf8(hoedown_buffer *buf, unsigned int codepoint);
 
+/* hoedown_buffer_put_utf16: append UTF-16 code units transcoded to UTF-8,
+ * replacing unpaired surrogates with U+FFFD */
+void hoedown_buffer_put_utf16(hoedown_buffer *buf, const uint16_t *data, size_t size);
+
+/* hoedown_utf8_valid_length: length of the leading part of data that is
+ * well-formed UTF-8 without NUL bytes, size when all of it is */
+size_t hoedown_utf8_valid_length(const uint8_t *data, size_t size);
+
+/* hoedown_buffer_put_utf8_repaired: append data, replacing NUL bytes and
+ * ill-formed UTF-8 (each maximal invalid subpart) with U+FFFD */
+void hoedown_buffer_put_utf8_repaired(hoedown_buffer *buf, const uint8_t *data, size_t size);
+
 /* hoedown_buffer_free: free the buffer */
 void hoedown_buffer_free(hoedown_buffer *buf);
 
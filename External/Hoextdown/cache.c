@@ -0,0 +1,657 @@
+#include "cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#define HOEDOWN_CACHE_MIN_BUCKETS 64
+
+/* Secrets of the key hash, odd and with mixed bit patterns */
+#define CACHE_K0 0xa0761d6478bd642fULL
+#define CACHE_K1 0xe7037ed1a0b428dbULL
+#define CACHE_K2 0x8ebc6af09c88c6e3ULL
+#define CACHE_K3 0x589965cc75374cc3ULL
+
+#define HOEDOWN_CACHE_FILE_MAGIC 0x31434448 /* "HDC1" */
+#define HOEDOWN_CACHE_FILE_MIN_SLOTS 256
+
+struct hoedown_cache_entry {
+	hoedown_cache_key key;
+	struct hoedown_cache_entry *chain;
+	struct hoedown_cache_entry *newer;
+	struct hoedown_cache_entry *older;
+	size_t size;
+	uint8_t data[];
+};
+
+struct hoedown_cache {
+	pthread_mutex_t lock;
+
+	struct hoedown_cache_entry **buckets;
+	size_t bucket_count;
+
+	/* Recency list, the oldest entry is evicted first */
+	struct hoedown_cache_entry *newest;
+	struct hoedown_cache_entry *oldest;
+
+	hoedown_cache_stats stats;
+};
+
+/* Every record starts on an eight byte boundary, past the file header */
+struct hoedown_cache_file_header {
+	uint32_t magic;
+	uint32_t generation;
+	uint64_t reserved;
+};
+
+struct hoedown_cache_record {
+	hoedown_cache_key key;
+	uint32_t size;
+	uint32_t check;
+};
+
+/* Open addressed, an offset of zero marks an empty slot (the file header is there) */
+struct hoedown_cache_file_slot {
+	hoedown_cache_key key;
+	size_t offset;
+};
+
+struct hoedown_cache_file {
+	int fd;
+	char *path;
+	uint32_t generation;
+
+	/* Mapped once for the largest size, so appends show up without remapping */
+	uint8_t *map;
+	size_t max_size;
+	size_t size;
+	size_t live;
+
+	struct hoedown_cache_file_slot *slots;
+	size_t slot_count;
+	size_t slot_used;
+};
+
+
+/************
+ * KEY HASH *
+ ************/
+
+/* cache_mix • multiply into 128 bits and fold, each operand spreads over the whole result */
+static inline uint64_t
+cache_mix(uint64_t a, uint64_t b)
+{
+	__uint128_t r = (__uint128_t)a * b;
+	return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+static inline uint64_t
+cache_read64(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof v);
+	return v;
+}
+
+hoedown_cache_key
+hoedown_cache_key_make(const uint8_t *data, size_t size,
+	unsigned int extensions, unsigned int html_flags, unsigned int variant)
+{
+	hoedown_cache_key key;
+	uint8_t tail[16] = { 0 };
+	uint64_t seed = ((uint64_t)extensions << 32 | html_flags) ^ cache_mix(variant ^ CACHE_K2, CACHE_K3);
+	uint64_t lo = seed ^ CACHE_K0;
+	uint64_t hi = seed ^ CACHE_K1 ^ size;
+	size_t i = 0;
+
+	/* Two lanes over the same sixteen bytes, so the key is 128 bits wide throughout */
+	for (; i + 16 <= size; i += 16) {
+		uint64_t a = cache_read64(data + i);
+		uint64_t b = cache_read64(data + i + 8);
+		lo = cache_mix(a ^ CACHE_K2, b ^ lo);
+		hi = cache_mix(b ^ CACHE_K3, a ^ hi);
+	}
+
+	if (i < size) {
+		memcpy(tail, data + i, size - i);
+		lo = cache_mix(cache_read64(tail) ^ CACHE_K2, cache_read64(tail + 8) ^ lo);
+		hi = cache_mix(cache_read64(tail + 8) ^ CACHE_K3, cache_read64(tail) ^ hi);
+	}
+
+	key.lo = cache_mix(lo ^ CACHE_K0, hi ^ size);
+	key.hi = cache_mix(hi ^ CACHE_K1, key.lo);
+	return key;
+}
+
+
+/***********
+ * ENTRIES *
+ ***********/
+
+static inline size_t
+entry_size(const struct hoedown_cache_entry *entry)
+{
+	return sizeof(struct hoedown_cache_entry) + entry->size;
+}
+
+static inline struct hoedown_cache_entry **
+find_entry(hoedown_cache *cache, hoedown_cache_key key)
+{
+	struct hoedown_cache_entry **slot = &cache->buckets[key.lo & (cache->bucket_count - 1)];
+
+	while (*slot && ((*slot)->key.lo != key.lo || (*slot)->key.hi != key.hi))
+		slot = &(*slot)->chain;
+
+	return slot;
+}
+
+static void
+unlink_entry(hoedown_cache *cache, struct hoedown_cache_entry *entry)
+{
+	if (entry->newer) entry->newer->older = entry->older;
+	else cache->newest = entry->older;
+
+	if (entry->older) entry->older->newer = entry->newer;
+	else cache->oldest = entry->newer;
+}
+
+static void
+push_entry(hoedown_cache *cache, struct hoedown_cache_entry *entry)
+{
+	entry->newer = NULL;
+	entry->older = cache->newest;
+
+	if (cache->newest) cache->newest->newer = entry;
+	else cache->oldest = entry;
+
+	cache->newest = entry;
+}
+
+/* remove_entry • take an entry out of its chain and the recency list, and free it */
+static void
+remove_entry(hoedown_cache *cache, struct hoedown_cache_entry **slot)
+{
+	struct hoedown_cache_entry *entry = *slot;
+
+	*slot = entry->chain;
+	unlink_entry(cache, entry);
+
+	cache->stats.count--;
+	cache->stats.size -= entry_size(entry);
+	free(entry);
+}
+
+static void
+grow_buckets(hoedown_cache *cache)
+{
+	size_t bucket_count = cache->bucket_count * 2;
+	struct hoedown_cache_entry **buckets = hoedown_calloc(bucket_count, sizeof(struct hoedown_cache_entry *));
+	size_t i;
+
+	for (i = 0; i < cache->bucket_count; i++) {
+		struct hoedown_cache_entry *entry = cache->buckets[i];
+
+		while (entry) {
+			struct hoedown_cache_entry *next = entry->chain;
+			struct hoedown_cache_entry **slot = &buckets[entry->key.lo & (bucket_count - 1)];
+
+			entry->chain = *slot;
+			*slot = entry;
+			entry = next;
+		}
+	}
+
+	free(cache->buckets);
+	cache->buckets = buckets;
+	cache->bucket_count = bucket_count;
+}
+
+
+/*********
+ * CACHE *
+ *********/
+
+hoedown_cache *
+hoedown_cache_new(size_t max_size)
+{
+	hoedown_cache *cache = hoedown_calloc(1, sizeof(hoedown_cache));
+
+	pthread_mutex_init(&cache->lock, NULL);
+	cache->bucket_count = HOEDOWN_CACHE_MIN_BUCKETS;
+	cache->buckets = hoedown_calloc(cache->bucket_count, sizeof(struct hoedown_cache_entry *));
+	cache->stats.max_size = max_size;
+
+	return cache;
+}
+
+int
+hoedown_cache_get(hoedown_cache *cache, hoedown_cache_key key, hoedown_buffer *ob)
+{
+	struct hoedown_cache_entry *entry;
+
+	assert(cache && ob);
+
+	pthread_mutex_lock(&cache->lock);
+
+	entry = *find_entry(cache, key);
+	if (!entry) {
+		cache->stats.misses++;
+		pthread_mutex_unlock(&cache->lock);
+		return 0;
+	}
+
+	cache->stats.hits++;
+	if (entry != cache->newest) {
+		unlink_entry(cache, entry);
+		push_entry(cache, entry);
+	}
+
+	/* Copy under the lock, a concurrent put may evict the entry right after */
+	hoedown_buffer_put(ob, entry->data, entry->size);
+
+	pthread_mutex_unlock(&cache->lock);
+	return 1;
+}
+
+void
+hoedown_cache_put(hoedown_cache *cache, hoedown_cache_key key, const uint8_t *data, size_t size)
+{
+	struct hoedown_cache_entry *entry;
+	struct hoedown_cache_entry **slot;
+
+	assert(cache);
+
+	if (sizeof(struct hoedown_cache_entry) + size > cache->stats.max_size)
+		return;
+
+	/* Allocate and fill outside of the lock, only linking needs it */
+	entry = hoedown_malloc(sizeof(struct hoedown_cache_entry) + size);
+	entry->key = key;
+	entry->size = size;
+	memcpy(entry->data, data, size);
+
+	pthread_mutex_lock(&cache->lock);
+
+	slot = find_entry(cache, key);
+	if (*slot)
+		remove_entry(cache, slot);
+
+	while (cache->oldest && cache->stats.size + entry_size(entry) > cache->stats.max_size) {
+		remove_entry(cache, find_entry(cache, cache->oldest->key));
+		cache->stats.evictions++;
+	}
+
+	if (cache->stats.count >= cache->bucket_count)
+		grow_buckets(cache);
+
+	slot = &cache->buckets[key.lo & (cache->bucket_count - 1)];
+	entry->chain = *slot;
+	*slot = entry;
+	push_entry(cache, entry);
+
+	cache->stats.count++;
+	cache->stats.size += entry_size(entry);
+
+	pthread_mutex_unlock(&cache->lock);
+}
+
+void
+hoedown_cache_clear(hoedown_cache *cache)
+{
+	assert(cache);
+
+	pthread_mutex_lock(&cache->lock);
+
+	while (cache->oldest)
+		remove_entry(cache, find_entry(cache, cache->oldest->key));
+
+	pthread_mutex_unlock(&cache->lock);
+}
+
+void
+hoedown_cache_get_stats(hoedown_cache *cache, hoedown_cache_stats *stats)
+{
+	assert(cache && stats);
+
+	pthread_mutex_lock(&cache->lock);
+	*stats = cache->stats;
+	pthread_mutex_unlock(&cache->lock);
+}
+
+void
+hoedown_cache_free(hoedown_cache *cache)
+{
+	if (!cache) return;
+
+	hoedown_cache_clear(cache);
+	pthread_mutex_destroy(&cache->lock);
+	free(cache->buckets);
+	free(cache);
+}
+
+
+/**************
+ * CACHE FILE *
+ **************/
+
+static inline size_t
+record_size(size_t size)
+{
+	return (sizeof(struct hoedown_cache_record) + size + 7) & ~(size_t)7;
+}
+
+/* record_check • tells a complete record header from the garbage left by an interrupted write */
+static inline uint32_t
+record_check(hoedown_cache_key key, uint32_t size)
+{
+	return (uint32_t)cache_mix(key.lo ^ size ^ CACHE_K0, key.hi ^ CACHE_K1);
+}
+
+static struct hoedown_cache_file_slot *
+find_file_slot(hoedown_cache_file *file, hoedown_cache_key key)
+{
+	size_t mask = file->slot_count - 1;
+	size_t i = key.lo & mask;
+
+	while (file->slots[i].offset &&
+		(file->slots[i].key.lo != key.lo || file->slots[i].key.hi != key.hi))
+		i = (i + 1) & mask;
+
+	return &file->slots[i];
+}
+
+static void
+grow_file_slots(hoedown_cache_file *file)
+{
+	struct hoedown_cache_file_slot *slots = file->slots;
+	size_t slot_count = file->slot_count;
+	size_t i;
+
+	file->slot_count = slot_count * 2;
+	file->slots = hoedown_calloc(file->slot_count, sizeof(struct hoedown_cache_file_slot));
+
+	for (i = 0; i < slot_count; i++)
+		if (slots[i].offset)
+			*find_file_slot(file, slots[i].key) = slots[i];
+
+	free(slots);
+}
+
+/* index_record • point a key at its latest record, the one it replaces becomes dead space */
+static void
+index_record(hoedown_cache_file *file, hoedown_cache_key key, size_t offset, size_t size)
+{
+	struct hoedown_cache_file_slot *slot = find_file_slot(file, key);
+
+	if (slot->offset) {
+		const struct hoedown_cache_record *previous = (const void *)(file->map + slot->offset);
+		file->live -= record_size(previous->size);
+	} else {
+		if ((file->slot_used + 1) * 2 > file->slot_count) {
+			grow_file_slots(file);
+			slot = find_file_slot(file, key);
+		}
+		file->slot_used++;
+	}
+
+	slot->key = key;
+	slot->offset = offset;
+	file->live += record_size(size);
+}
+
+static int
+reset_file(hoedown_cache_file *file)
+{
+	struct hoedown_cache_file_header header = { HOEDOWN_CACHE_FILE_MAGIC, file->generation, 0 };
+
+	if (ftruncate(file->fd, 0) < 0 ||
+		pwrite(file->fd, &header, sizeof header, 0) != (ssize_t)sizeof header)
+		return 0;
+
+	file->size = sizeof header;
+	return 1;
+}
+
+/* load_file • map the file and index its records, cutting off a torn one at the end */
+static int
+load_file(hoedown_cache_file *file)
+{
+	const struct hoedown_cache_file_header *header;
+	struct stat st;
+	size_t offset = sizeof(struct hoedown_cache_file_header);
+
+	memset(file->slots, 0, file->slot_count * sizeof(struct hoedown_cache_file_slot));
+	file->slot_used = 0;
+	file->live = 0;
+
+	if (fstat(file->fd, &st) < 0)
+		return 0;
+
+	file->size = (size_t)st.st_size;
+	if (file->size > file->max_size && !reset_file(file))
+		return 0;
+
+	file->map = mmap(NULL, file->max_size, PROT_READ, MAP_SHARED, file->fd, 0);
+	if (file->map == MAP_FAILED) {
+		file->map = NULL;
+		return 0;
+	}
+
+	header = (const void *)file->map;
+	if (file->size < sizeof *header ||
+		header->magic != HOEDOWN_CACHE_FILE_MAGIC || header->generation != file->generation) {
+		if (!reset_file(file))
+			return 0;
+	}
+
+	while (offset + sizeof(struct hoedown_cache_record) <= file->size) {
+		const struct hoedown_cache_record *record = (const void *)(file->map + offset);
+
+		if (record->check != record_check(record->key, record->size) ||
+			record_size(record->size) > file->size - offset)
+			break;
+
+		index_record(file, record->key, offset, record->size);
+		offset += record_size(record->size);
+	}
+
+	if (offset < file->size) {
+		if (ftruncate(file->fd, offset) < 0)
+			return 0;
+		file->size = offset;
+	}
+
+	return 1;
+}
+
+static void
+unload_file(hoedown_cache_file *file)
+{
+	if (file->map) munmap(file->map, file->max_size);
+	if (file->fd >= 0) close(file->fd);
+
+	file->map = NULL;
+	file->fd = -1;
+}
+
+hoedown_cache_file *
+hoedown_cache_file_open(const char *path, size_t max_size, uint32_t generation)
+{
+	hoedown_cache_file *file;
+	size_t path_size;
+
+	assert(path);
+
+	path_size = strlen(path) + 1;
+
+	file = hoedown_calloc(1, sizeof(hoedown_cache_file));
+	file->path = hoedown_malloc(path_size);
+	memcpy(file->path, path, path_size);
+	file->generation = generation;
+	file->max_size = max_size & ~(size_t)7;
+	file->slot_count = HOEDOWN_CACHE_FILE_MIN_SLOTS;
+	file->slots = hoedown_calloc(file->slot_count, sizeof(struct hoedown_cache_file_slot));
+
+	file->fd = open(path, O_RDWR | O_CREAT, 0600);
+	if (file->fd < 0 || file->max_size < sizeof(struct hoedown_cache_file_header) || !load_file(file)) {
+		hoedown_cache_file_close(file);
+		return NULL;
+	}
+
+	return file;
+}
+
+int
+hoedown_cache_file_get(hoedown_cache_file *file, hoedown_cache_key key, const uint8_t **data, size_t *size)
+{
+	const struct hoedown_cache_file_slot *slot;
+	const struct hoedown_cache_record *record;
+
+	assert(file && data && size);
+
+	slot = find_file_slot(file, key);
+	if (!slot->offset)
+		return 0;
+
+	record = (const void *)(file->map + slot->offset);
+	*data = (const uint8_t *)(record + 1);
+	*size = record->size;
+	return 1;
+}
+
+int
+hoedown_cache_file_put(hoedown_cache_file *file, hoedown_cache_key key, const uint8_t *data, size_t size)
+{
+	static const uint8_t padding[8] = { 0 };
+	struct hoedown_cache_record record;
+	struct iovec parts[3];
+	size_t total = record_size(size);
+
+	assert(file);
+
+	if (size > UINT32_MAX || total > file->max_size - sizeof(struct hoedown_cache_file_header))
+		return 0;
+
+	if (file->size + total > file->max_size && !hoedown_cache_file_compact(file, total))
+		return 0;
+
+	record.key = key;
+	record.size = (uint32_t)size;
+	record.check = record_check(key, record.size);
+
+	parts[0].iov_base = &record;
+	parts[0].iov_len = sizeof record;
+	parts[1].iov_base = (void *)data;
+	parts[1].iov_len = size;
+	parts[2].iov_base = (void *)padding;
+	parts[2].iov_len = total - sizeof record - size;
+
+	/* Appending at the end of the file, which may have been cut short after a failed write */
+	if (lseek(file->fd, file->size, SEEK_SET) < 0 ||
+		writev(file->fd, parts, 3) != (ssize_t)total) {
+		ftruncate(file->fd, file->size);
+		return 0;
+	}
+
+	index_record(file, key, file->size, size);
+	file->size += total;
+
+	/* Mostly dead records: rewrite before the file has to be */
+	if (file->size > file->max_size / 4 && file->live < file->size / 2)
+		hoedown_cache_file_compact(file, 0);
+
+	return 1;
+}
+
+int
+hoedown_cache_file_compact(hoedown_cache_file *file, size_t needed)
+{
+	struct hoedown_cache_file_header header = { HOEDOWN_CACHE_FILE_MAGIC, file->generation, 0 };
+	size_t offset = sizeof header;
+	size_t room, path_size, dropped = 0, kept;
+	char *temp_path;
+	int fd, ok;
+
+	assert(file);
+
+	room = file->max_size - sizeof header;
+	path_size = strlen(file->path);
+	kept = file->live;
+
+	if (kept + needed > room)
+		kept = room / 2 > needed ? room / 2 - needed : 0;
+	if (kept > file->live)
+		kept = file->live;
+
+	temp_path = hoedown_malloc(path_size + sizeof ".compact");
+	memcpy(temp_path, file->path, path_size);
+	memcpy(temp_path + path_size, ".compact", sizeof ".compact");
+
+	fd = open(temp_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		free(temp_path);
+		return 0;
+	}
+
+	ok = write(fd, &header, sizeof header) == (ssize_t)sizeof header;
+
+	/* Records are in the order they were written, so the oldest live ones are dropped first */
+	while (ok && offset < file->size) {
+		const struct hoedown_cache_record *record = (const void *)(file->map + offset);
+		size_t total = record_size(record->size);
+
+		if (find_file_slot(file, record->key)->offset == offset) {
+			if (dropped + kept < file->live)
+				dropped += total;
+			else
+				ok = write(fd, record, total) == (ssize_t)total;
+		}
+
+		offset += total;
+	}
+
+	if (ok)
+		ok = rename(temp_path, file->path) == 0;
+
+	if (!ok) {
+		close(fd);
+		unlink(temp_path);
+		free(temp_path);
+		return 0;
+	}
+
+	free(temp_path);
+	unload_file(file);
+	file->fd = fd;
+
+	return load_file(file);
+}
+
+int
+hoedown_cache_file_clear(hoedown_cache_file *file)
+{
+	assert(file);
+
+	memset(file->slots, 0, file->slot_count * sizeof(struct hoedown_cache_file_slot));
+	file->slot_used = 0;
+	file->live = 0;
+
+	return file->map && reset_file(file);
+}
+
+void
+hoedown_cache_file_close(hoedown_cache_file *file)
+{
+	if (!file) return;
+
+	unload_file(file);
+	free(file->slots);
+	free(file->path);
+	free(file);
+}
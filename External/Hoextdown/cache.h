@@ -0,0 +1,95 @@
+/* cache.h - content-addressed cache of rendered output */
+
+#ifndef HOEDOWN_CACHE_H
+#define HOEDOWN_CACHE_H
+
+#include "buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*********
+ * TYPES *
+ *********/
+
+/* hoedown_cache_key: 128-bit hash of an input and of everything its output depends on */
+struct hoedown_cache_key {
+	uint64_t lo;
+	uint64_t hi;
+};
+typedef struct hoedown_cache_key hoedown_cache_key;
+
+struct hoedown_cache_stats {
+	size_t hits;
+	size_t misses;
+	size_t evictions;
+	size_t count;
+	size_t size;
+	size_t max_size;
+};
+typedef struct hoedown_cache_stats hoedown_cache_stats;
+
+struct hoedown_cache;
+typedef struct hoedown_cache hoedown_cache;
+
+/* hoedown_cache_file: append-only cache file, read through a shared mapping.
+ * It isn't locked: callers sharing one serialize their access to it. */
+struct hoedown_cache_file;
+typedef struct hoedown_cache_file hoedown_cache_file;
+
+
+/*************
+ * FUNCTIONS *
+ *************/
+
+/* hoedown_cache_key_make: hash an input along with the flags and output variant it is rendered with */
+hoedown_cache_key hoedown_cache_key_make(const uint8_t *data, size_t size,
+	unsigned int extensions, unsigned int html_flags, unsigned int variant);
+
+/* hoedown_cache_new: allocate a cache holding up to max_size bytes, bookkeeping included */
+hoedown_cache *hoedown_cache_new(size_t max_size) __attribute__ ((malloc));
+
+/* hoedown_cache_get: append the output stored for a key to a buffer, returns 0 when there is none */
+int hoedown_cache_get(hoedown_cache *cache, hoedown_cache_key key, hoedown_buffer *ob);
+
+/* hoedown_cache_put: store the output for a key, evicting the least recently used entries to make room */
+void hoedown_cache_put(hoedown_cache *cache, hoedown_cache_key key, const uint8_t *data, size_t size);
+
+/* hoedown_cache_clear: drop every entry, keeping the counters */
+void hoedown_cache_clear(hoedown_cache *cache);
+
+/* hoedown_cache_get_stats: read the counters and the current occupation */
+void hoedown_cache_get_stats(hoedown_cache *cache, hoedown_cache_stats *stats);
+
+/* hoedown_cache_free: deallocate a cache and its entries */
+void hoedown_cache_free(hoedown_cache *cache);
+
+/* hoedown_cache_file_open: open or create a cache file of up to max_size bytes, returns NULL on failure.
+ * A file written with another generation (e.g. by another build of the templates) starts over empty. */
+hoedown_cache_file *hoedown_cache_file_open(const char *path, size_t max_size, uint32_t generation);
+
+/* hoedown_cache_file_get: point at the output stored for a key, returns 0 when there is none.
+ * The data is mapped from the file, and remains valid until the next put, compact or close. */
+int hoedown_cache_file_get(hoedown_cache_file *file, hoedown_cache_key key, const uint8_t **data, size_t *size);
+
+/* hoedown_cache_file_put: append the output for a key, compacting the file when needed, returns 0 on failure */
+int hoedown_cache_file_put(hoedown_cache_file *file, hoedown_cache_key key, const uint8_t *data, size_t size);
+
+/* hoedown_cache_file_compact: rewrite the file with its live entries only.
+ * When needed more bytes wouldn't fit, the oldest entries are dropped until half the file is free. */
+int hoedown_cache_file_compact(hoedown_cache_file *file, size_t needed);
+
+/* hoedown_cache_file_clear: drop every entry, truncating the file */
+int hoedown_cache_file_clear(hoedown_cache_file *file);
+
+/* hoedown_cache_file_close: unmap and close a cache file */
+void hoedown_cache_file_close(hoedown_cache_file *file);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /** HOEDOWN_CACHE_H **/
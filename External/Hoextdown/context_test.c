@@ -311,6 +311,8 @@ hoedown_context_test_renderer_new(hoedown_document *doc)
 
 		rndr_ref,
 		rndr_footnote_ref_def,
+
+		0,
 	};
 
 	hoedown_context_test_renderer_state *state;
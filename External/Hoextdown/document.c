@@ -7,18 +7,35 @@
 
 #include "stack.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #ifndef _MSC_VER
 #include <strings.h>
 #else
 #define strncasecmp	_strnicmp
 #endif
 
+#ifndef _WIN32
+#include <pthread.h>
+#define HOEDOWN_USE_THREADS
+#endif
+
 #define REF_TABLE_SIZE 8
 
 #define BUFFER_BLOCK 0
 #define BUFFER_SPAN 1
 #define BUFFER_ATTRIBUTE 2
 
+/* Parallel rendering kicks in from this much text, in chunks of at least this much */
+#define PARALLEL_MIN_SIZE (128 * 1024)
+#define PARALLEL_MIN_CHUNK (32 * 1024)
+#define PARALLEL_CHUNKS_PER_THREAD 4
+#define PARALLEL_MAX_POOL_THREADS 64
+
 const char *hoedown_find_block_tag(const char *str, unsigned int len);
 const char *hoedown_find_html5_block_tag(const char *str, unsigned int len);
 
@@ -41,7 +58,6 @@ struct link_ref {
 struct footnote_ref {
 	unsigned int id;
 
-	int is_used;
 	unsigned int num;
 
 	hoedown_buffer *contents;
@@ -50,17 +66,69 @@ struct footnote_ref {
 	hoedown_buffer *name;
 };
 
-/* footnote_item: an item in a footnote_list */
-struct footnote_item {
-	struct footnote_ref *ref;
-	struct footnote_item *next;
+/* footnote_registry: every footnote definition of the document, stored
+ * contiguously in definition order and hashed by id; the arrays are owned
+ * by the document and reused across renders */
+struct footnote_registry {
+	struct footnote_ref *refs;	/* definitions, in document order */
+	size_t count;
+	size_t asize;
+
+	uint32_t *slots;	/* open addressed, index + 1 into refs, 0 when empty */
+	size_t slots_size;
+
+	uint32_t *used;	/* bitmap over refs of the footnotes referenced so far */
+	uint32_t *order;	/* indices into refs, in numbering order */
+	unsigned int used_count;
 };
 
-/* footnote_list: linked list of footnote_item */
-struct footnote_list {
-	unsigned int count;
-	struct footnote_item *head;
-	struct footnote_item *tail;
+/* line_index: offsets of every newline in the text being rendered */
+struct line_index {
+	const uint8_t *data;	/* indexed text, NULL outside of a render */
+	size_t size;
+
+	size_t *newlines;
+	size_t count;
+	size_t asize;
+
+	/* position of the last lookup; block parsers mostly move forward */
+	size_t cursor;
+
+	/* range rewritten in place (blockquote prefix stripping) since indexing */
+	size_t dirty_beg;
+	size_t dirty_end;
+};
+
+/* htmlblock_ends: where the closing lines of one block tag were found in
+ * one run of text, so that every '<' block retried in it does not rescan */
+struct htmlblock_ends {
+	const char *tag;	/* static tag name, NULL for an unused entry */
+	const uint8_t *end;	/* end of the scanned text */
+
+	/* first closing line at or after *_from, NULL when there is none */
+	const uint8_t *any_from;
+	const uint8_t *any;
+	const uint8_t *strict_from;
+	const uint8_t *strict;
+};
+
+#define HTMLBLOCK_ENDS_SIZE 4
+
+/* table_row: span of one logical table row, continuation lines included */
+struct table_row {
+	size_t beg;
+	size_t end;
+	size_t lines;
+};
+
+/* table_work: row spans and column flags reused by every table */
+struct table_work {
+	struct table_row *rows;
+	size_t count;
+	size_t asize;
+
+	hoedown_table_flags *col_data;
+	size_t col_asize;
 };
 
 /* char_trigger: function pointer to render active chars */
@@ -121,6 +189,50 @@ static char_trigger markdown_char_ptrs[] = {
 	&char_math
 };
 
+/* markdown_line_t: block kinds a line may open, judged by its first byte */
+enum markdown_line_t {
+	MD_LINE_ATXHEADER = (1 << 0),
+	MD_LINE_HTML = (1 << 1),
+	MD_LINE_EMPTY = (1 << 2),
+	MD_LINE_HRULE = (1 << 3),
+	MD_LINE_FENCE = (1 << 4),
+	MD_LINE_QUOTE = (1 << 5),
+	MD_LINE_ULI = (1 << 6),
+	MD_LINE_OLI = (1 << 7),
+	MD_LINE_HEADERLINE = (1 << 8),
+	MD_LINE_TABLE = (1 << 9),
+	MD_LINE_CODE = (1 << 10)
+};
+
+/* kinds a line indented by 0-3 spaces may open, keyed by its first
+ * non-space byte; ATX headers, HTML and setext underlines additionally
+ * require the byte to sit in the first column */
+static const uint16_t markdown_line_kinds[256] = {
+	['\n'] = MD_LINE_EMPTY,
+	['#'] = MD_LINE_ATXHEADER,
+	['<'] = MD_LINE_HTML,
+	['*'] = MD_LINE_HRULE | MD_LINE_ULI,
+	['-'] = MD_LINE_HRULE | MD_LINE_ULI | MD_LINE_HEADERLINE,
+	['+'] = MD_LINE_ULI,
+	['_'] = MD_LINE_HRULE,
+	['='] = MD_LINE_HEADERLINE,
+	['`'] = MD_LINE_FENCE,
+	['~'] = MD_LINE_FENCE,
+	['>'] = MD_LINE_QUOTE,
+	['0'] = MD_LINE_OLI, ['1'] = MD_LINE_OLI, ['2'] = MD_LINE_OLI,
+	['3'] = MD_LINE_OLI, ['4'] = MD_LINE_OLI, ['5'] = MD_LINE_OLI,
+	['6'] = MD_LINE_OLI, ['7'] = MD_LINE_OLI, ['8'] = MD_LINE_OLI,
+	['9'] = MD_LINE_OLI
+};
+
+/* line_class: what a single line can start, computed once per line */
+struct line_class {
+	size_t end;	/* offset past the line's newline, or the data size */
+	size_t indent;	/* number of leading spaces */
+	uint8_t first;	/* first non-space byte, '\n' for a blank line */
+	unsigned int kinds;	/* markdown_line_t candidates */
+};
+
 struct hoedown_document {
 	hoedown_renderer md;
 	hoedown_renderer_data data;
@@ -128,10 +240,13 @@ struct hoedown_document {
 	uint8_t attr_activation;
 
 	struct link_ref *refs[REF_TABLE_SIZE];
-	struct footnote_list footnotes_found;
-	struct footnote_list footnotes_used;
+	struct footnote_registry footnotes;
 	uint8_t active_char[256];
 	hoedown_stack work_bufs[3];
+	struct line_index lines;
+	struct htmlblock_ends html_ends[HTMLBLOCK_ENDS_SIZE];
+	size_t html_ends_next;
+	struct table_work table_work;
 	hoedown_extensions ext_flags;
 	size_t max_nesting;
 	int in_link_body;
@@ -153,6 +268,13 @@ struct hoedown_document {
 
 	hoedown_user_block user_block;
 	hoedown_buffer *meta;
+
+	/* parallel rendering: a fork renders chunks of text that other
+	 * threads read, sharing the references of the document it forks */
+	unsigned int threads;
+	struct hoedown_document **forks;
+	int is_fork;
+	int fork_needs_serial;
 };
 
 /***************************
@@ -184,6 +306,164 @@ popbuf(hoedown_document *doc, int type)
 	doc->work_bufs[type].size--;
 }
 
+static void
+line_index_reserve(struct line_index *idx, size_t asize)
+{
+	if (asize <= idx->asize)
+		return;
+
+	while (idx->asize < asize)
+		idx->asize = idx->asize ? idx->asize * 2 : 256;
+
+	idx->newlines = hoedown_realloc(idx->newlines, idx->asize * sizeof(size_t));
+}
+
+/* line_index_build • records the offset of every newline in data, sixteen
+ * bytes at a time where the target has a vector unit */
+static void
+line_index_build(struct line_index *idx, const uint8_t *data, size_t size)
+{
+	size_t i = 0, count = 0;
+	const uint8_t *nl;
+
+	/* prose averages well above 32 bytes per line */
+	line_index_reserve(idx, (size >> 5) + 16);
+
+#if defined(__SSE2__)
+	{
+		const __m128i newline = _mm_set1_epi8('\n');
+		for (; i + 16 <= size; i += 16) {
+			__m128i chunk = _mm_loadu_si128((const __m128i *)(data + i));
+			unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+
+			if (!mask)
+				continue;
+
+			line_index_reserve(idx, count + 16);
+			while (mask) {
+				idx->newlines[count++] = i + __builtin_ctz(mask);
+				mask &= mask - 1;
+			}
+		}
+	}
+#elif defined(__ARM_NEON)
+	{
+		const uint8x16_t newline = vdupq_n_u8('\n');
+		for (; i + 16 <= size; i += 16) {
+			uint8x16_t eq = vceqq_u8(vld1q_u8(data + i), newline);
+			/* narrow each byte of the comparison to a nibble */
+			uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+				vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+
+			if (!mask)
+				continue;
+
+			line_index_reserve(idx, count + 16);
+			while (mask) {
+				int bit = __builtin_ctzll(mask);
+				idx->newlines[count++] = i + (bit >> 2);
+				mask &= ~(0xFULL << bit);
+			}
+		}
+	}
+#endif
+
+	while (i < size && (nl = memchr(data + i, '\n', size - i)) != NULL) {
+		line_index_reserve(idx, count + 1);
+		i = nl - data;
+		idx->newlines[count++] = i++;
+	}
+
+	idx->data = data;
+	idx->size = size;
+	idx->count = count;
+	idx->cursor = 0;
+	idx->dirty_beg = idx->dirty_end = 0;
+}
+
+/* line_index_invalidate • marks bytes that were rewritten in place */
+static void
+line_index_invalidate(struct line_index *idx, const uint8_t *data, size_t size)
+{
+	size_t beg, end;
+
+	if (!idx->data || data < idx->data || data + size > idx->data + idx->size)
+		return;
+
+	beg = data - idx->data;
+	end = beg + size;
+
+	if (idx->dirty_beg == idx->dirty_end) {
+		idx->dirty_beg = beg;
+		idx->dirty_end = end;
+	} else {
+		if (beg < idx->dirty_beg) idx->dirty_beg = beg;
+		if (end > idx->dirty_end) idx->dirty_end = end;
+	}
+}
+
+/* line_index_seek • returns the slot of the first newline at or after pos */
+static size_t
+line_index_seek(struct line_index *idx, size_t pos)
+{
+	size_t lo, hi, k = idx->cursor;
+
+	if (k < idx->count && idx->newlines[k] >= pos &&
+		(k == 0 || idx->newlines[k - 1] < pos))
+		return k;
+
+	/* short forward steps cover the sequential case, bisect otherwise */
+	if (k < idx->count && idx->newlines[k] < pos) {
+		size_t steps = 0;
+		while (++k < idx->count && idx->newlines[k] < pos)
+			if (++steps == 8) break;
+
+		if (steps < 8) {
+			idx->cursor = k;
+			return k;
+		}
+		lo = k;
+		hi = idx->count;
+	} else {
+		lo = 0;
+		hi = k < idx->count ? k : idx->count;
+	}
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (idx->newlines[mid] < pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	idx->cursor = lo;
+	return lo;
+}
+
+/* find_newline • returns the offset of the first newline in data, or size;
+ * answered from the line index when data lies in the indexed text */
+static size_t
+find_newline(hoedown_document *doc, const uint8_t *data, size_t size)
+{
+	struct line_index *idx = &doc->lines;
+	const uint8_t *nl;
+
+	if (idx->data && data >= idx->data && data + size <= idx->data + idx->size) {
+		size_t pos = data - idx->data;
+		size_t k = line_index_seek(idx, pos);
+		size_t found = k < idx->count ? idx->newlines[k] : idx->size;
+
+		/* the answer is stale if it may have moved during a rewrite */
+		if (idx->dirty_beg == idx->dirty_end ||
+			pos >= idx->dirty_end || found < idx->dirty_beg)
+			return found - pos < size ? found - pos : size;
+	}
+
+	nl = memchr(data, '\n', size);
+	return nl ? (size_t)(nl - data) : size;
+}
+
 static void
 unscape_text(hoedown_buffer *ob, hoedown_buffer *src)
 {
@@ -268,75 +548,112 @@ free_link_refs(struct link_ref **references)
 	}
 }
 
-static struct footnote_ref *
-create_footnote_ref(struct footnote_list *list, const uint8_t *name, size_t name_size)
+static void
+footnote_registry_grow(struct footnote_registry *reg)
 {
-	struct footnote_ref *ref = hoedown_calloc(1, sizeof(struct footnote_ref));
+	size_t i, old_words = (reg->asize + 31) / 32;
 
-	ref->id = hash_link_ref(name, name_size);
+	reg->asize = reg->asize ? reg->asize * 2 : 32;
+	reg->refs = hoedown_realloc(reg->refs, reg->asize * sizeof(struct footnote_ref));
+	reg->order = hoedown_realloc(reg->order, reg->asize * sizeof(uint32_t));
+	reg->used = hoedown_realloc(reg->used, (reg->asize + 31) / 32 * sizeof(uint32_t));
+	memset(reg->used + old_words, 0x0, ((reg->asize + 31) / 32 - old_words) * sizeof(uint32_t));
 
-	return ref;
+	/* keep the slot table at most half full */
+	free(reg->slots);
+	reg->slots_size = reg->asize * 2;
+	reg->slots = hoedown_calloc(reg->slots_size, sizeof(uint32_t));
+
+	for (i = 0; i < reg->count; ++i) {
+		size_t slot = reg->refs[i].id & (reg->slots_size - 1);
+
+		while (reg->slots[slot])
+			slot = (slot + 1) & (reg->slots_size - 1);
+		reg->slots[slot] = (uint32_t)i + 1;
+	}
 }
 
-static int
-add_footnote_ref(struct footnote_list *list, struct footnote_ref *ref)
+/* find_footnote_slot • returns the slot holding the first definition with
+ * this hash, or the empty slot where it would go */
+static uint32_t *
+find_footnote_slot(struct footnote_registry *reg, unsigned int hash)
 {
-	struct footnote_item *item = hoedown_calloc(1, sizeof(struct footnote_item));
-	if (!item)
-		return 0;
-	item->ref = ref;
+	size_t slot = hash & (reg->slots_size - 1);
 
-	if (list->head == NULL) {
-		list->head = list->tail = item;
-	} else {
-		list->tail->next = item;
-		list->tail = item;
-	}
-	list->count++;
+	while (reg->slots[slot] && reg->refs[reg->slots[slot] - 1].id != hash)
+		slot = (slot + 1) & (reg->slots_size - 1);
 
-	return 1;
+	return &reg->slots[slot];
 }
 
+/* add_footnote_ref • registers a definition, returns NULL when an earlier
+ * one already uses the same id */
 static struct footnote_ref *
-find_footnote_ref(struct footnote_list *list, uint8_t *name, size_t length)
+add_footnote_ref(struct footnote_registry *reg, const uint8_t *name, size_t name_size)
 {
-	unsigned int hash = hash_link_ref(name, length);
-	struct footnote_item *item = NULL;
+	unsigned int hash = hash_link_ref(name, name_size);
+	struct footnote_ref *ref;
+	uint32_t *slot;
 
-	item = list->head;
+	if (reg->count >= reg->asize)
+		footnote_registry_grow(reg);
 
-	while (item != NULL) {
-		if (item->ref->id == hash)
-			return item->ref;
-		item = item->next;
-	}
+	slot = find_footnote_slot(reg, hash);
+	if (*slot)
+		return NULL;
 
-	return NULL;
+	ref = &reg->refs[reg->count];
+	memset(ref, 0x0, sizeof(struct footnote_ref));
+	ref->id = hash;
+	*slot = (uint32_t)++reg->count;
+
+	return ref;
 }
 
-static void
-free_footnote_ref(struct footnote_ref *ref)
+/* use_footnote_ref • numbers the definition for this id on its first
+ * reference; returns it, or NULL when it is undefined or already used */
+static struct footnote_ref *
+use_footnote_ref(struct footnote_registry *reg, uint8_t *name, size_t length)
 {
-	hoedown_buffer_free(ref->contents);
-	hoedown_buffer_free(ref->name);
-	free(ref);
+	uint32_t index;
+
+	if (!reg->count)
+		return NULL;
+
+	index = *find_footnote_slot(reg, hash_link_ref(name, length));
+	if (!index--)
+		return NULL;
+
+	if (reg->used[index / 32] & (1u << (index % 32)))
+		return NULL;
+
+	reg->used[index / 32] |= 1u << (index % 32);
+	reg->order[reg->used_count++] = index;
+	reg->refs[index].num = reg->used_count;
+
+	return &reg->refs[index];
 }
 
+/* reset_footnote_registry • drops the definitions of the last render,
+ * keeping the arrays for the next one */
 static void
-free_footnote_list(struct footnote_list *list, int free_refs)
+reset_footnote_registry(struct footnote_registry *reg)
 {
-	struct footnote_item *item = list->head;
-	struct footnote_item *next;
+	size_t i;
 
-	while (item) {
-		next = item->next;
-		if (free_refs)
-			free_footnote_ref(item->ref);
-		free(item);
-		item = next;
+	for (i = 0; i < reg->count; ++i) {
+		hoedown_buffer_free(reg->refs[i].contents);
+		hoedown_buffer_free(reg->refs[i].name);
 	}
-}
 
+	if (reg->count) {
+		memset(reg->slots, 0x0, reg->slots_size * sizeof(uint32_t));
+		memset(reg->used, 0x0, (reg->asize + 31) / 32 * sizeof(uint32_t));
+	}
+
+	reg->count = 0;
+	reg->used_count = 0;
+}
 
 /*
  * Check whether a char is a Markdown spacing char.
@@ -1417,16 +1734,19 @@ char_link(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offse
 		id.data = data + 2;
 		id.size = txt_e - 2;
 
-		fr = find_footnote_ref(&doc->footnotes_found, id.data, id.size);
+		/* footnotes are numbered in document order, which a fork
+		 * doesn't follow: its chunk is rendered again in turn */
+		if (doc->is_fork) {
+			if (doc->footnotes.count &&
+				*find_footnote_slot(&doc->footnotes, hash_link_ref(id.data, id.size)))
+				doc->fork_needs_serial = 1;
+			goto cleanup;
+		}
 
-		/* mark footnote used */
-		if (fr && !fr->is_used) {
-			if(!add_footnote_ref(&doc->footnotes_used, fr))
-				goto cleanup;
-			fr->is_used = 1;
-			fr->num = doc->footnotes_used.count;
+		fr = use_footnote_ref(&doc->footnotes, id.data, id.size);
 
-			/* render */
+		/* render the first reference only */
+		if (fr) {
 			if (doc->md.footnote_ref) {
 				doc->link_id = &id;
 				ret = doc->md.footnote_ref(ob, fr->num, &doc->data);
@@ -1727,6 +2047,43 @@ char_math(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t offse
  * BLOCK-LEVEL PARSING FUNCTIONS *
  *********************************/
 
+/* classify_line • looks at the indentation and first significant byte of a
+ * line to tell which block parsers can possibly accept it; a kind missing
+ * from the result is a guaranteed miss, a kind present still has to be
+ * confirmed by the matching parser */
+static void
+classify_line(struct line_class *line, hoedown_document *doc, const uint8_t *data, size_t size)
+{
+	size_t i = 0;
+
+	line->end = find_newline(doc, data, size);
+	if (line->end < size)
+		line->end++;
+
+	while (i < line->end && data[i] == ' ')
+		i++;
+
+	line->indent = i;
+	line->first = (i < line->end) ? data[i] : '\n';
+
+	if (line->first == '\n') {
+		line->kinds = MD_LINE_EMPTY;
+		return;
+	}
+
+	if (i >= 4) {
+		line->kinds = MD_LINE_CODE;
+	} else {
+		line->kinds = markdown_line_kinds[line->first];
+		if (i > 0)
+			line->kinds &= ~(MD_LINE_ATXHEADER | MD_LINE_HTML | MD_LINE_HEADERLINE);
+	}
+
+	/* a table header needs at least one pipe on its first line */
+	if (memchr(data + i, '|', line->end - i))
+		line->kinds |= MD_LINE_TABLE;
+}
+
 /* is_empty • returns the line length when it is empty, 0 otherwise */
 static size_t
 is_empty(const uint8_t *data, size_t size)
@@ -2081,8 +2438,9 @@ prefix_dli(hoedown_document *doc, uint8_t *data, size_t size)
 			 * character after whitespaces, it can't be a definition list */
 			break;
 		}
-		/* scan characters until the next newline */
-		for (i = i + 1; i < size && data[i - 1] != '\n'; i++);
+		/* skip to the next line */
+		i += find_newline(doc, data + i, size - i);
+		if (i < size) i++;
 	}
 
 	doc->ext_flags |= HOEDOWN_EXT_DEFINITION_LISTS;
@@ -2100,14 +2458,15 @@ parse_blockquote(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_
 {
 	size_t beg, end = 0, pre, work_size = 0;
 	uint8_t *work_data = 0;
-	hoedown_buffer *out = 0;
+	hoedown_buffer *out = 0, *copy = 0;
 
 	doc->blockquote_depth++;
 
 	out = newbuf(doc, BUFFER_BLOCK);
 	beg = 0;
 	while (beg < size) {
-		for (end = beg + 1; end < size && data[end - 1] != '\n'; end++);
+		end = beg + find_newline(doc, data + beg, size - beg);
+		if (end < size) end++;
 
 		pre = prefix_quote(data + beg, end - beg);
 
@@ -2129,8 +2488,22 @@ parse_blockquote(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_
 			/* hoedown_buffer_put(work, data + beg, end - beg); */
 			if (!work_data)
 				work_data = data + beg;
-			else if (data + beg != work_data + work_size)
-				memmove(work_data + work_size, data + beg, end - beg);
+			else if (copy) {
+				hoedown_buffer_put(copy, data + beg, end - beg);
+				work_data = copy->data;
+			}
+			else if (data + beg != work_data + work_size) {
+				/* a fork shares the text with other threads: copy it instead */
+				if (doc->is_fork) {
+					copy = hoedown_buffer_new(64);
+					hoedown_buffer_put(copy, work_data, work_size);
+					hoedown_buffer_put(copy, data + beg, end - beg);
+					work_data = copy->data;
+				} else {
+					line_index_invalidate(&doc->lines, work_data + work_size, (data + end) - (work_data + work_size));
+					memmove(work_data + work_size, data + beg, end - beg);
+				}
+			}
 			work_size += end - beg;
 		}
 		beg = end;
@@ -2141,6 +2514,9 @@ parse_blockquote(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_
 		doc->md.blockquote(ob, out, &doc->data);
 	popbuf(doc, BUFFER_BLOCK);
 
+	if (copy)
+		hoedown_buffer_free(copy);
+
 	doc->blockquote_depth--;
 
 	return end;
@@ -2154,18 +2530,21 @@ static size_t
 parse_paragraph(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t size)
 {
 	hoedown_buffer work = { NULL, 0, 0, 0, NULL, NULL, NULL };
+	struct line_class line;
 	size_t i = 0, end = 0;
 	int level = 0;
 
 	work.data = data;
 
 	while (i < size) {
-		for (end = i + 1; end < size && data[end - 1] != '\n'; end++) /* empty */;
+		classify_line(&line, doc, data + i, size - i);
+		end = i + line.end;
 
-		if (is_empty(data + i, size - i))
+		if (line.kinds & MD_LINE_EMPTY)
 			break;
 
-		if ((level = is_headerline(data + i, size - i)) != 0) {
+		if ((line.kinds & MD_LINE_HEADERLINE) &&
+			(level = is_headerline(data + i, size - i)) != 0) {
 			if (i == 0) {
 				level = 0;
 				i = end;
@@ -2173,9 +2552,9 @@ parse_paragraph(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t
 			break;
 		}
 
-		if (is_atxheader(doc, data + i, size - i) ||
-			is_hrule(data + i, size - i) ||
-			prefix_quote(data + i, size - i)) {
+		if (((line.kinds & MD_LINE_ATXHEADER) && is_atxheader(doc, data + i, size - i)) ||
+			((line.kinds & MD_LINE_HRULE) && is_hrule(data + i, size - i)) ||
+			((line.kinds & MD_LINE_QUOTE) && prefix_quote(data + i, size - i))) {
 			end = i;
 			break;
 		}
@@ -2276,8 +2655,7 @@ parse_fencedcode(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_
 
 
 	/* parse codefence line */
-	while (i < size && data[i] != '\n')
-		i++;
+	i = find_newline(doc, data, size);
 
 	w = parse_codefence(doc, data, i, &lang, &width, &chr, flags, attr);
 	if (!w) {
@@ -2289,8 +2667,7 @@ parse_fencedcode(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_
 	i++;
 	text_start = i;
 	while ((line_start = i) < size) {
-		while (i < size && data[i] != '\n')
-			i++;
+		i += find_newline(doc, data + i, size - i);
 
 		w2 = is_codefence(data + line_start, i - line_start, &width2, &chr2);
 		if (w == w2 && width == width2 && chr == chr2 &&
@@ -2326,7 +2703,8 @@ parse_blockcode(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t
 
 	beg = 0;
 	while (beg < size) {
-		for (end = beg + 1; end < size && data[end - 1] != '\n'; end++) {};
+		end = beg + find_newline(doc, data + beg, size - beg);
+		if (end < size) end++;
 		pre = prefix_code(data + beg, end - beg);
 
 		if (pre)
@@ -2399,9 +2777,8 @@ parse_listitem(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t
 	}
 
 	/* skipping to the beginning of the following line */
-	end = beg;
-	while (end < size && data[end - 1] != '\n')
-		end++;
+	end = beg + find_newline(doc, data + beg, size - beg);
+	if (end < size) end++;
 
 	/* getting working buffers */
 	work = newbuf(doc, BUFFER_SPAN);
@@ -2424,10 +2801,8 @@ parse_listitem(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t
 	while (beg < size) {
 		size_t has_next_uli = 0, has_next_oli = 0, has_next_dli = 0;
 
-		end++;
-
-		while (end < size && data[end - 1] != '\n')
-			end++;
+		end += find_newline(doc, data + end, size - end);
+		if (end < size) end++;
 
 		/* process an empty line */
 		if (is_empty(data + beg, end - beg)) {
@@ -2600,7 +2975,7 @@ parse_definition(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_
 	*flags |= HOEDOWN_LI_DT;
 	while (j + 1 < end) {
 		/* find the end of the term (where the newline is) */
-		for(k = j + 1; k - 1 < end && data[k - 1] != '\n'; k++);
+		k = j + find_newline(doc, data + j, end - j) + 1;
 
 		len = k - j;
 
@@ -2692,7 +3067,7 @@ parse_atxheader(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t
 
 	for (i = level; i < size && data[i] == ' '; i++);
 
-	for (end = i; end < size && data[end] != '\n'; end++);
+	end = i + find_newline(doc, data + i, size - i);
 	skip = end;
 
 	while (end && data[end - 1] == '#')
@@ -2747,22 +3122,20 @@ parse_footnote_def(hoedown_buffer *ob, hoedown_document *doc, unsigned int num,
 
 /* parse_footnote_list • render the contents of the footnotes */
 static void
-parse_footnote_list(hoedown_buffer *ob, hoedown_document *doc, struct footnote_list *footnotes)
+parse_footnote_list(hoedown_buffer *ob, hoedown_document *doc, struct footnote_registry *footnotes)
 {
 	hoedown_buffer *work = 0;
-	struct footnote_item *item;
 	struct footnote_ref *ref;
+	unsigned int i;
 
-	if (footnotes->count == 0)
+	if (footnotes->used_count == 0)
 		return;
 
 	work = newbuf(doc, BUFFER_BLOCK);
 
-	item = footnotes->head;
-	while (item) {
-		ref = item->ref;
+	for (i = 0; i < footnotes->used_count; ++i) {
+		ref = &footnotes->refs[footnotes->order[i]];
 		parse_footnote_def(work, doc, ref->num, ref->name, ref->contents->data, ref->contents->size);
-		item = item->next;
 	}
 
 	if (doc->md.footnotes)
@@ -2770,80 +3143,133 @@ parse_footnote_list(hoedown_buffer *ob, hoedown_document *doc, struct footnote_l
 	popbuf(doc, BUFFER_BLOCK);
 }
 
-/* htmlblock_is_end • check for end of HTML block : </tag>( *)\n */
-/*	returns tag length on match, 0 otherwise */
-/*	assumes data starts with "<" */
+/* htmlblock_is_end • checks whether the line data[beg .. nl) closes the
+ * block, i.e. ends in </tag> (in any case) followed only by spaces */
+/*	returns the offset of the '<' on match, or nl */
 static size_t
 htmlblock_is_end(
 	const char *tag,
 	size_t tag_len,
-	hoedown_document *doc,
-	uint8_t *data,
-	size_t size)
+	const uint8_t *data,
+	size_t beg,
+	size_t nl)
 {
-	size_t i = tag_len + 3, w;
-
-	/* try to match the end tag */
-	/* note: we're not considering tags like "</tag >" which are still valid */
-	if (i > size ||
-		data[1] != '/' ||
-		strncasecmp((char *)data + 2, tag, tag_len) != 0 ||
-		data[tag_len + 2] != '>')
-		return 0;
+	size_t i, t = nl;
 
-	/* rest of the line must be empty */
-	if ((w = is_empty(data + i, size - i)) == 0 && i < size)
-		return 0;
+	while (t > beg && data[t - 1] == ' ')
+		t--;
+
+	if (t - beg < tag_len + 3 || data[t - 1] != '>')
+		return nl;
+
+	t -= tag_len + 3;
+	if (data[t] != '<' || data[t + 1] != '/')
+		return nl;
+
+	/* block tag names are stored lower case */
+	for (i = 0; i < tag_len; i++) {
+		uint8_t c = data[t + 2 + i];
+		if (c >= 'A' && c <= 'Z')
+			c |= 0x20;
+		if (c != (uint8_t)tag[i])
+			return nl;
+	}
 
-	return i + w;
+	return t;
 }
 
-/* htmlblock_find_end • try to find HTML block ending tag */
-/*	returns the length on match, 0 otherwise */
-static size_t
-htmlblock_find_end(
-	const char *tag,
-	size_t tag_len,
+/* htmlblock_scan_ends • walks the lines of data from beg looking for the
+ * first closing line of tag, and unless only that is wanted, for the first
+ * one that is also followed by a blank line, another tag or the end */
+static void
+htmlblock_scan_ends(
+	struct htmlblock_ends *ends,
 	hoedown_document *doc,
-	uint8_t *data,
-	size_t size)
+	const uint8_t *data,
+	size_t beg,
+	size_t size,
+	int want_strict)
 {
-	size_t i = 0, w;
+	size_t tag_len = strlen(ends->tag), nl, next;
+	int want_any = 1;
 
-	while (1) {
-		while (i < size && data[i] != '<') i++;
-		if (i >= size) return 0;
+	if (want_strict) {
+		ends->strict_from = data + beg;
+		ends->strict = NULL;
+	}
 
-		w = htmlblock_is_end(tag, tag_len, doc, data + i, size - i);
-		if (w) return i + w;
-		i++;
+	ends->any_from = data + beg;
+	ends->any = NULL;
+
+	while (beg < size && (want_any || want_strict)) {
+		nl = beg + find_newline(doc, data + beg, size - beg);
+		next = nl < size ? nl + 1 : nl;
+
+		if (htmlblock_is_end(ends->tag, tag_len, data, beg, nl) < nl) {
+			if (want_any) {
+				ends->any = data + beg;
+				want_any = 0;
+			}
+
+			/* a last line without its newline never closes strictly */
+			if (want_strict && nl < size &&
+				(next >= size || is_empty(data + next, size - next) ||
+				(next + 1 < size && data[next] == '<' && data[next + 1] != '/'))) {
+				ends->strict = data + beg;
+				want_strict = 0;
+			}
+		}
+
+		beg = next;
 	}
 }
 
-/* htmlblock_find_end_strict • try to find end of HTML block in strict mode */
-/*	(it must have a blank line or a new HTML tag afterwards) */
+/* htmlblock_find_end • finds the end of the HTML block opened by tag at the
+ * start of data: the first closing line followed by a blank line or a new
+ * tag, or failing that (if lax) the first closing line at all */
 /*	returns the length on match, 0 otherwise */
 static size_t
-htmlblock_find_end_strict(
+htmlblock_find_end(
 	const char *tag,
-	size_t tag_len,
 	hoedown_document *doc,
 	uint8_t *data,
-	size_t size)
+	size_t size,
+	int lax)
 {
-	size_t i = 0, mark;
+	struct htmlblock_ends *ends = NULL;
+	const uint8_t *line;
+	size_t i;
 
-	while (1) {
-		mark = i;
-		while (i < size && data[i] != '\n') i++;
-		if (i < size) i++;
-		if (i == mark) return 0;
+	for (i = 0; i < HTMLBLOCK_ENDS_SIZE; i++) {
+		if (doc->html_ends[i].tag == tag && doc->html_ends[i].end == data + size) {
+			ends = &doc->html_ends[i];
+			break;
+		}
+	}
 
-		mark += htmlblock_find_end(tag, tag_len, doc, data + mark, i - mark);
-		if (mark == i && (is_empty(data + i, size - i) || (i + 1 < size && data[i] == '<' && data[i + 1] != '/') || i >= size)) break;
+	if (!ends) {
+		ends = &doc->html_ends[doc->html_ends_next];
+		doc->html_ends_next = (doc->html_ends_next + 1) % HTMLBLOCK_ENDS_SIZE;
+		ends->tag = tag;
+		ends->end = data + size;
+		htmlblock_scan_ends(ends, doc, data, 0, size, 1);
+	} else if (data < ends->strict_from || (ends->strict && ends->strict < data)) {
+		htmlblock_scan_ends(ends, doc, data, 0, size, 1);
 	}
 
-	return i;
+	line = ends->strict;
+	if (!line && lax) {
+		if (data < ends->any_from || (ends->any && ends->any < data))
+			htmlblock_scan_ends(ends, doc, data, 0, size, 0);
+		line = ends->any;
+	}
+
+	if (!line)
+		return 0;
+
+	/* the block runs through the newline of its closing line */
+	i = line - data;
+	return i + find_newline(doc, line, size - i) + 1;
 }
 
 /* parse_htmlblock • parsing of inline HTML block */
@@ -2851,7 +3277,7 @@ static size_t
 parse_htmlblock(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t size, int do_render)
 {
 	hoedown_buffer work = { NULL, 0, 0, 0, NULL, NULL, NULL };
-	size_t i, j = 0, tag_len, tag_end;
+	size_t i, j = 0, tag_end;
 	const char *curtag = NULL;
 	int meta = 0;
 
@@ -2964,14 +3390,11 @@ parse_htmlblock(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t
 		return 0;
 	}
 
-	/* looking for a matching closing tag in strict mode */
-	tag_len = strlen(curtag);
-	tag_end = htmlblock_find_end_strict(curtag, tag_len, doc, data, size);
-
-	/* if not found, trying a second pass looking for indented match */
-	/* but not if tag is "ins" or "del" (following original Markdown.pl) */
-	if (!tag_end && strcmp(curtag, "ins") != 0 && strcmp(curtag, "del") != 0)
-		tag_end = htmlblock_find_end(curtag, tag_len, doc, data, size);
+	/* looking for a matching closing tag in strict mode, and failing that
+	 * for any closing line, but not if tag is "ins" or "del" (following
+	 * original Markdown.pl) */
+	tag_end = htmlblock_find_end(curtag, doc, data, size,
+		strcmp(curtag, "ins") != 0 && strcmp(curtag, "del") != 0);
 
 	if (!tag_end)
 		return 0;
@@ -2984,25 +3407,43 @@ parse_htmlblock(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t
 	return tag_end;
 }
 
-/* Common function to parse table main rows and continued rows. */
+/* count_table_separators • counts the unbackslashed c in data[beg .. end) */
 static size_t
-parse_table_cell_line(
-		hoedown_buffer *ob,
+count_table_separators(uint8_t *data, size_t beg, size_t end, uint8_t c)
+{
+	size_t count = 0;
+	uint8_t *p = data + beg;
+
+	while ((p = memchr(p, c, (data + end) - p)) != NULL) {
+		if (!is_backslashed(data, p - data))
+			count++;
+		p++;
+	}
+
+	return count;
+}
+
+/* table_cell_bounds • finds the extent of the cell starting at offset,
+ * returning the number of bytes consumed; the cell text is
+ * data[*cell_start .. *cell_end] once surrounding spaces are trimmed */
+static size_t
+table_cell_bounds(
+		hoedown_document *doc,
 		uint8_t *data,
 		size_t size,
 		size_t offset,
 		char separator,
-		int is_continuation) {
-	size_t pos, line_end, cell_start, cell_end, len, copy_start, copy_end;
+		size_t *cell_start,
+		size_t *cell_end) {
+	size_t pos, line_end, len;
 
 	pos = offset;
 
 	while (pos < size && _isspace(data[pos])) pos++;
 
-	cell_start = pos;
+	*cell_start = pos;
 
-	line_end = pos;
-	while (line_end < size && data[line_end] != '\n') line_end++;
+	line_end = pos + find_newline(doc, data + pos, size - pos);
 	len = find_separator_char(data + pos, line_end - pos, separator);
 
 	/* Two possibilities for len == 0:
@@ -3010,15 +3451,31 @@ parse_table_cell_line(
 	   2) The next separator is right after the current one, i.e. empty cell.
 	   For case 1, we skip to the end of line; for case 2 we just continue.
 	*/
-	if (len == 0 && pos < size && data[pos] != separator) {
-		while (pos + len < size && data[pos + len] != '\n') len++;
-	}
+	if (len == 0 && pos < size && data[pos] != separator)
+		len = line_end - pos;
 	pos += len;
 
-	cell_end = pos - 1;
+	*cell_end = pos - 1;
+
+	while (*cell_end > *cell_start && _isspace(data[*cell_end]))
+		(*cell_end)--;
+
+	return pos - offset;
+}
+
+/* Common function to parse table main rows and continued rows. */
+static size_t
+parse_table_cell_line(
+		hoedown_buffer *ob,
+		hoedown_document *doc,
+		uint8_t *data,
+		size_t size,
+		size_t offset,
+		char separator,
+		int is_continuation) {
+	size_t consumed, cell_start, cell_end, copy_start, copy_end;
 
-	while (cell_end > cell_start && _isspace(data[cell_end]))
-		cell_end--;
+	consumed = table_cell_bounds(doc, data, size, offset, separator, &cell_start, &cell_end);
 
 	/* If this isn't the first line of the cell, add a new line before the
 	   extra cell contents, to separate them (and make backslash linebreaks
@@ -3037,7 +3494,7 @@ parse_table_cell_line(
 	}
 	hoedown_buffer_put(ob, data + copy_start, copy_end - copy_start);
 
-	return pos - offset;
+	return consumed;
 }
 
 static void
@@ -3053,29 +3510,47 @@ parse_table_row(
 {
 	size_t i = 0, col;
 	hoedown_buffer *row_work = 0;
+	hoedown_buffer *cell_content = 0;
+	hoedown_buffer *cell_work = 0;
 
 	if (!doc->md.table_cell || !doc->md.table_row)
 		return;
 
+	/* the cell buffers are taken once per row and recycled for each cell */
 	row_work = newbuf(doc, BUFFER_SPAN);
+	cell_content = newbuf(doc, BUFFER_SPAN);
+	cell_work = newbuf(doc, BUFFER_SPAN);
 
 	/* skip optional first pipe */
 	if (i < size && data[i] == '|')
 		i++;
 
 	for (col = 0; col < columns && i < size; ++col) {
-		size_t pos, extra_rows_in_cell;
-		hoedown_buffer *cell_content;
-		hoedown_buffer *cell_work;
+		size_t pos, extra_rows_in_cell, cell_start, cell_end;
+
+		cell_work->size = 0;
+
+		/* A single-line cell without escaped pipes is inline parsed straight
+		   from the source text.
+		*/
+		if (rows == 1) {
+			size_t consumed = table_cell_bounds(doc, data, size, i, '|', &cell_start, &cell_end);
+			size_t len = cell_end + 1 - cell_start;
+
+			if (!memchr(data + cell_start, '\\', len)) {
+				parse_inline(cell_work, doc, data + cell_start, len);
+				doc->md.table_cell(row_work, cell_work, col_data[col] | header_flag, &doc->data);
+				i += consumed + 1;
+				continue;
+			}
+		}
 
 		/* cell_content is the text that is inline parsed into cell_work. It
 		   consists of the values of this cell from each row, concatenated and
 		   separated by new lines.
 		*/
-		cell_content = newbuf(doc, BUFFER_SPAN);
-		cell_work = newbuf(doc, BUFFER_SPAN);
-
-		i += parse_table_cell_line(cell_content, data, size, i, '|', 0 /* is_contination */);
+		cell_content->size = 0;
+		i += parse_table_cell_line(cell_content, doc, data, size, i, '|', 0 /* is_contination */);
 
 		/* Add extra rows of the cell. This only occurs if rows is greater than 0,
 		   which only happens when multiline tables are enabled.
@@ -3089,9 +3564,7 @@ parse_table_row(
 			size_t c;
 
 			/* seek to the end of the current row */
-			while (pos < size && data[pos] != '\n') {
-				pos++;
-			}
+			pos += find_newline(doc, data + pos, size - pos);
 
 			/* skip new line and leading colon */
 			if (pos < size) pos++;
@@ -3107,7 +3580,7 @@ parse_table_row(
 				if (pos < size && data[pos] == ':') pos++;  /* skip colon */
 			}
 
-			parse_table_cell_line(cell_content, data, size, pos, ':', 1 /* is_contination */);
+			parse_table_cell_line(cell_content, doc, data, size, pos, ':', 1 /* is_contination */);
 
 			extra_rows_in_cell--;
 		}
@@ -3116,8 +3589,6 @@ parse_table_row(
 
 		doc->md.table_cell(row_work, cell_work, col_data[col] | header_flag, &doc->data);
 
-		popbuf(doc, BUFFER_SPAN);
-		popbuf(doc, BUFFER_SPAN);
 		i++;
 	}
 
@@ -3129,6 +3600,23 @@ parse_table_row(
 	doc->md.table_row(ob, row_work, &doc->data);
 
 	popbuf(doc, BUFFER_SPAN);
+	popbuf(doc, BUFFER_SPAN);
+	popbuf(doc, BUFFER_SPAN);
+}
+
+/* table_flags_reserve • readies the column flags shared by every table */
+static hoedown_table_flags *
+table_flags_reserve(hoedown_document *doc, size_t columns)
+{
+	struct table_work *tw = &doc->table_work;
+
+	if (columns > tw->col_asize) {
+		tw->col_data = hoedown_realloc(tw->col_data, columns * sizeof(hoedown_table_flags));
+		tw->col_asize = columns;
+	}
+
+	memset(tw->col_data, 0x0, columns * sizeof(hoedown_table_flags));
+	return tw->col_data;
 }
 
 static size_t
@@ -3145,15 +3633,12 @@ parse_table_header(
 	size_t i = 0, col, header_end, under_end;
 	hoedown_buffer *header_contents = 0;
 
-	pipes = 0;
-	while (i < size && data[i] != '\n') {
-		if (!is_backslashed(data, i) && data[i] == '|') {
-			pipes++;
-		}
-		i++;
-	}
+	i = find_newline(doc, data, size);
+	if (i == size)
+		return 0;
 
-	if (i == size || pipes == 0)
+	pipes = (int)count_table_separators(data, 0, i, '|');
+	if (pipes == 0)
 		return 0;
 
 	header_end = i;
@@ -3191,7 +3676,7 @@ parse_table_header(
 	hoedown_buffer_put(header_contents, data, header_end);
 
 	*columns = pipes + 1;
-	*column_data = hoedown_calloc(*columns, sizeof(hoedown_table_flags));
+	*column_data = table_flags_reserve(doc, *columns);
 
 	/* If the multiline table extension is enabled, check the next lines for
 	   continuation markers, to find the number of text rows that make up this
@@ -3244,9 +3729,7 @@ parse_table_header(
 	if (i < size && data[i] == '|')
 		i++;
 
-	under_end = i;
-	while (under_end < size && data[under_end] != '\n')
-		under_end++;
+	under_end = i < size ? i + find_newline(doc, data + i, size - i) : i;
 
 	for (col = 0; col < *columns && i < under_end; ++col) {
 		size_t dashes = 0;
@@ -3301,6 +3784,24 @@ parse_table_header(
 	return under_end + 1;
 }
 
+/* table_rows_push • appends a row span to the table scratch array */
+static void
+table_rows_push(struct table_work *tw, size_t beg, size_t end, size_t lines)
+{
+	if (tw->count >= tw->asize) {
+		tw->asize = tw->asize ? tw->asize * 2 : 64;
+		tw->rows = hoedown_realloc(tw->rows, tw->asize * sizeof(struct table_row));
+	}
+
+	tw->rows[tw->count].beg = beg;
+	tw->rows[tw->count].end = end;
+	tw->rows[tw->count].lines = lines;
+	tw->count++;
+}
+
+/* parse_table • splits the whole body into row spans first, then renders
+ * them; the row array and column flags are owned by the document and
+ * reused, since a table never contains another one */
 static size_t
 parse_table(
 	hoedown_buffer *ob,
@@ -3308,13 +3809,14 @@ parse_table(
 	uint8_t *data,
 	size_t size)
 {
-	size_t i;
+	size_t i, r;
 
 	hoedown_buffer *work = 0;
 	hoedown_buffer *header_work = 0;
 	hoedown_buffer *body_work = 0;
 	hoedown_buffer *attr_work = 0;
 
+	struct table_work *tw = &doc->table_work;
 	size_t columns;
 	hoedown_table_flags *col_data = NULL;
 
@@ -3324,20 +3826,19 @@ parse_table(
 	attr_work = newbuf(doc, BUFFER_ATTRIBUTE);
 	i = parse_table_header(header_work, attr_work, doc, data, size, &columns, &col_data);
 	if (i > 0) {
+		tw->count = 0;
 
+		/* first pass: find the extent of every row */
 		while (i < size) {
 			size_t row_start;
-			int pipes = 0;
+			int pipes;
 			size_t rows = 1;
 
 			row_start = i;
+			i += find_newline(doc, data + i, size - i);
 
-			while (i < size && data[i] != '\n') {
-				if (data[i] == '|' && !is_backslashed(data, i)) pipes++;
-				i++;
-			}
-
-			if (pipes == 0 || i == size) {
+			pipes = (i < size) ? (int)count_table_separators(data, row_start, i, '|') : 0;
+			if (pipes == 0) {
 				i = row_start;
 				break;
 			}
@@ -3356,8 +3857,8 @@ parse_table(
 			*/
 			if ((doc->ext_flags & HOEDOWN_EXT_MULTILINE_TABLES) != 0) {
 				while (i < size) {
-					size_t j = i + 1;
-					int colons = 0;
+					size_t j = i + 1, line_end;
+					int colons;
 
 					/* Require that a continued row starts with a colon. */
 					if (j >= size || data[j] != ':') break;
@@ -3365,11 +3866,9 @@ parse_table(
 					/* Don't count leading colon for comparison to pipes. */
 					j++;
 
-					while (j < size && data[j] != '\n') {
-						if (!is_backslashed(data, j) && data[j] == ':')
-							colons++;
-						j++;
-					}
+					line_end = j + find_newline(doc, data + j, size - j);
+					colons = (int)count_table_separators(data, j, line_end, ':');
+					j = line_end;
 
 					/* Don't count a trailing colon for comparison to pipes. */
 					if (!is_backslashed(data, j - 1) && data[j - 1] == ':')
@@ -3386,15 +3885,7 @@ parse_table(
 				}
 			}
 
-			parse_table_row(
-				body_work,
-				doc,
-				data + row_start,
-				i - row_start,
-				columns,
-				rows,
-				col_data, 0
-			);
+			table_rows_push(tw, row_start, i, rows);
 
 			i++;
 
@@ -3404,8 +3895,8 @@ parse_table(
 				size_t j = i, next_line_end = i, col;
 
 				/* Seek next_line_end to the position of the terminating new line. */
-				while (next_line_end < size && data[next_line_end] != '\n')
-					next_line_end++;
+				if (next_line_end < size)
+					next_line_end += find_newline(doc, data + next_line_end, size - next_line_end);
 
 				/* Skip leading pipe, if any. */
 				if (j < next_line_end && data[j] == '|')
@@ -3444,6 +3935,19 @@ parse_table(
 			}
 		}
 
+		/* second pass: render the rows */
+		for (r = 0; r < tw->count; r++) {
+			parse_table_row(
+				body_work,
+				doc,
+				data + tw->rows[r].beg,
+				tw->rows[r].end - tw->rows[r].beg,
+				columns,
+				tw->rows[r].lines,
+				col_data, 0
+			);
+		}
+
 		if (doc->md.table_header)
 			doc->md.table_header(work, header_work, &doc->data);
 
@@ -3454,7 +3958,6 @@ parse_table(
 			doc->md.table(ob, work, attr_work, &doc->data);
 	}
 
-	free(col_data);
 	popbuf(doc, BUFFER_SPAN);
 	popbuf(doc, BUFFER_BLOCK);
 	popbuf(doc, BUFFER_BLOCK);
@@ -3502,20 +4005,22 @@ is_paragraph(hoedown_document *doc, uint8_t *txt_data, size_t end)
 	memcpy(&doc->md, &temp_renderer, sizeof(hoedown_renderer));
 	/* these are all the if branches inside parse_block, wrapped into one bool,
 	 * with minimal parsing, and completely idempotent */
-	int result = !(is_atxheader(doc, txt_data, end) ||
+	struct line_class line;
+	classify_line(&line, doc, txt_data, end);
+	int result = !(((line.kinds & MD_LINE_ATXHEADER) && is_atxheader(doc, txt_data, end)) ||
 					(doc->user_block && parse_userblock(tmp, doc, txt_data, end)) ||
-					(txt_data[0] == '<' &&
+					((line.kinds & MD_LINE_HTML) &&
 						parse_htmlblock(tmp, doc, txt_data, end, 0)) ||
-					is_hrule(txt_data, end) ||
-					((doc->ext_flags & HOEDOWN_EXT_FENCED_CODE) &&
+					((line.kinds & MD_LINE_HRULE) && is_hrule(txt_data, end)) ||
+					((doc->ext_flags & HOEDOWN_EXT_FENCED_CODE) && (line.kinds & MD_LINE_FENCE) &&
 						parse_fencedcode(tmp, doc, txt_data, end, doc->ext_flags)) ||
-					((doc->ext_flags & HOEDOWN_EXT_TABLES) &&
+					((doc->ext_flags & HOEDOWN_EXT_TABLES) && (line.kinds & MD_LINE_TABLE) &&
 						parse_table(tmp, doc, txt_data, end)) ||
-					prefix_quote(txt_data, end) ||
+					((line.kinds & MD_LINE_QUOTE) && prefix_quote(txt_data, end)) ||
 					(!(doc->ext_flags & HOEDOWN_EXT_DISABLE_INDENTED_CODE) &&
-						prefix_code(txt_data, end)) ||
-					prefix_uli(txt_data, end) ||
-					prefix_oli(txt_data, end) ||
+						(line.kinds & MD_LINE_CODE) && prefix_code(txt_data, end)) ||
+					((line.kinds & MD_LINE_ULI) && prefix_uli(txt_data, end)) ||
+					((line.kinds & MD_LINE_OLI) && prefix_oli(txt_data, end)) ||
 					((doc->ext_flags & HOEDOWN_EXT_DEFINITION_LISTS) &&
 						prefix_dli(doc, txt_data, end)));
 	popbuf(doc, BUFFER_BLOCK);
@@ -3523,39 +4028,47 @@ is_paragraph(hoedown_document *doc, uint8_t *txt_data, size_t end)
 	return result;
 }
 
-/* parse_block • parsing of one block, returning next uint8_t to parse */
-static void
-parse_block(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t size)
+/* parse_blocks • parsing of the blocks starting before stop, returning the end of the last one;
+ * a block may run past stop, when it can't be told apart from the blocks that follow */
+static size_t
+parse_blocks(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t size, size_t stop)
 {
 	size_t beg, end, i;
 	uint8_t *txt_data;
+	struct line_class line;
 	beg = 0;
 
 	if (doc->work_bufs[BUFFER_SPAN].size +
 		doc->work_bufs[BUFFER_BLOCK].size > doc->max_nesting)
-		return;
+		return size;
 
-	while (beg < size) {
+	/* closing lines found so far may belong to a reused buffer */
+	memset(doc->html_ends, 0x0, sizeof(doc->html_ends));
+
+	while (beg < stop) {
 		txt_data = data + beg;
 		end = size - beg;
 
-		if (is_atxheader(doc, txt_data, end))
+		classify_line(&line, doc, txt_data, end);
+
+		if ((line.kinds & MD_LINE_ATXHEADER) && is_atxheader(doc, txt_data, end))
 			beg += parse_atxheader(ob, doc, txt_data, end);
 
 		else if (doc->user_block &&
 				(i = parse_userblock(ob, doc, txt_data, end)) != 0)
 			beg += i;
 
-		else if (data[beg] == '<' && doc->md.blockhtml &&
+		else if ((line.kinds & MD_LINE_HTML) && doc->md.blockhtml &&
 				(i = parse_htmlblock(ob, doc, txt_data, end, 1)) != 0)
 			beg += i;
 
-		else if ((i = is_empty(txt_data, end)) != 0)
+		else if ((line.kinds & MD_LINE_EMPTY) && (i = is_empty(txt_data, end)) != 0)
 			beg += i;
 
-		else if (is_hrule(txt_data, end)) {
-			while (beg < size && data[beg] != '\n')
-				beg++;
+		else if ((line.kinds & MD_LINE_HRULE) && is_hrule(txt_data, end)) {
+			beg += line.end;
+			if (data[beg - 1] == '\n')
+				beg--;
 
 			if (doc->md.hrule) {
 				doc->hrule_char = data[beg - 1];
@@ -3567,23 +4080,26 @@ parse_block(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t siz
 		}
 
 		else if ((doc->ext_flags & HOEDOWN_EXT_FENCED_CODE) != 0 &&
+			(line.kinds & MD_LINE_FENCE) &&
 			(i = parse_fencedcode(ob, doc, txt_data, end, doc->ext_flags)) != 0)
 			beg += i;
 
 		else if ((doc->ext_flags & HOEDOWN_EXT_TABLES) != 0 &&
+			(line.kinds & MD_LINE_TABLE) &&
 			(i = parse_table(ob, doc, txt_data, end)) != 0)
 			beg += i;
 
-		else if (prefix_quote(txt_data, end))
+		else if ((line.kinds & MD_LINE_QUOTE) && prefix_quote(txt_data, end))
 			beg += parse_blockquote(ob, doc, txt_data, end);
 
-		else if (!(doc->ext_flags & HOEDOWN_EXT_DISABLE_INDENTED_CODE) && prefix_code(txt_data, end))
+		else if (!(doc->ext_flags & HOEDOWN_EXT_DISABLE_INDENTED_CODE) &&
+			(line.kinds & MD_LINE_CODE) && prefix_code(txt_data, end))
 			beg += parse_blockcode(ob, doc, txt_data, end);
 
-		else if (prefix_uli(txt_data, end))
+		else if ((line.kinds & MD_LINE_ULI) && prefix_uli(txt_data, end))
 			beg += parse_list(ob, doc, txt_data, end, 0);
 
-		else if (prefix_oli(txt_data, end))
+		else if ((line.kinds & MD_LINE_OLI) && prefix_oli(txt_data, end))
 			beg += parse_list(ob, doc, txt_data, end, HOEDOWN_LIST_ORDERED);
 
 		else if ((doc->ext_flags & HOEDOWN_EXT_DEFINITION_LISTS) && prefix_dli(doc, txt_data, end))
@@ -3592,6 +4108,346 @@ parse_block(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t siz
 		else
 			beg += parse_paragraph(ob, doc, txt_data, end);
 	}
+
+	return beg;
+}
+
+/* parse_block • parsing of every block in data */
+static void
+parse_block(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t size)
+{
+	parse_blocks(ob, doc, data, size, size);
+}
+
+
+
+/**********************
+ * PARALLEL RENDERING *
+ **********************/
+
+/* Chunks are parsed on their own, each up to the start of the next one, then
+ * stitched in order: a chunk is kept when the parse of the text before it
+ * stopped right at its start, and rendered again from there otherwise. */
+struct render_chunk {
+	size_t beg;	/* offset of the chunk in the text */
+	size_t end;	/* end of its last block, past the next chunk when that one ran over */
+	hoedown_buffer *ob;
+	int seeded;	/* ob starts with a byte standing for the output before the chunk */
+	int needs_serial;
+	int done;	/* end is set, for the worker taking the next chunk */
+};
+
+struct parallel_render {
+	uint8_t *data;
+	size_t size;
+	struct render_chunk *chunks;
+	size_t count;
+	size_t next;
+};
+
+struct parallel_worker {
+	struct parallel_render *job;
+	hoedown_document *fork;
+};
+
+/* find_chunk_start • returns the first line from pos that follows an empty line
+ * and most likely starts a paragraph or a header, or size */
+static size_t
+find_chunk_start(const uint8_t *data, size_t size, size_t pos)
+{
+	const uint8_t *nl;
+
+	while (pos + 2 < size && (nl = memchr(data + pos, '\n', size - pos - 2)) != NULL) {
+		size_t i = nl - data;
+		uint8_t c = data[i + 2];
+
+		if (data[i + 1] == '\n' && (isalpha(c) || c == '#' || c >= 0xC0))
+			return i + 2;
+
+		pos = i + 1;
+	}
+
+	return size;
+}
+
+static void
+render_chunks(struct parallel_worker *worker)
+{
+	struct parallel_render *job = worker->job;
+	hoedown_document *fork = worker->fork;
+	size_t i;
+
+	while ((i = __sync_fetch_and_add(&job->next, 1)) < job->count) {
+		struct render_chunk *chunk = &job->chunks[i];
+		struct render_chunk *prev = i ? &job->chunks[i - 1] : NULL;
+		size_t stop = (i + 1 < job->count ? job->chunks[i + 1].beg : job->size) - chunk->beg;
+
+		/* a block left open (e.g. an unclosed fence) already ran over
+		 * this chunk: don't parse what will be thrown away */
+		if (prev && __sync_fetch_and_add(&prev->done, 0) && prev->end > chunk->beg) {
+			chunk->end = prev->end;
+			chunk->needs_serial = 1;
+		} else {
+			fork->fork_needs_serial = 0;
+			chunk->end = chunk->beg + parse_blocks(chunk->ob, fork,
+				job->data + chunk->beg, job->size - chunk->beg, stop);
+			chunk->needs_serial = fork->fork_needs_serial;
+		}
+
+		__sync_fetch_and_or(&chunk->done, 1);
+	}
+}
+
+#ifdef HOEDOWN_USE_THREADS
+/* Workers are lent to a pool of threads shared by every document, started
+ * as renders ask for more of them and kept for the life of the process.
+ * The calling thread works too, so a worker no thread took in time is
+ * simply withdrawn: the chunks it would have parsed are all done. */
+enum pool_task_state {
+	POOL_TASK_QUEUED,
+	POOL_TASK_RUNNING,
+	POOL_TASK_FINISHED
+};
+
+struct pool_task {
+	struct parallel_worker *worker;
+	struct pool_task *next;
+	enum pool_task_state state;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t queued;
+	pthread_cond_t finished;
+	struct pool_task *head;
+	struct pool_task *tail;
+	unsigned int threads;
+} render_pool = {
+	PTHREAD_MUTEX_INITIALIZER,
+	PTHREAD_COND_INITIALIZER,
+	PTHREAD_COND_INITIALIZER,
+	NULL,
+	NULL,
+	0
+};
+
+static void *
+render_pool_thread(void *unused)
+{
+	(void)unused;
+	pthread_mutex_lock(&render_pool.lock);
+
+	for (;;) {
+		struct pool_task *task;
+
+		while (!render_pool.head)
+			pthread_cond_wait(&render_pool.queued, &render_pool.lock);
+
+		task = render_pool.head;
+		render_pool.head = task->next;
+		if (!render_pool.head)
+			render_pool.tail = NULL;
+		task->state = POOL_TASK_RUNNING;
+
+		pthread_mutex_unlock(&render_pool.lock);
+		render_chunks(task->worker);
+		pthread_mutex_lock(&render_pool.lock);
+
+		task->state = POOL_TASK_FINISHED;
+		pthread_cond_broadcast(&render_pool.finished);
+	}
+
+	return NULL;
+}
+
+/* render_pool_submit • queues the tasks, growing the pool up to one thread each */
+static void
+render_pool_submit(struct pool_task *tasks, unsigned int count)
+{
+	pthread_attr_t attr;
+	pthread_t handle;
+	unsigned int t;
+
+	pthread_mutex_lock(&render_pool.lock);
+
+	for (t = 0; t < count; ++t) {
+		tasks[t].next = NULL;
+		tasks[t].state = POOL_TASK_QUEUED;
+
+		if (render_pool.tail)
+			render_pool.tail->next = &tasks[t];
+		else
+			render_pool.head = &tasks[t];
+		render_pool.tail = &tasks[t];
+	}
+
+	if (render_pool.threads < count && render_pool.threads < PARALLEL_MAX_POOL_THREADS) {
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+		while (render_pool.threads < count && render_pool.threads < PARALLEL_MAX_POOL_THREADS &&
+			pthread_create(&handle, &attr, render_pool_thread, NULL) == 0)
+			render_pool.threads++;
+
+		pthread_attr_destroy(&attr);
+	}
+
+	pthread_cond_broadcast(&render_pool.queued);
+	pthread_mutex_unlock(&render_pool.lock);
+}
+
+/* render_pool_settle • withdraws the tasks still queued, waits for the others */
+static void
+render_pool_settle(struct pool_task *tasks, unsigned int count)
+{
+	unsigned int t;
+
+	pthread_mutex_lock(&render_pool.lock);
+
+	for (t = 0; t < count; ++t) {
+		struct pool_task **link, *prev = NULL;
+
+		if (tasks[t].state == POOL_TASK_QUEUED) {
+			for (link = &render_pool.head; *link != &tasks[t]; link = &(*link)->next)
+				prev = *link;
+
+			*link = tasks[t].next;
+			if (render_pool.tail == &tasks[t])
+				render_pool.tail = prev;
+			continue;
+		}
+
+		while (tasks[t].state != POOL_TASK_FINISHED)
+			pthread_cond_wait(&render_pool.finished, &render_pool.lock);
+	}
+
+	pthread_mutex_unlock(&render_pool.lock);
+}
+#endif
+
+static hoedown_document *
+fork_document(hoedown_document *doc)
+{
+	hoedown_document *fork = hoedown_document_new(&doc->md, doc->ext_flags,
+		doc->max_nesting, doc->attr_activation, doc->user_block, doc->meta);
+
+	fork->data = doc->data;
+	fork->is_fork = 1;
+	return fork;
+}
+
+/* parse_block_parallel • parsing of every block in data, on the document's threads */
+static void
+parse_block_parallel(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t size)
+{
+	struct parallel_render job;
+	struct parallel_worker *workers;
+	size_t count, i, pos;
+	unsigned int t, threads = doc->threads;
+#ifdef HOEDOWN_USE_THREADS
+	struct pool_task *tasks;
+#endif
+
+	count = size / PARALLEL_MIN_CHUNK;
+	if (count > threads * PARALLEL_CHUNKS_PER_THREAD)
+		count = threads * PARALLEL_CHUNKS_PER_THREAD;
+	if (count < 1)
+		count = 1;
+
+	job.data = data;
+	job.size = size;
+	job.chunks = hoedown_calloc(count, sizeof(struct render_chunk));
+	job.count = 0;
+	job.next = 0;
+
+	for (i = 0, pos = 0; i < count && pos < size; ++i) {
+		struct render_chunk *chunk = &job.chunks[job.count++];
+		size_t target = (i + 1) * (size / count);
+
+		chunk->beg = pos;
+		chunk->ob = hoedown_buffer_new(64);
+		pos = find_chunk_start(data, size, target > pos ? target : pos + 1);
+	}
+
+	/* callbacks look at the output before them, if at all, to tell whether
+	 * it is empty: blocks end with a newline, and so does the output when
+	 * a chunk is kept */
+	for (i = 0; i < job.count; ++i) {
+		struct render_chunk *chunk = &job.chunks[i];
+		size_t next = i + 1 < job.count ? job.chunks[i + 1].beg : size;
+
+		hoedown_buffer_grow(chunk->ob, next - chunk->beg + ((next - chunk->beg) >> 1) + 1);
+		if (i > 0 || ob->size) {
+			hoedown_buffer_putc(chunk->ob, i > 0 ? '\n' : ob->data[ob->size - 1]);
+			chunk->seeded = 1;
+		}
+	}
+
+	if (!doc->forks)
+		doc->forks = hoedown_calloc(threads, sizeof(hoedown_document *));
+
+	workers = hoedown_calloc(threads, sizeof(struct parallel_worker));
+	for (t = 0; t < threads; ++t) {
+		hoedown_document *fork = doc->forks[t];
+
+		if (!fork)
+			fork = doc->forks[t] = fork_document(doc);
+
+		memcpy(fork->refs, doc->refs, sizeof(doc->refs));
+		fork->footnotes = doc->footnotes;
+		fork->lines = doc->lines;
+
+		workers[t].job = &job;
+		workers[t].fork = fork;
+	}
+
+#ifdef HOEDOWN_USE_THREADS
+	tasks = hoedown_calloc(threads - 1, sizeof(struct pool_task));
+	for (t = 1; t < threads; ++t)
+		tasks[t - 1].worker = &workers[t];
+
+	/* the calling thread is the first worker, the pool's take what is left */
+	render_pool_submit(tasks, threads - 1);
+	render_chunks(&workers[0]);
+	render_pool_settle(tasks, threads - 1);
+
+	free(tasks);
+#else
+	render_chunks(&workers[0]);
+#endif
+
+	/* the forks only borrowed these */
+	for (t = 0; t < threads; ++t) {
+		hoedown_document *fork = doc->forks[t];
+
+		memset(fork->refs, 0x0, sizeof(fork->refs));
+		memset(&fork->footnotes, 0x0, sizeof(fork->footnotes));
+		memset(&fork->lines, 0x0, sizeof(fork->lines));
+	}
+
+	for (i = 0, pos = 0; i < job.count; ++i) {
+		struct render_chunk *chunk = &job.chunks[i];
+		size_t next = i + 1 < job.count ? job.chunks[i + 1].beg : size;
+
+		/* swallowed by a block that started in an earlier chunk */
+		if (pos >= next) {
+			hoedown_buffer_free(chunk->ob);
+			continue;
+		}
+
+		if (pos == chunk->beg && !chunk->needs_serial && (chunk->seeded ?
+			ob->size && ob->data[ob->size - 1] == chunk->ob->data[0] : !ob->size)) {
+			hoedown_buffer_put(ob, chunk->ob->data + chunk->seeded, chunk->ob->size - chunk->seeded);
+			pos = chunk->end;
+		} else {
+			pos += parse_blocks(ob, doc, data + pos, size - pos, next - pos);
+		}
+
+		hoedown_buffer_free(chunk->ob);
+	}
+
+	free(job.chunks);
+	free(workers);
 }
 
 
@@ -3602,7 +4458,7 @@ parse_block(hoedown_buffer *ob, hoedown_document *doc, uint8_t *data, size_t siz
 
 /* is_footnote • returns whether a line is a footnote definition or not */
 static int
-is_footnote(const uint8_t *data, size_t beg, size_t end, size_t *last, struct footnote_list *list)
+is_footnote(const uint8_t *data, size_t beg, size_t end, size_t *last, struct footnote_registry *list)
 {
 	size_t i = 0;
 	hoedown_buffer *contents = NULL;
@@ -3716,12 +4572,12 @@ is_footnote(const uint8_t *data, size_t beg, size_t end, size_t *last, struct fo
 
 	if (list) {
 		struct footnote_ref *ref;
-		ref = create_footnote_ref(list, data + id_offset, id_end - id_offset);
-		if (!ref)
-			return 0;
-		if (!add_footnote_ref(list, ref)) {
-			free_footnote_ref(ref);
-			return 0;
+		ref = add_footnote_ref(list, data + id_offset, id_end - id_offset);
+		if (!ref) {
+			/* a later definition of the same footnote is dropped */
+			hoedown_buffer_free(contents);
+			hoedown_buffer_free(name);
+			return 1;
 		}
 		ref->contents = contents;
 		hoedown_buffer_put(name, data + id_offset, id_end - id_offset);
@@ -3982,6 +4838,12 @@ hoedown_document_new(
 	hoedown_stack_init(&doc->work_bufs[BUFFER_SPAN], 8);
 	hoedown_stack_init(&doc->work_bufs[BUFFER_ATTRIBUTE], 8);
 
+	memset(&doc->lines, 0x0, sizeof(doc->lines));
+	memset(&doc->table_work, 0x0, sizeof(doc->table_work));
+	memset(&doc->footnotes, 0x0, sizeof(doc->footnotes));
+	memset(doc->html_ends, 0x0, sizeof(doc->html_ends));
+	doc->html_ends_next = 0;
+
 	memset(doc->active_char, 0x0, 256);
 
 	if (extensions & HOEDOWN_EXT_UNDERLINE && doc->md.underline) {
@@ -4048,6 +4910,11 @@ hoedown_document_new(
 	doc->user_block = user_block;
 	doc->meta = meta;
 
+	doc->threads = 1;
+	doc->forks = NULL;
+	doc->is_fork = 0;
+	doc->fork_needs_serial = 0;
+
 	return doc;
 }
 
@@ -4056,11 +4923,20 @@ hoedown_document_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t
 {
 	static const uint8_t UTF8_BOM[] = {0xEF, 0xBB, 0xBF};
 
-	hoedown_buffer *text;
+	hoedown_buffer *text, *repaired = NULL;
 	size_t beg, end;
 
 	int footnotes_enabled;
 
+	/* valid input is parsed in place, only broken input is copied */
+	if ((doc->ext_flags & HOEDOWN_EXT_SANITIZE_UTF8) &&
+		hoedown_utf8_valid_length(data, size) < size) {
+		repaired = hoedown_buffer_new(64);
+		hoedown_buffer_put_utf8_repaired(repaired, data, size);
+		data = repaired->data;
+		size = repaired->size;
+	}
+
 	text = hoedown_buffer_new(64);
 
 	/* Preallocate enough space for our buffer to avoid expanding while copying */
@@ -4071,12 +4947,6 @@ hoedown_document_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t
 
 	footnotes_enabled = doc->ext_flags & HOEDOWN_EXT_FOOTNOTES;
 
-	/* reset the footnotes lists */
-	if (footnotes_enabled) {
-		memset(&doc->footnotes_found, 0x0, sizeof(doc->footnotes_found));
-		memset(&doc->footnotes_used, 0x0, sizeof(doc->footnotes_used));
-	}
-
 	/* first pass: looking for references, copying everything else */
 	beg = 0;
 
@@ -4086,7 +4956,7 @@ hoedown_document_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t
 		beg += 3;
 
 	while (beg < size) /* iterating over lines */
-		if (footnotes_enabled && is_footnote(data, beg, size, &end, &doc->footnotes_found)) {
+		if (footnotes_enabled && is_footnote(data, beg, size, &end, &doc->footnotes)) {
 			if (doc->md.footnote_ref_def) {
 				hoedown_buffer original = { NULL, 0, 0, 0, NULL, NULL, NULL };
 				original.data = (uint8_t*) (data + beg);
@@ -4144,34 +5014,64 @@ hoedown_document_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t
 		if (text->data[text->size - 1] != '\n')
 			hoedown_buffer_putc(text, '\n');
 
-		parse_block(ob, doc, text->data, text->size);
+		line_index_build(&doc->lines, text->data, text->size);
+		if (doc->threads > 1 && (doc->md.flags & HOEDOWN_RENDERER_CONCURRENT) && text->size >= PARALLEL_MIN_SIZE)
+			parse_block_parallel(ob, doc, text->data, text->size);
+		else
+			parse_block(ob, doc, text->data, text->size);
+		doc->lines.data = NULL;
 	}
 
 	/* footnotes */
 	if (footnotes_enabled)
-		parse_footnote_list(ob, doc, &doc->footnotes_used);
+		parse_footnote_list(ob, doc, &doc->footnotes);
 
 	if (doc->md.doc_footer)
 		doc->md.doc_footer(ob, 0, &doc->data);
 
 	/* clean-up */
 	hoedown_buffer_free(text);
+	if (repaired)
+		hoedown_buffer_free(repaired);
 	free_link_refs(doc->refs);
-	if (footnotes_enabled) {
-		free_footnote_list(&doc->footnotes_found, 1);
-		free_footnote_list(&doc->footnotes_used, 0);
-	}
+	reset_footnote_registry(&doc->footnotes);
 
 	assert(doc->work_bufs[BUFFER_SPAN].size == 0);
 	assert(doc->work_bufs[BUFFER_BLOCK].size == 0);
 	assert(doc->work_bufs[BUFFER_ATTRIBUTE].size == 0);
 }
 
+void
+hoedown_document_render_utf16(hoedown_document *doc, hoedown_buffer *ob, const uint16_t *data, size_t size)
+{
+	static const uint16_t UTF16_BOM = 0xFEFF;
+
+	hoedown_buffer *utf8 = hoedown_buffer_new(64);
+
+	if (size && data[0] == UTF16_BOM) {
+		data++;
+		size--;
+	}
+
+	hoedown_buffer_put_utf16(utf8, data, size);
+	hoedown_document_render(doc, ob, utf8->data, utf8->size);
+
+	hoedown_buffer_free(utf8);
+}
+
 void
 hoedown_document_render_inline(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t size)
 {
 	size_t i = 0, mark;
-	hoedown_buffer *text = hoedown_buffer_new(64);
+	hoedown_buffer *text = hoedown_buffer_new(64), *repaired = NULL;
+
+	if ((doc->ext_flags & HOEDOWN_EXT_SANITIZE_UTF8) &&
+		hoedown_utf8_valid_length(data, size) < size) {
+		repaired = hoedown_buffer_new(64);
+		hoedown_buffer_put_utf8_repaired(repaired, data, size);
+		data = repaired->data;
+		size = repaired->size;
+	}
 
 	/* reset the references table */
 	memset(&doc->refs, 0x0, REF_TABLE_SIZE * sizeof(void *));
@@ -4209,16 +5109,45 @@ hoedown_document_render_inline(hoedown_document *doc, hoedown_buffer *ob, const
 
 	/* clean-up */
 	hoedown_buffer_free(text);
+	if (repaired)
+		hoedown_buffer_free(repaired);
 
 	assert(doc->work_bufs[BUFFER_SPAN].size == 0);
 	assert(doc->work_bufs[BUFFER_BLOCK].size == 0);
 }
 
+void
+hoedown_document_set_threads(hoedown_document *doc, unsigned int threads)
+{
+	size_t i;
+
+	if (threads < 1)
+		threads = 1;
+
+	/* forks are made for the new count on the next render */
+	if (doc->forks) {
+		for (i = 0; i < doc->threads; ++i)
+			if (doc->forks[i])
+				hoedown_document_free(doc->forks[i]);
+		free(doc->forks);
+		doc->forks = NULL;
+	}
+
+	doc->threads = threads;
+}
+
 void
 hoedown_document_free(hoedown_document *doc)
 {
 	size_t i;
 
+	if (doc->forks) {
+		for (i = 0; i < doc->threads; ++i)
+			if (doc->forks[i])
+				hoedown_document_free(doc->forks[i]);
+		free(doc->forks);
+	}
+
 	for (i = 0; i < (size_t)doc->work_bufs[BUFFER_SPAN].asize; ++i)
 		hoedown_buffer_free(doc->work_bufs[BUFFER_SPAN].item[i]);
 
@@ -4232,6 +5161,13 @@ hoedown_document_free(hoedown_document *doc)
 	hoedown_stack_uninit(&doc->work_bufs[BUFFER_BLOCK]);
 	hoedown_stack_uninit(&doc->work_bufs[BUFFER_ATTRIBUTE]);
 
+	free(doc->lines.newlines);
+	free(doc->table_work.rows);
+	free(doc->table_work.col_data);
+	free(doc->footnotes.refs);
+	free(doc->footnotes.slots);
+	free(doc->footnotes.used);
+	free(doc->footnotes.order);
 	free(doc);
 }
 
@@ -15,7 +15,7 @@ extern "C" {
  * CONSTANTS *
  *************/
 
-/* Next offset: 22 */
+/* Next offset: 23 */
 typedef enum hoedown_extensions {
 	/* block-level extensions */
 	HOEDOWN_EXT_TABLES = (1 << 0),
@@ -40,6 +40,7 @@ typedef enum hoedown_extensions {
 	HOEDOWN_EXT_MATH_EXPLICIT = (1 << 13),
 	HOEDOWN_EXT_HTML5_BLOCKS = (1 << 20),
 	HOEDOWN_EXT_NO_INTRA_UNDERLINE_EMPHASIS = (1 << 21),
+	HOEDOWN_EXT_SANITIZE_UTF8 = (1 << 22),	/* replace NUL and invalid UTF-8 with U+FFFD */
 
 	/* negative flags */
 	HOEDOWN_EXT_DISABLE_INDENTED_CODE = (1 << 14),
@@ -78,7 +79,8 @@ typedef enum hoedown_extensions {
 	HOEDOWN_EXT_SPECIAL_ATTRIBUTE |\
 	HOEDOWN_EXT_SCRIPT_TAGS |\
 	HOEDOWN_EXT_META_BLOCK |\
-	HOEDOWN_EXT_HTML5_BLOCKS)
+	HOEDOWN_EXT_HTML5_BLOCKS |\
+	HOEDOWN_EXT_SANITIZE_UTF8)
 
 #define HOEDOWN_EXT_NEGATIVE (\
 	HOEDOWN_EXT_DISABLE_INDENTED_CODE )
@@ -113,6 +115,10 @@ typedef enum hoedown_header_type {
 	HOEDOWN_HEADER_SETEXT  /* e.g. "Foo\n---" or "Foo\n===" */
 } hoedown_header_type;
 
+typedef enum hoedown_renderer_flags {
+	HOEDOWN_RENDERER_CONCURRENT = (1 << 0)	/* callbacks may run on several threads at once */
+} hoedown_renderer_flags;
+
 typedef enum hoedown_link_type {
 	HOEDOWN_LINK_NONE,            /* not in a link */
 	HOEDOWN_LINK_INLINE,          /* e.g. [foo](/bar/) */
@@ -189,6 +195,9 @@ struct hoedown_renderer {
 	void (*ref)(hoedown_buffer *orig, const hoedown_renderer_data *data);
 	/* called when a footnote reference definition is parsed */
 	void (*footnote_ref_def)(hoedown_buffer *orig, const hoedown_renderer_data *data);
+
+	/* what the renderer allows, e.g. HOEDOWN_RENDERER_CONCURRENT */
+	hoedown_renderer_flags flags;
 };
 typedef struct hoedown_renderer hoedown_renderer;
 
@@ -212,9 +221,19 @@ hoedown_document *hoedown_document_new(
 /* hoedown_document_render: render regular Markdown using the document processor */
 void hoedown_document_render(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t size);
 
+/* hoedown_document_render_utf16: render regular Markdown given as UTF-16 code
+ * units (host byte order); the output is UTF-8, like hoedown_document_render */
+void hoedown_document_render_utf16(hoedown_document *doc, hoedown_buffer *ob, const uint16_t *data, size_t size);
+
 /* hoedown_document_render_inline: render inline Markdown using the document processor */
 void hoedown_document_render_inline(hoedown_document *doc, hoedown_buffer *ob, const uint8_t *data, size_t size);
 
+/* hoedown_document_set_threads: render large documents on up to this many threads, 1 (the default) renders
+ * on the calling thread only. The output doesn't change. Only renderers flagged HOEDOWN_RENDERER_CONCURRENT
+ * are ever run on several threads, since the block and span callbacks then share the renderer state; the
+ * threads are taken from a pool kept for the life of the process. */
+void hoedown_document_set_threads(hoedown_document *doc, unsigned int threads);
+
 /* hoedown_document_free: deallocate a document processor instance */
 void hoedown_document_free(hoedown_document *doc);
 
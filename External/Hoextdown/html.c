@@ -6,7 +6,6 @@
 #include <ctype.h>
 
 #include "escape.h"
-#include "hash.h"
 
 #ifdef _MSC_VER
 #define strncasecmp    _strnicmp
@@ -58,6 +57,36 @@ static void escape_href(hoedown_buffer *ob, const uint8_t *source, size_t length
 	hoedown_escape_href(ob, source, length);
 }
 
+/* Writes text that lies outside of any tag, applying SmartyPants to it when
+ * enabled so that the output needs no second pass. */
+static void
+rndr_text(hoedown_buffer *ob, const uint8_t *source, size_t length, int escape, hoedown_html_renderer_state *state)
+{
+	if (state->flags & HOEDOWN_HTML_SMARTYPANTS)
+		hoedown_html_smartypants_text(ob, &state->smartypants.state, state->smartypants.text, source, length, escape);
+	else if (escape)
+		escape_html(ob, source, length);
+	else
+		hoedown_buffer_put(ob, source, length);
+}
+
+/* Shows the code markup written to ob since start to the SmartyPants stage
+ * while raw HTML has it skipping, as its closing tag may be in there. */
+static void
+rndr_text_markup(hoedown_buffer *ob, size_t start, hoedown_html_renderer_state *state)
+{
+	hoedown_buffer *markup;
+
+	if ((state->flags & HOEDOWN_HTML_SMARTYPANTS) == 0 || !state->smartypants.state.skip_tag)
+		return;
+
+	markup = hoedown_buffer_new(64);
+	hoedown_buffer_put(markup, ob->data + start, ob->size - start);
+	ob->size = start;
+	rndr_text(ob, markup->data, markup->size, 0, state);
+	hoedown_buffer_free(markup);
+}
+
 /********************
  * GENERIC RENDERER *
  ********************/
@@ -175,6 +204,10 @@ rndr_autolink(hoedown_buffer *ob, const hoedown_buffer *link, hoedown_autolink_t
 	if (!link || !link->size)
 		return 0;
 
+	/* the parser took the start of the link back out of the text before it */
+	if (state->flags & HOEDOWN_HTML_SMARTYPANTS)
+		hoedown_html_smartypants_rewound(ob, &state->smartypants.state, state->smartypants.text);
+
 	HOEDOWN_BUFPUTSL(ob, "<a href=\"");
 	if (type == HOEDOWN_AUTOLINK_EMAIL)
 		HOEDOWN_BUFPUTSL(ob, "mailto:");
@@ -194,9 +227,9 @@ rndr_autolink(hoedown_buffer *ob, const hoedown_buffer *link, hoedown_autolink_t
 	 * want to print the `mailto:` prefix
 	 */
 	if (hoedown_buffer_prefix(link, "mailto:") == 0) {
-		escape_html(ob, link->data + 7, link->size - 7);
+		rndr_text(ob, link->data + 7, link->size - 7, 1, state);
 	} else {
-		escape_html(ob, link->data, link->size);
+		rndr_text(ob, link->data, link->size, 1, state);
 	}
 
 	HOEDOWN_BUFPUTSL(ob, "</a>");
@@ -207,10 +240,13 @@ rndr_autolink(hoedown_buffer *ob, const hoedown_buffer *link, hoedown_autolink_t
 static void
 rndr_blockcode(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_buffer *lang, const hoedown_buffer *attr, const hoedown_renderer_data *data)
 {
+	hoedown_html_renderer_state *state = data->opaque;
+	size_t org;
+
 	if (ob->size) hoedown_buffer_putc(ob, '\n');
+	org = ob->size;
 
 	if (lang) {
-		hoedown_html_renderer_state *state = data->opaque;
 		if ((state->flags & HOEDOWN_HTML_FENCED_CODE_SCRIPT) &&
 		    lang->size > 7 && memcmp(lang->data, "script@", 7) == 0 && text) {
 			HOEDOWN_BUFPUTSL(ob, "<script type=\"");
@@ -218,6 +254,7 @@ rndr_blockcode(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_buf
 			HOEDOWN_BUFPUTSL(ob, "\">\n");
 			hoedown_buffer_put(ob, text->data, text->size);
 			HOEDOWN_BUFPUTSL(ob, "</script>\n");
+			rndr_text_markup(ob, org, state);
 			return;
 		}
 		HOEDOWN_BUFPUTSL(ob, "<pre><code");
@@ -250,6 +287,7 @@ rndr_blockcode(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_buf
 		escape_html(ob, text->data, text->size);
 
 	HOEDOWN_BUFPUTSL(ob, "</code></pre>\n");
+	rndr_text_markup(ob, org, state);
 }
 
 static void
@@ -264,6 +302,8 @@ rndr_blockquote(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown
 static int
 rndr_codespan(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_buffer *attr, const hoedown_renderer_data *data)
 {
+	size_t org = ob->size;
+
 	HOEDOWN_BUFPUTSL(ob, "<code");
 	if (attr && attr->size) {
 		rndr_attributes(ob, attr->data, attr->size, NULL, data);
@@ -271,6 +311,7 @@ rndr_codespan(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_buff
 	hoedown_buffer_putc(ob, '>');
 	if (text) escape_html(ob, text->data, text->size);
 	HOEDOWN_BUFPUTSL(ob, "</code>");
+	rndr_text_markup(ob, org, data->opaque);
 	return 1;
 }
 
@@ -356,55 +397,248 @@ rndr_linebreak(hoedown_buffer *ob, const hoedown_renderer_data *data)
 	return 1;
 }
 
+/* header id slugs: how each byte of the header text is written */
+enum header_id_action {
+	HEADER_ID_SKIP = 0,
+	HEADER_ID_KEEP,
+	HEADER_ID_LOWER,
+	HEADER_ID_SPACE,
+	HEADER_ID_ENTITY,
+	HEADER_ID_TAG,
+	HEADER_ID_UTF8
+};
+
+static const uint8_t header_id_actions[UINT8_MAX+1] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	3, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 1, 0, 0,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 5, 0, 0, 0,
+	0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 1,
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+};
+
+/* Lower case for the two byte UTF-8 scripts most headers use (Latin, Greek,
+ * Cyrillic): codepoints from first to last, every step, move by delta. */
+static const struct {
+	uint16_t first, last;
+	int16_t delta;
+	uint8_t step;
+} header_id_folds[] = {
+	{ 0x00C0, 0x00D6, 32, 1 },
+	{ 0x00D8, 0x00DE, 32, 1 },
+	{ 0x0100, 0x012F, 1, 2 },
+	{ 0x0132, 0x0137, 1, 2 },
+	{ 0x0139, 0x0148, 1, 2 },
+	{ 0x014A, 0x0177, 1, 2 },
+	{ 0x0178, 0x0178, -121, 1 },
+	{ 0x0179, 0x017E, 1, 2 },
+	{ 0x0386, 0x0386, 38, 1 },
+	{ 0x0388, 0x038A, 37, 1 },
+	{ 0x038C, 0x038C, 64, 1 },
+	{ 0x038E, 0x038F, 63, 1 },
+	{ 0x0391, 0x03A1, 32, 1 },
+	{ 0x03A3, 0x03AB, 32, 1 },
+	{ 0x0400, 0x040F, 80, 1 },
+	{ 0x0410, 0x042F, 32, 1 },
+	{ 0x0460, 0x0481, 1, 2 },
+	{ 0x048A, 0x04BF, 1, 2 },
+	{ 0x04C1, 0x04CE, 1, 2 },
+	{ 0x04D0, 0x04FF, 1, 2 },
+};
+
+static unsigned int
+header_id_fold(unsigned int cp)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(header_id_folds) / sizeof(header_id_folds[0]); ++i) {
+		if (cp < header_id_folds[i].first)
+			break;
+		if (cp <= header_id_folds[i].last) {
+			if ((cp - header_id_folds[i].first) % header_id_folds[i].step == 0)
+				cp += header_id_folds[i].delta;
+			break;
+		}
+	}
+
+	return cp;
+}
+
+/* Dedup counters for header ids, keyed by header text. The keys are kept
+ * back to back in one buffer and the table is open addressed, so adding a
+ * header allocates nothing once they have grown. */
+struct hoedown_html_header_id {
+	uint32_t hash;
+	size_t key;
+	size_t key_size;
+	size_t count;
+};
+
+static uint32_t
+header_id_hash(const uint8_t *key, size_t size)
+{
+	uint32_t hash = 0x811c9dc5;
+	size_t i;
+
+	for (i = 0; i < size; ++i) {
+		hash ^= key[i];
+		hash *= 0x01000193;
+	}
+
+	return hash;
+}
+
+static struct hoedown_html_header_id *
+header_id_slot(hoedown_html_renderer_state *state, uint32_t hash, const uint8_t *key, size_t size)
+{
+	struct hoedown_html_header_id *slot;
+	size_t i = hash & (state->header_ids.asize - 1);
+
+	for (;; i = (i + 1) & (state->header_ids.asize - 1)) {
+		slot = &state->header_ids.slots[i];
+		if (!slot->key_size && !slot->hash)
+			return slot;
+		if (slot->hash == hash && slot->key_size == size &&
+			memcmp(state->header_ids.keys->data + slot->key, key, size) == 0)
+			return slot;
+	}
+}
+
+static void
+header_id_grow(hoedown_html_renderer_state *state)
+{
+	struct hoedown_html_header_id *old = state->header_ids.slots;
+	size_t i, old_size = state->header_ids.asize;
+
+	state->header_ids.asize = old_size ? old_size * 2 : 64;
+	state->header_ids.slots = hoedown_calloc(state->header_ids.asize, sizeof(struct hoedown_html_header_id));
+
+	for (i = 0; i < old_size; ++i) {
+		if (old[i].key_size || old[i].hash) {
+			const uint8_t *key = state->header_ids.keys->data + old[i].key;
+			*header_id_slot(state, old[i].hash, key, old[i].key_size) = old[i];
+		}
+	}
+
+	free(old);
+}
+
+/* Returns how many headers had this text before. */
+static size_t
+header_id_count(hoedown_html_renderer_state *state, const uint8_t *key, size_t size)
+{
+	struct hoedown_html_header_id *slot;
+	uint32_t hash = header_id_hash(key, size);
+
+	if (!state->header_ids.keys)
+		state->header_ids.keys = hoedown_buffer_new(256);
+
+	if ((state->header_ids.count + 1) * 4 > state->header_ids.asize * 3)
+		header_id_grow(state);
+
+	slot = header_id_slot(state, hash, key, size);
+	if (slot->key_size || slot->hash)
+		return ++slot->count;
+
+	slot->hash = hash;
+	slot->key = state->header_ids.keys->size;
+	slot->key_size = size;
+	slot->count = 0;
+	hoedown_buffer_put(state->header_ids.keys, key, size);
+	state->header_ids.count++;
+	return 0;
+}
+
 static void
 rndr_header_id(hoedown_buffer *ob, const uint8_t *source, size_t length, int escape, const hoedown_renderer_data *data)
 {
-	size_t i = 0, n = 0;
+	static const char hex_chars[] = "0123456789ABCDEF";
 	hoedown_html_renderer_state *state = data->opaque;
-	hoedown_hash *hash = state->hash.header_id;
+	size_t i = 0, n;
+	uint8_t *out;
+
+	/* the slug is never longer than three bytes per byte of text, plus
+	 * the counter */
+	hoedown_buffer_grow(ob, ob->size + length * 3 + 24);
+	out = ob->data + ob->size;
 
 	while (i < length) {
-		if (isalnum(source[i])) {
-			hoedown_buffer_putc(ob, tolower(source[i]));
-		} else if (source[i] == ' ') {
-			hoedown_buffer_putc(ob, '-');
-		} else if (source[i] == '-' || source[i] == '_') {
-			hoedown_buffer_putc(ob, source[i]);
-		} else if (!isascii(source[i])) {
-			if (escape) {
-				hoedown_buffer_printf(ob, "%%%02X", source[i]);
-			} else {
-				hoedown_buffer_putc(ob, source[i]);
-			}
-		} else if (source[i] == '&') {
-			while (i < length && source[i] != ';') {
+		size_t org = i;
+		uint8_t utf8[2];
+		size_t utf8_len = 1;
+
+		while (i < length && header_id_actions[source[i]] == HEADER_ID_KEEP)
+			i++;
+
+		if (i > org) {
+			memcpy(out, source + org, i - org);
+			out += i - org;
+		}
+
+		if (i >= length)
+			break;
+
+		switch (header_id_actions[source[i]]) {
+		case HEADER_ID_LOWER:
+			*out++ = source[i] + ('a' - 'A');
+			break;
+
+		case HEADER_ID_SPACE:
+			*out++ = '-';
+			break;
+
+		case HEADER_ID_ENTITY:
+			while (i < length && source[i] != ';')
 				++i;
-			}
-		} else if (source[i] == '<') {
-			while (i < length && source[i] != '>') {
+			break;
+
+		case HEADER_ID_TAG:
+			while (i < length && source[i] != '>')
 				++i;
+			break;
+
+		case HEADER_ID_UTF8:
+			utf8[0] = source[i];
+
+			/* fold the case of two byte sequences */
+			if ((source[i] & 0xE0) == 0xC0 && i + 1 < length && (source[i + 1] & 0xC0) == 0x80) {
+				unsigned int cp = header_id_fold(((source[i] & 0x1F) << 6) | (source[i + 1] & 0x3F));
+				utf8[0] = 0xC0 | (cp >> 6);
+				utf8[1] = 0x80 | (cp & 0x3F);
+				utf8_len = 2;
+				i++;
 			}
-		}
-		++i;
-	}
 
-	if (hash) {
-		void *value = hoedown_hash_find(hash, (char *)source, length);
-		if (value) {
-			size_t *p = (size_t *)value;
-			++(*p);
-			n = *p;
-		}
-		if (n > 0) {
-			hoedown_buffer_printf(ob, "-%ld", n);
-		} else if (hash) {
-			size_t *p = (size_t *)malloc(sizeof(size_t));
-			if (p) {
-				*p = 0;
-				hoedown_hash_add(hash, (char *)source, length, (void *)p, free);
+			for (n = 0; n < utf8_len; ++n) {
+				if (escape) {
+					*out++ = '%';
+					*out++ = hex_chars[utf8[n] >> 4];
+					*out++ = hex_chars[utf8[n] & 0xF];
+				} else {
+					*out++ = utf8[n];
+				}
 			}
+			break;
 		}
+
+		++i;
 	}
+
+	ob->size = out - ob->data;
+
+	n = header_id_count(state, source, length);
+	if (n > 0)
+		hoedown_buffer_printf(ob, "-%ld", n);
 }
 
 static void
@@ -646,6 +880,7 @@ rndr_paragraph(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_
 static void
 rndr_raw_block(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_renderer_data *data)
 {
+	hoedown_html_renderer_state *state = data->opaque;
 	size_t org, sz;
 
 	if (!text)
@@ -666,7 +901,7 @@ rndr_raw_block(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_ren
 	if (ob->size)
 		hoedown_buffer_putc(ob, '\n');
 
-	hoedown_buffer_put(ob, text->data + org, sz - org);
+	rndr_text(ob, text->data + org, sz - org, 0, state);
 	hoedown_buffer_putc(ob, '\n');
 }
 
@@ -722,14 +957,14 @@ rndr_raw_html(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_rend
 	/* ESCAPE overrides SKIP_HTML. It doesn't look to see if
 	 * there are any valid tags, just escapes all of them. */
 	if((state->flags & HOEDOWN_HTML_ESCAPE) != 0) {
-		escape_html(ob, text->data, text->size);
+		rndr_text(ob, text->data, text->size, 1, state);
 		return 1;
 	}
 
 	if ((state->flags & HOEDOWN_HTML_SKIP_HTML) != 0)
 		return 1;
 
-	hoedown_buffer_put(ob, text->data, text->size);
+	rndr_text(ob, text->data, text->size, 0, state);
 	return 1;
 }
 
@@ -816,11 +1051,17 @@ rndr_superscript(hoedown_buffer *ob, const hoedown_buffer *content, const hoedow
 	return 1;
 }
 
+static void
+rndr_entity(hoedown_buffer *ob, const hoedown_buffer *text, const hoedown_renderer_data *data)
+{
+	rndr_text(ob, text->data, text->size, 0, data->opaque);
+}
+
 static void
 rndr_normal_text(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_renderer_data *data)
 {
 	if (content)
-		escape_html(ob, content->data, content->size);
+		rndr_text(ob, content->data, content->size, 1, data->opaque);
 }
 
 static void
@@ -878,12 +1119,65 @@ rndr_footnote_ref(hoedown_buffer *ob, unsigned int num, const hoedown_renderer_d
 static int
 rndr_math(hoedown_buffer *ob, const hoedown_buffer *text, int displaymode, const hoedown_renderer_data *data)
 {
-	hoedown_buffer_put(ob, (const uint8_t *)(displaymode ? "\\[" : "\\("), 2);
-	escape_html(ob, text->data, text->size);
-	hoedown_buffer_put(ob, (const uint8_t *)(displaymode ? "\\]" : "\\)"), 2);
+	hoedown_html_renderer_state *state = data->opaque;
+
+	rndr_text(ob, (const uint8_t *)(displaymode ? "\\[" : "\\("), 2, 0, state);
+	rndr_text(ob, text->data, text->size, 1, state);
+	rndr_text(ob, (const uint8_t *)(displaymode ? "\\]" : "\\)"), 2, 0, state);
 	return 1;
 }
 
+static void
+rndr_smartypants_begin(hoedown_buffer *ob, int inline_render, const hoedown_renderer_data *data)
+{
+	hoedown_html_renderer_state *state = data->opaque;
+	memset(&state->smartypants.state, 0x0, sizeof(state->smartypants.state));
+	state->smartypants.start = ob->size;
+}
+
+static void
+rndr_smartypants_end(hoedown_buffer *ob, int inline_render, const hoedown_renderer_data *data)
+{
+	hoedown_html_renderer_state *state = data->opaque;
+	hoedown_buffer *text = state->smartypants.text;
+	size_t start = state->smartypants.start;
+
+	if (state->flags & HOEDOWN_HTML_SMARTYPANTS) {
+		hoedown_html_smartypants_finish(ob, &state->smartypants.state, start);
+		return;
+	}
+
+	text->size = 0;
+	hoedown_html_smartypants(text, ob->data + start, ob->size - start);
+	ob->size = start;
+	hoedown_buffer_put(ob, text->data, text->size);
+}
+
+static void
+rndr_doc_header(hoedown_buffer *ob, int inline_render, const hoedown_renderer_data *data)
+{
+	hoedown_html_renderer_state *state = data->opaque;
+
+	if (state->doc_template && !inline_render)
+		hoedown_buffer_put(ob, state->doc_template->data, state->doc_template->footer);
+
+	if (state->smartypants.text)
+		rndr_smartypants_begin(ob, inline_render, data);
+}
+
+static void
+rndr_doc_footer(hoedown_buffer *ob, int inline_render, const hoedown_renderer_data *data)
+{
+	hoedown_html_renderer_state *state = data->opaque;
+	const hoedown_html_template *tmpl = state->doc_template;
+
+	if (state->smartypants.text)
+		rndr_smartypants_end(ob, inline_render, data);
+
+	if (tmpl && !inline_render)
+		hoedown_buffer_put(ob, tmpl->data + tmpl->footer, tmpl->size - tmpl->footer);
+}
+
 static void
 toc_header(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_buffer *attr, int level, const hoedown_renderer_data *data)
 {
@@ -928,7 +1222,9 @@ toc_header(hoedown_buffer *ob, const hoedown_buffer *content, const hoedown_buff
 			}
 		} else {
 			hoedown_buffer_puts(ob, "<a href=\"#");
-			rndr_header_id(ob, content->data, content->size, 1, data);
+			/* an empty header ("#") comes without content */
+			if (content)
+				rndr_header_id(ob, content->data, content->size, 1, data);
 			hoedown_buffer_puts(ob, "\">");
 		}
 
@@ -1029,6 +1325,8 @@ hoedown_html_toc_renderer_new(int nesting_level)
 
 		NULL,
 		NULL,
+
+		0,
 	};
 
 	hoedown_html_renderer_state *state;
@@ -1044,8 +1342,6 @@ hoedown_html_toc_renderer_new(int nesting_level)
 	renderer = hoedown_malloc(sizeof(hoedown_renderer));
 	memcpy(renderer, &cb_default, sizeof(hoedown_renderer));
 
-	state->hash.header_id = hoedown_hash_new(0);
-
 	renderer->opaque = state;
 	return renderer;
 }
@@ -1092,13 +1388,15 @@ hoedown_html_renderer_new(hoedown_html_flags render_flags, int nesting_level)
 		NULL,
 		rndr_normal_text,
 
-		NULL,
-		NULL,
+		rndr_doc_header,
+		rndr_doc_footer,
 
 		NULL,
 
 		NULL,
 		NULL,
+
+		0,
 	};
 
 	hoedown_html_renderer_state *state;
@@ -1118,20 +1416,65 @@ hoedown_html_renderer_new(hoedown_html_flags render_flags, int nesting_level)
 	if (render_flags & HOEDOWN_HTML_SKIP_HTML || render_flags & HOEDOWN_HTML_ESCAPE)
 		renderer->blockhtml = NULL;
 
-	state->hash.header_id = hoedown_hash_new(0);
+	if (render_flags & HOEDOWN_HTML_SMARTYPANTS) {
+		state->smartypants.text = hoedown_buffer_new(64);
+		renderer->entity = rndr_entity;
+
+		/* Header ids are made from the text as it was before SmartyPants,
+		 * which can't be told back from its output; when they are wanted,
+		 * the document gets a single pass once it is complete instead. */
+		if ((render_flags & HOEDOWN_HTML_HEADER_ID) || nesting_level > 0) {
+			state->flags &= ~HOEDOWN_HTML_SMARTYPANTS;
+			renderer->entity = NULL;
+		}
+	}
+
+	/* Header ids are deduplicated, SmartyPants quotes pair up and the
+	 * Table of Contents nests across blocks: these can't be split up */
+	if (!(state->flags & (HOEDOWN_HTML_HEADER_ID | HOEDOWN_HTML_SMARTYPANTS)) && nesting_level <= 0)
+		renderer->flags |= HOEDOWN_RENDERER_CONCURRENT;
 
 	renderer->opaque = state;
 
 	return renderer;
 }
 
+hoedown_html_template *
+hoedown_html_template_new(
+	const uint8_t *header, size_t header_size,
+	const uint8_t *footer, size_t footer_size)
+{
+	hoedown_html_template *tmpl;
+
+	/* One allocation, the blob follows the struct */
+	tmpl = hoedown_malloc(sizeof(hoedown_html_template) + header_size + footer_size);
+	tmpl->data = (uint8_t *)(tmpl + 1);
+	tmpl->size = header_size + footer_size;
+	tmpl->footer = header_size;
+
+	if (header_size) memcpy(tmpl->data, header, header_size);
+	if (footer_size) memcpy(tmpl->data + header_size, footer, footer_size);
+
+	return tmpl;
+}
+
+void
+hoedown_html_template_free(hoedown_html_template *tmpl)
+{
+	free(tmpl);
+}
+
 void
 hoedown_html_renderer_free(hoedown_renderer *renderer)
 {
 	if (renderer->opaque) {
 		hoedown_html_renderer_state *state = renderer->opaque;
-		if (state->hash.header_id) {
-			hoedown_hash_free(state->hash.header_id);
+		free(state->header_ids.slots);
+		if (state->header_ids.keys) {
+			hoedown_buffer_free(state->header_ids.keys);
+		}
+		if (state->smartypants.text) {
+			hoedown_buffer_free(state->smartypants.text);
 		}
 	}
 	free(renderer->opaque);
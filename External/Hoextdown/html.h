@@ -24,7 +24,8 @@ typedef enum hoedown_html_flags {
 	HOEDOWN_HTML_USE_TASK_LIST = (1 << 4),
 	HOEDOWN_HTML_LINE_CONTINUE = (1 << 5),
 	HOEDOWN_HTML_HEADER_ID = (1 << 6),
-	HOEDOWN_HTML_FENCED_CODE_SCRIPT = (1 << 7)
+	HOEDOWN_HTML_FENCED_CODE_SCRIPT = (1 << 7),
+	HOEDOWN_HTML_SMARTYPANTS = (1 << 8)
 } hoedown_html_flags;
 
 typedef enum hoedown_html_tag {
@@ -38,6 +39,52 @@ typedef enum hoedown_html_tag {
  * TYPES *
  *********/
 
+/* SmartyPants state carried between the pieces of text of one document,
+ * when smart punctuation is applied while the document is rendered */
+struct hoedown_html_smartypants_state {
+	int in_squote;
+	int in_dquote;
+	int skip_tag;
+	int fragment;
+
+	/* where the previous piece started and the state it started with */
+	int piece_plain;
+	size_t piece_pos;
+	uint8_t piece_prev;
+	int piece_squote;
+	int piece_dquote;
+	int piece_skip;
+
+	/* end of the previous piece, to detect that the next one continues it */
+	const hoedown_buffer *last_ob;
+	size_t last_end;
+	uint8_t last_char;
+	uint8_t last_out[16];
+	size_t last_out_size;
+
+	/* the trailing input of the previous piece that a following piece may
+	 * complete (e.g. "-" followed by "-"), and the state before it */
+	size_t tail_pos;
+	size_t tail_size;
+	uint8_t tail[16];
+	uint8_t tail_prev;
+	int tail_squote;
+	int tail_dquote;
+	int tail_skip;
+
+	/* "&#0;" was written out and is left for the end of the document */
+	int null_kept;
+};
+typedef struct hoedown_html_smartypants_state hoedown_html_smartypants_state;
+
+/* Page wrapped around a rendered document: the header and the footer, in one blob */
+struct hoedown_html_template {
+	uint8_t *data;
+	size_t size;
+	size_t footer;
+};
+typedef struct hoedown_html_template hoedown_html_template;
+
 struct hoedown_html_renderer_state {
 	void *opaque;
 
@@ -51,11 +98,23 @@ struct hoedown_html_renderer_state {
 	} toc_data;
 
 	struct {
-		hoedown_hash *header_id;
-	} hash;
+		struct hoedown_html_header_id *slots;
+		size_t asize;
+		size_t count;
+		hoedown_buffer *keys;
+	} header_ids;
+
+	struct {
+		hoedown_html_smartypants_state state;
+		hoedown_buffer *text;
+		size_t start;
+	} smartypants;
 
 	hoedown_html_flags flags;
 
+	/* page written around the document, NULL for a fragment */
+	const hoedown_html_template *doc_template;
+
 	/* extra callbacks */
 	void (*link_attributes)(hoedown_buffer *ob, const hoedown_buffer *url, const hoedown_renderer_data *data);
 };
@@ -69,11 +128,32 @@ typedef struct hoedown_html_renderer_state hoedown_html_renderer_state;
 /* hoedown_html_smartypants: process an HTML snippet using SmartyPants for smart punctuation */
 void hoedown_html_smartypants(hoedown_buffer *ob, const uint8_t *data, size_t size);
 
+/* hoedown_html_smartypants_text: process one piece of text of a document as it is rendered,
+ * escaping it first if asked; work is scratch space that must be kept until the next piece */
+void hoedown_html_smartypants_text(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, hoedown_buffer *work, const uint8_t *data, size_t size, int escape);
+
+/* hoedown_html_smartypants_rewound: process the previous piece again after the parser took back the end of it from ob */
+void hoedown_html_smartypants_rewound(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, const hoedown_buffer *work);
+
+/* hoedown_html_smartypants_finish: complete a document processed in pieces, once ob holds all of it from start */
+void hoedown_html_smartypants_finish(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, size_t start);
+
 /* hoedown_html_is_tag: checks if data starts with a specific tag, returns the tag type or NONE */
 hoedown_html_tag hoedown_html_is_tag(const uint8_t *data, size_t size, const char *tagname);
 
 
-/* hoedown_html_renderer_new: allocates a regular HTML renderer */
+/* hoedown_html_template_new: compile the header and footer of a page into a template */
+hoedown_html_template *hoedown_html_template_new(
+	const uint8_t *header, size_t header_size,
+	const uint8_t *footer, size_t footer_size
+) __attribute__ ((malloc));
+
+/* hoedown_html_template_free: deallocate a template */
+void hoedown_html_template_free(hoedown_html_template *tmpl);
+
+
+/* hoedown_html_renderer_new: allocates a regular HTML renderer, flagged HOEDOWN_RENDERER_CONCURRENT unless
+ * it makes header ids, applies SmartyPants or collects a Table of Contents, which carry state across blocks */
 hoedown_renderer *hoedown_html_renderer_new(
 	hoedown_html_flags render_flags,
 	int nesting_level
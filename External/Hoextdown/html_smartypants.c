@@ -1,4 +1,5 @@
 #include "html.h"
+#include "escape.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -9,24 +10,23 @@
 #define snprintf _snprintf
 #endif
 
-struct smartypants_data {
-	int in_squote;
-	int in_dquote;
-};
-
-static size_t smartypants_cb__ltag(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
-static size_t smartypants_cb__dquote(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
-static size_t smartypants_cb__amp(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
-static size_t smartypants_cb__period(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
-static size_t smartypants_cb__number(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
-static size_t smartypants_cb__dash(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
-static size_t smartypants_cb__parens(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
-static size_t smartypants_cb__squote(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
-static size_t smartypants_cb__backtick(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
-static size_t smartypants_cb__escape(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
+/* largest input a single callback looks at, rounded up; see the tail in
+ * hoedown_html_smartypants_state */
+#define SMARTYPANTS_TAIL 16
+
+static size_t smartypants_cb__ltag(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
+static size_t smartypants_cb__dquote(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
+static size_t smartypants_cb__amp(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
+static size_t smartypants_cb__period(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
+static size_t smartypants_cb__number(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
+static size_t smartypants_cb__dash(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
+static size_t smartypants_cb__parens(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
+static size_t smartypants_cb__squote(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
+static size_t smartypants_cb__backtick(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
+static size_t smartypants_cb__escape(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
 
 static size_t (*smartypants_cb_ptrs[])
-	(hoedown_buffer *, struct smartypants_data *, uint8_t, const uint8_t *, size_t) =
+	(hoedown_buffer *, hoedown_html_smartypants_state *, uint8_t, const uint8_t *, size_t) =
 {
 	NULL,					/* 0 */
 	smartypants_cb__dash,	/* 1 */
@@ -112,7 +112,7 @@ smartypants_quotes(hoedown_buffer *ob, uint8_t previous_char, uint8_t next_char,
 	'text' points at the last character of the single-quote, e.g. ' or ;
 */
 static size_t
-smartypants_squote(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size,
+smartypants_squote(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size,
 				   const uint8_t *squote_text, size_t squote_size)
 {
 	if (size >= 2) {
@@ -128,7 +128,7 @@ smartypants_squote(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t pr
 
 		/* Tom's, isn't, I'm, I'd */
 		if ((t1 == 's' || t1 == 't' || t1 == 'm' || t1 == 'd') &&
-			(size == 3 || word_boundary(text[2]))) {
+			(size == 2 || word_boundary(text[2]))) {
 			HOEDOWN_BUFPUTSL(ob, "&rsquo;");
 			return 0;
 		}
@@ -140,14 +140,14 @@ smartypants_squote(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t pr
 			if (((t1 == 'r' && t2 == 'e') ||
 				(t1 == 'l' && t2 == 'l') ||
 				(t1 == 'v' && t2 == 'e')) &&
-				(size == 4 || word_boundary(text[3]))) {
+				(size == 3 || word_boundary(text[3]))) {
 				HOEDOWN_BUFPUTSL(ob, "&rsquo;");
 				return 0;
 			}
 		}
 	}
 
-	if (smartypants_quotes(ob, previous_char, size > 0 ? text[1] : 0, 's', &smrt->in_squote))
+	if (smartypants_quotes(ob, previous_char, size > 1 ? text[1] : 0, 's', &smrt->in_squote))
 		return 0;
 
 	hoedown_buffer_put(ob, squote_text, squote_size);
@@ -156,14 +156,14 @@ smartypants_squote(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t pr
 
 /* Converts ' to left or right single quote. */
 static size_t
-smartypants_cb__squote(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
+smartypants_cb__squote(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
 {
 	return smartypants_squote(ob, smrt, previous_char, text, size, text, 1);
 }
 
 /* Converts (c), (r), (tm) */
 static size_t
-smartypants_cb__parens(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
+smartypants_cb__parens(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
 {
 	if (size >= 3) {
 		uint8_t t1 = tolower(text[1]);
@@ -191,7 +191,7 @@ smartypants_cb__parens(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_
 
 /* Converts "--" to em-dash, etc. */
 static size_t
-smartypants_cb__dash(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
+smartypants_cb__dash(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
 {
 	if (size >= 3 && text[1] == '-' && text[2] == '-') {
 		HOEDOWN_BUFPUTSL(ob, "&mdash;");
@@ -209,7 +209,7 @@ smartypants_cb__dash(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t
 
 /* Converts &quot; etc. */
 static size_t
-smartypants_cb__amp(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
+smartypants_cb__amp(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
 {
 	size_t len;
 	if (size >= 6 && memcmp(text, "&quot;", 6) == 0) {
@@ -222,8 +222,15 @@ smartypants_cb__amp(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t p
 		return (len-1) + smartypants_squote(ob, smrt, previous_char, text+(len-1), size-(len-1), text, len);
 	}
 
-	if (size >= 4 && memcmp(text, "&#0;", 4) == 0)
+	if (size >= 4 && memcmp(text, "&#0;", 4) == 0) {
+		/* while rendering, blocks still trim and drop text around it as
+		 * if it were there; hoedown_html_smartypants_finish takes it out */
+		if (smrt->fragment) {
+			HOEDOWN_BUFPUTSL(ob, "&#0;");
+			smrt->null_kept = 1;
+		}
 		return 3;
+	}
 
 	hoedown_buffer_putc(ob, '&');
 	return 0;
@@ -231,7 +238,7 @@ smartypants_cb__amp(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t p
 
 /* Converts "..." to ellipsis */
 static size_t
-smartypants_cb__period(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
+smartypants_cb__period(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
 {
 	if (size >= 3 && text[1] == '.' && text[2] == '.') {
 		HOEDOWN_BUFPUTSL(ob, "&hellip;");
@@ -249,7 +256,7 @@ smartypants_cb__period(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_
 
 /* Converts `` to opening double quote */
 static size_t
-smartypants_cb__backtick(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
+smartypants_cb__backtick(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
 {
 	if (size >= 2 && text[1] == '`') {
 		if (smartypants_quotes(ob, previous_char, size >= 3 ? text[2] : 0, 'd', &smrt->in_dquote))
@@ -262,7 +269,7 @@ smartypants_cb__backtick(hoedown_buffer *ob, struct smartypants_data *smrt, uint
 
 /* Converts 1/2, 1/4, 3/4 */
 static size_t
-smartypants_cb__number(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
+smartypants_cb__number(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
 {
 	if (word_boundary(previous_char) && size >= 3) {
 		if (text[0] == '1' && text[1] == '/' && text[2] == '2') {
@@ -295,22 +302,45 @@ smartypants_cb__number(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_
 
 /* Converts " to left or right double quote */
 static size_t
-smartypants_cb__dquote(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
+smartypants_cb__dquote(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
 {
-	if (!smartypants_quotes(ob, previous_char, size > 0 ? text[1] : 0, 'd', &smrt->in_dquote))
+	if (!smartypants_quotes(ob, previous_char, size > 1 ? text[1] : 0, 'd', &smrt->in_dquote))
 		HOEDOWN_BUFPUTSL(ob, "&quot;");
 
 	return 0;
 }
 
+static const char *skip_tags[] = {
+  "pre", "code", "var", "samp", "kbd", "math", "script", "style"
+};
+static const size_t skip_tags_count = 8;
+
+/* Returns the offset of the '>' closing the skip tag, or size if it isn't closed in text. */
 static size_t
-smartypants_cb__ltag(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
+smartypants_skip_end(const uint8_t *text, size_t size, size_t i, const char *tagname)
 {
-	static const char *skip_tags[] = {
-	  "pre", "code", "var", "samp", "kbd", "math", "script", "style"
-	};
-	static const size_t skip_tags_count = 8;
+	for (;;) {
+		while (i < size && text[i] != '<')
+			i++;
+
+		if (i == size)
+			return size;
+
+		if (hoedown_html_is_tag(text + i, size - i, tagname) == HOEDOWN_HTML_TAG_CLOSE)
+			break;
+
+		i++;
+	}
+
+	while (i < size && text[i] != '>')
+		i++;
+
+	return i;
+}
 
+static size_t
+smartypants_cb__ltag(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
+{
 	size_t tag, i = 0;
 
 	/* This is a comment. Copy everything verbatim until --> or EOF is seen. */
@@ -318,8 +348,8 @@ smartypants_cb__ltag(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t
 		i += 4;
 		while (i + 3 < size && memcmp(text + i, "-->",  3) != 0)
 			i++;
-		i += 3;
-		hoedown_buffer_put(ob, text, i + 1);
+		i += 2;
+		hoedown_buffer_put(ob, text, i + 1 < size ? i + 1 : size);
 		return i;
 	}
 
@@ -332,32 +362,26 @@ smartypants_cb__ltag(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t
 	}
 
 	if (tag < skip_tags_count) {
-		for (;;) {
-			while (i < size && text[i] != '<')
-				i++;
-
-			if (i == size)
-				break;
-
-			if (hoedown_html_is_tag(text + i, size - i, skip_tags[tag]) == HOEDOWN_HTML_TAG_CLOSE)
-				break;
+		i = smartypants_skip_end(text, size, i, skip_tags[tag]);
 
-			i++;
-		}
-
-		while (i < size && text[i] != '>')
-			i++;
+		/* the closing tag may come in a later piece */
+		if (i == size && smrt->fragment)
+			smrt->skip_tag = (int)tag + 1;
 	}
 
-	hoedown_buffer_put(ob, text, i + 1);
+	hoedown_buffer_put(ob, text, i < size ? i + 1 : size);
 	return i;
 }
 
 static size_t
-smartypants_cb__escape(hoedown_buffer *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
+smartypants_cb__escape(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
 {
-	if (size < 2)
+	if (size < 2) {
+		/* at the end of a piece, the next character is rendered markup */
+		if (smrt->fragment)
+			hoedown_buffer_putc(ob, '\\');
 		return 0;
+	}
 
 	switch (text[1]) {
 	case '\\':
@@ -405,31 +429,237 @@ static struct {
 };
 #endif
 
+static void
+smartypants_run(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
+{
+	size_t i = 0, tail = size;
+
+	/* finish a skip tag left open by the previous piece */
+	if (smrt->skip_tag) {
+		i = smartypants_skip_end(text, size, 0, skip_tags[smrt->skip_tag - 1]);
+		if (i < size) {
+			smrt->skip_tag = 0;
+			i++;
+		}
+		hoedown_buffer_put(ob, text, i);
+	}
+
+	while (i < size) {
+		size_t org;
+		uint8_t action = 0;
+
+		org = i;
+		while (i < size && (action = smartypants_cb_chars[text[i]]) == 0)
+			i++;
+
+		if (i > org)
+			hoedown_buffer_put(ob, text + org, i - org);
+
+		if (i < size) {
+			/* the callbacks that start this close to the end may need input
+			 * from the next piece, so remember where they began */
+			if (smrt->fragment && tail == size && size - i <= SMARTYPANTS_TAIL) {
+				tail = i;
+				smrt->tail_pos = ob->size;
+				smrt->tail_prev = i ? text[i - 1] : previous_char;
+				smrt->tail_squote = smrt->in_squote;
+				smrt->tail_dquote = smrt->in_dquote;
+				smrt->tail_skip = smrt->skip_tag;
+			}
+
+			i += smartypants_cb_ptrs[(int)action]
+				(ob, smrt, i ? text[i - 1] : previous_char, text + i, size - i);
+		}
+
+		i++;
+	}
+
+	if (smrt->fragment) {
+		smrt->tail_size = size - tail;
+		memcpy(smrt->tail, text + tail, smrt->tail_size);
+	}
+}
+
 void
 hoedown_html_smartypants(hoedown_buffer *ob, const uint8_t *text, size_t size)
 {
-	size_t i;
-	struct smartypants_data smrt = {0, 0};
+	hoedown_html_smartypants_state smrt;
 
 	if (!text)
 		return;
 
+	memset(&smrt, 0x0, sizeof(smrt));
 	hoedown_buffer_grow(ob, size);
+	smartypants_run(ob, &smrt, 0, text, size);
+}
+
+/* Whether raw text comes out of escaping and SmartyPants unchanged: '&' and
+ * '<' only turn up in the entities escaping writes, which it leaves alone. */
+static int
+smartypants_is_inert(const uint8_t *text, size_t size)
+{
+	size_t i;
 
 	for (i = 0; i < size; ++i) {
-		size_t org;
-		uint8_t action = 0;
+		uint8_t action = smartypants_cb_chars[text[i]];
+
+		if (action != 0 && action != 5 && action != 8) /* amp, ltag */
+			return 0;
+	}
+
+	return 1;
+}
+
+/* Prepares the next piece: when it continues the previous one, rewinds ob and
+ * puts the pending tail in text. Returns the character before the piece. */
+static uint8_t
+smartypants_resume(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, hoedown_buffer *text)
+{
+	size_t n = smrt->last_out_size;
+
+	if (smrt->last_ob != ob || ob->size != smrt->last_end ||
+		(n && memcmp(ob->data + ob->size - n, smrt->last_out, n) != 0))
+		return ob->size ? ob->data[ob->size - 1] : 0;
+
+	if (!smrt->tail_size)
+		return smrt->last_char;
 
+	/* re-run the tail of the previous piece in front of this one */
+	ob->size = smrt->tail_pos;
+	smrt->in_squote = smrt->tail_squote;
+	smrt->in_dquote = smrt->tail_dquote;
+	smrt->skip_tag = smrt->tail_skip;
+	hoedown_buffer_put(text, smrt->tail, smrt->tail_size);
+
+	return smrt->tail_prev;
+}
+
+/* Remembers where a piece ended, so that the next one can tell it follows. */
+static void
+smartypants_piece_end(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t last_char)
+{
+	smrt->last_ob = ob;
+	smrt->last_end = ob->size;
+	smrt->last_char = last_char;
+	smrt->last_out_size = ob->size < sizeof(smrt->last_out) ? ob->size : sizeof(smrt->last_out);
+	if (smrt->last_out_size)
+		memcpy(smrt->last_out, ob->data + ob->size - smrt->last_out_size, smrt->last_out_size);
+}
+
+static void
+smartypants_piece(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
+{
+	smrt->fragment = 1;
+	smrt->piece_plain = 0;
+	smrt->piece_pos = ob->size;
+	smrt->piece_prev = previous_char;
+	smrt->piece_squote = smrt->in_squote;
+	smrt->piece_dquote = smrt->in_dquote;
+	smrt->piece_skip = smrt->skip_tag;
+	smartypants_run(ob, smrt, previous_char, text, size);
+
+	smartypants_piece_end(ob, smrt, size ? text[size - 1] : previous_char);
+}
+
+void
+hoedown_html_smartypants_text(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, hoedown_buffer *work, const uint8_t *data, size_t size, int escape)
+{
+	uint8_t previous_char;
+
+	work->size = 0;
+	previous_char = smartypants_resume(ob, smrt, work);
+
+	/* text that can't change is escaped straight into ob */
+	if (escape && !work->size && smartypants_is_inert(data, size)) {
+		smrt->piece_plain = 1;
+		smrt->tail_size = 0;
+		hoedown_escape_html(ob, data, size, 0);
+		smartypants_piece_end(ob, smrt, size ? ob->data[ob->size - 1] : previous_char);
+		return;
+	}
+
+	if (escape)
+		hoedown_escape_html(work, data, size, 0);
+	else
+		hoedown_buffer_put(work, data, size);
+
+	smartypants_piece(ob, smrt, previous_char, work->data, work->size);
+}
+
+void
+hoedown_html_smartypants_rewound(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, const hoedown_buffer *work)
+{
+	size_t dropped;
+
+	if (smrt->piece_plain || smrt->last_ob != ob ||
+		ob->size >= smrt->last_end || ob->size < smrt->piece_pos)
+		return;
+
+	/* the parser drops input bytes, which in this range are written as they are */
+	dropped = smrt->last_end - ob->size;
+	if (dropped > work->size)
+		return;
+
+	ob->size = smrt->piece_pos;
+	smrt->in_squote = smrt->piece_squote;
+	smrt->in_dquote = smrt->piece_dquote;
+	smrt->skip_tag = smrt->piece_skip;
+	smartypants_piece(ob, smrt, smrt->piece_prev, work->data, work->size - dropped);
+}
+
+/* Takes the "&#0;" kept while rendering out of ob since start, outside of
+ * the tags and skipped elements the single pass would leave alone. */
+static void
+smartypants_drop_null(hoedown_buffer *ob, size_t start)
+{
+	hoedown_html_smartypants_state smrt;
+	hoedown_buffer *text;
+	size_t i, org;
+
+	memset(&smrt, 0x0, sizeof(smrt));
+	text = hoedown_buffer_new(64);
+	hoedown_buffer_put(text, ob->data + start, ob->size - start);
+	ob->size = start;
+
+	for (i = 0; i < text->size; ++i) {
 		org = i;
-		while (i < size && (action = smartypants_cb_chars[text[i]]) == 0)
+		while (i < text->size && text->data[i] != '<' && text->data[i] != '&')
 			i++;
 
 		if (i > org)
-			hoedown_buffer_put(ob, text + org, i - org);
+			hoedown_buffer_put(ob, text->data + org, i - org);
 
-		if (i < size) {
-			i += smartypants_cb_ptrs[(int)action]
-				(ob, &smrt, i ? text[i - 1] : 0, text + i, size - i);
+		if (i == text->size)
+			break;
+
+		if (text->data[i] == '<')
+			i += smartypants_cb__ltag(ob, &smrt, 0, text->data + i, text->size - i);
+		else if (text->size - i >= 4 && memcmp(text->data + i, "&#0;", 4) == 0)
+			i += 3;
+		else
+			hoedown_buffer_putc(ob, '&');
+	}
+
+	hoedown_buffer_free(text);
+}
+
+void
+hoedown_html_smartypants_finish(hoedown_buffer *ob, hoedown_html_smartypants_state *smrt, size_t start)
+{
+	hoedown_buffer *text;
+	uint8_t previous_char;
+
+	/* the tail of the last piece ends the document */
+	if (smrt->tail_size) {
+		text = hoedown_buffer_new(sizeof(smrt->tail));
+		previous_char = smartypants_resume(ob, smrt, text);
+		if (text->size) {
+			smrt->fragment = 0;
+			smartypants_run(ob, smrt, previous_char, text->data, text->size);
 		}
+		hoedown_buffer_free(text);
 	}
+
+	if (smrt->null_kept)
+		smartypants_drop_null(ob, start);
 }
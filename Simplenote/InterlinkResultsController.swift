@@ -9,6 +9,14 @@ class InterlinkResultsController {
     ///
     private let resultsController: ResultsController<Note>
 
+    /// Context the Notes live in
+    ///
+    private let viewContext: NSManagedObjectContext
+
+    /// Titles of the fetched Notes, kept up to date as they change
+    ///
+    private let titleIndex = SPTitleIndex<NSManagedObjectID>()
+
     /// Limits the maximum number of results to fetch
     ///
     var maximumNumberOfResults = Settings.maximumNumberOfResults
@@ -16,19 +24,32 @@ class InterlinkResultsController {
     /// Designated Initializer
     ///
     init(viewContext: NSManagedObjectContext) {
+        self.viewContext = viewContext
         resultsController = ResultsController<Note>(viewContext: viewContext, sortedBy: [
             NSSortDescriptor(keyPath: \Note.content, ascending: true)
         ])
 
         resultsController.predicate = NSPredicate.predicateForNotes(deleted: false)
         try? resultsController.performFetch()
+
+        indexTitles(of: resultsController.fetchedObjects)
+        startListeningToContextChanges(in: viewContext)
+    }
+
+    deinit {
+        NotificationCenter.default.removeObserver(self)
     }
 
     /// Returns the collection of Notes filtered by the specified Keyword in their title, excluding a specific ObjectID
     /// - Important: Returns `nil` when there are no results!
     ///
     func searchNotes(byTitleKeyword keyword: String, excluding excludedID: NSManagedObjectID?) -> [Note]? {
-        filter(notes: resultsController.fetchedObjects, byTitleKeyword: keyword, excluding: excludedID)
+        let objectIDs = titleIndex.keysForTitles(containing: keyword, excluding: excludedID, limit: UInt(maximumNumberOfResults))
+        let notes = objectIDs.compactMap { objectID in
+            viewContext.object(with: objectID) as? Note
+        }
+
+        return notes.isEmpty ? nil : notes
     }
 }
 
@@ -36,34 +57,56 @@ class InterlinkResultsController {
 //
 private extension InterlinkResultsController {
 
-    /// Filters a collection of notes by their Title contents, excluding a specific Object ID.
+    /// Indexes the titles of a collection of notes, and drops the ones that have been deleted.
     ///
-    /// - Important: Why do we perform an *in memory* filtering?
+    /// - Important: Why do we keep an *in memory* index?
     ///     - CoreData's SQLite store does not support block based predicates
     ///     - RegExes aren't diacritic + case insensitve friendly
-    ///     - It's easier and anyone can follow along!
+    ///     - Folding every title on each keystroke grows with the account, while looking them up doesn't
     ///
-    func filter(notes: [Note], byTitleKeyword keyword: String, excluding excludedID: NSManagedObjectID?) -> [Note]? {
-        var output = [Note]()
-        let normalizedKeyword = keyword.folding(options: [.diacriticInsensitive, .caseInsensitive], locale: nil)
+    func indexTitles<S: Sequence>(of notes: S) where S.Element == Note {
+        for note in notes {
+            guard !note.deleted, !note.isDeleted else {
+                titleIndex.removeTitle(for: note.objectID)
+                continue
+            }
 
-        for note in notes where note.objectID != excludedID {
             note.ensurePreviewStringsAreAvailable()
+            titleIndex.setTitle(note.titlePreview ?? "", for: note.objectID)
+        }
+    }
 
-            guard let normalizedTitle = note.titlePreview?.folding(options: [.diacriticInsensitive, .caseInsensitive], locale: nil),
-                  normalizedTitle.contains(normalizedKeyword)
-            else {
-                continue
-            }
+    func startListeningToContextChanges(in viewContext: NSManagedObjectContext) {
+        NotificationCenter.default.addObserver(self,
+                                               selector: #selector(contextObjectsDidChange),
+                                               name: .NSManagedObjectContextObjectsDidChange,
+                                               object: viewContext)
+    }
 
-            output.append(note)
+    /// Titles follow the contents of the notes, which may have changed without their previews being refreshed
+    ///
+    @objc
+    func contextObjectsDidChange(_ notification: Notification) {
+        guard let userInfo = notification.userInfo else {
+            return
+        }
 
-            if output.count >= maximumNumberOfResults {
-                break
-            }
+        if userInfo[NSInvalidatedAllObjectsKey] != nil {
+            titleIndex.removeAllTitles()
+            try? resultsController.performFetch()
+            indexTitles(of: resultsController.fetchedObjects)
+            return
         }
 
-        return output.isEmpty ? nil : output
+        for key in [NSInsertedObjectsKey, NSUpdatedObjectsKey, NSRefreshedObjectsKey] {
+            let notes = (userInfo[key] as? Set<NSManagedObject>)?.compactMap { $0 as? Note } ?? []
+            notes.forEach { $0.createPreview() }
+            indexTitles(of: notes)
+        }
+
+        for object in (userInfo[NSDeletedObjectsKey] as? Set<NSManagedObject>) ?? [] where object is Note {
+            titleIndex.removeTitle(for: object.objectID)
+        }
     }
 }
 
@@ -102,11 +102,11 @@ private extension MetricsViewController {
     }
 
     func setupResultsControllerIfNeeded() {
-        guard mustSetupResultsController, let plainInterlink = notes.first?.plainInterlink else {
+        guard mustSetupResultsController, let simperiumKey = notes.first?.simperiumKey else {
             return
         }
 
-        resultsController.predicate = NSPredicate.predicateForNotes(exactMatch: plainInterlink)
+        resultsController.predicate = SPBacklinkIndex.shared.predicateForNotes(linkingTo: simperiumKey)
         resultsController.onDidChangeContent = { [weak self] _, _ in
             self?.refreshInterface()
         }
@@ -14,10 +14,10 @@ extension NSSortDescriptor {
         switch sortMode {
         case .alphabeticallyAscending:
             sortKeySelector = #selector(getter: Note.content)
-            sortSelector    = #selector(NSString.caseInsensitiveCompare)
+            sortSelector    = #selector(NSString.noteContentCompare)
         case .alphabeticallyDescending:
             sortKeySelector = #selector(getter: Note.content)
-            sortSelector    = #selector(NSString.caseInsensitiveCompare)
+            sortSelector    = #selector(NSString.noteContentCompare)
             ascending       = false
         case .createdNewest:
             sortKeySelector = #selector(getter: Note.creationDate)
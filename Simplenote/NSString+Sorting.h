@@ -0,0 +1,19 @@
+//
+//  NSString+Sorting.h
+//  Simplenote
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface NSString (Sorting)
+
+/// Orders Note contents just like `caseInsensitiveCompare:` does, for a fraction of the cost: a folded key is packed
+/// from the leading characters of both strings, and the full comparison only runs when the keys can't tell them apart.
+///
+- (NSComparisonResult)noteContentCompare:(NSString *)string;
+
+@end
+
+NS_ASSUME_NONNULL_END
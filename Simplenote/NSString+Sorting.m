@@ -0,0 +1,109 @@
+//
+//  NSString+Sorting.m
+//  Simplenote
+//
+
+#import "NSString+Sorting.h"
+
+
+
+#pragma mark ================================================================================
+#pragma mark Constants
+#pragma mark ================================================================================
+
+static const CFIndex SPSortKeyMaximumLength = 8;
+
+
+
+#pragma mark ================================================================================
+#pragma mark Sort Keys
+#pragma mark ================================================================================
+
+// Leading characters of a string, folded and packed one per byte, so that comparing keys compares the strings
+typedef struct {
+    uint64_t bits;
+    CFIndex length;             // Characters packed
+    BOOL complete;              // The whole string was packed
+} SPSortKey;
+
+// Characters which order the same way, whatever the case of the letters around them.
+// Non-ASCII characters may be composed or followed by combining marks, and `[\]^_` sit between uppercase and
+// lowercase letters: those are left to the full comparison.
+static inline BOOL SPSortKeyIsPackable(UniChar character)
+{
+    return character > 0 && character < 0x80 && (character < '[' || character > '`');
+}
+
+static void SPSortKeyMake(CFStringRef string, SPSortKey *key)
+{
+    CFIndex stringLength = CFStringGetLength(string);
+    CFIndex length = MIN(stringLength, SPSortKeyMaximumLength);
+
+    UniChar characters[SPSortKeyMaximumLength];
+    CFStringGetCharacters(string, CFRangeMake(0, length), characters);
+
+    key->bits = 0;
+    key->length = 0;
+
+    for (CFIndex i = 0; i < length; i++) {
+        UniChar character = characters[i];
+        if (!SPSortKeyIsPackable(character)) {
+            break;
+        }
+
+        if (character >= 'A' && character <= 'Z') {
+            character += 'a' - 'A';
+        }
+
+        key->bits |= (uint64_t)character << (56 - 8 * i);
+        key->length++;
+    }
+
+    key->complete = key->length == stringLength;
+}
+
+// Returns NO when the keys can't tell the strings apart
+static BOOL SPSortKeyCompare(const SPSortKey *lhs, const SPSortKey *rhs, NSComparisonResult *result)
+{
+    if (lhs->bits == rhs->bits) {
+        *result = NSOrderedSame;
+        return lhs->complete && rhs->complete;
+    }
+
+    // Packed characters are never zero: past the first difference, a key either holds a character, or has ended
+    CFIndex position = __builtin_clzll(lhs->bits ^ rhs->bits) / 8;
+    BOOL lhsEnded = position == lhs->length;
+    BOOL rhsEnded = position == rhs->length;
+
+    if ((lhsEnded && !lhs->complete) || (rhsEnded && !rhs->complete)) {
+        return NO;
+    }
+
+    *result = lhs->bits < rhs->bits ? NSOrderedAscending : NSOrderedDescending;
+    return YES;
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark NSString (Sorting)
+#pragma mark ================================================================================
+
+@implementation NSString (Sorting)
+
+- (NSComparisonResult)noteContentCompare:(NSString *)string
+{
+    SPSortKey lhs;
+    SPSortKey rhs;
+    SPSortKeyMake((__bridge CFStringRef)self, &lhs);
+    SPSortKeyMake((__bridge CFStringRef)string, &rhs);
+
+    NSComparisonResult result;
+    if (SPSortKeyCompare(&lhs, &rhs, &result)) {
+        return result;
+    }
+
+    return [self caseInsensitiveCompare:string];
+}
+
+@end
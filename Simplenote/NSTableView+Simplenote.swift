@@ -27,6 +27,38 @@ extension NSTableView {
         reloadData(forRowIndexes: selectedRowIndexes, columnIndexes: allColumns)
     }
 
+    /// Reloads the rows on screen in (all) of the available columns
+    ///
+    func reloadVisibleRows() {
+        let visibleRows = rows(in: visibleRect)
+        guard visibleRows.length > .zero else {
+            return
+        }
+
+        let rowIndexes = IndexSet(integersIn: visibleRows.location ..< NSMaxRange(visibleRows))
+        let allColumns = IndexSet(integersIn: .zero ..< numberOfColumns)
+        reloadData(forRowIndexes: rowIndexes, columnIndexes: allColumns)
+    }
+
+    /// Applies the changes of a given List Diff: rows are removed first, then inserted and moved one at a time, since
+    /// the TableView reads every index against the rows left by the previous change
+    ///
+    func performBatchChanges<T>(listDiff: SPListDiff<T>) {
+        beginUpdates()
+        removeRows(at: listDiff.deletedIndexes, withAnimation: .effectFade)
+
+        listDiff.enumerateSteps { fromIndex, toIndex in
+            guard fromIndex != NSNotFound else {
+                insertRows(at: IndexSet(integer: toIndex), withAnimation: .effectFade)
+                return
+            }
+
+            moveRow(at: fromIndex, to: toIndex)
+        }
+
+        endUpdates()
+    }
+
     /// Reloads the receiver's data and preserves the selected row
     /// - Note:If the previously selected row is no more, we'll fallback to selecting the last row
     ///
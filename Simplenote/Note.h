@@ -22,7 +22,6 @@
 	NSString *tags;
 	NSString *systemTags;
     NSMutableArray *tagsArray;
-    NSMutableArray *systemTagsArray;
 	NSString *remoteId;
 	BOOL deleted;
 	BOOL shared;
@@ -74,7 +73,6 @@
 
 - (NSString *)localID;
 - (void)updateTagsArray;
-- (void)updateSystemTagsArray;
 - (BOOL)hasTag:(NSString *)tag;
 - (void)addTag:(NSString *)tag;
 - (void)addSystemTag:(NSString *)tag;
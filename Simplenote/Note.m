@@ -7,7 +7,9 @@
 
 #import "Note.h"
 #import "NSString+Metadata.h"
+#import "NSString+Sorting.h"
 #import "JSONKit+Simplenote.h"
+#import "SPJSONStringArray.h"
 #import "SimplenoteAppDelegate.h"
 #import "Simplenote-Swift.h"
 
@@ -40,7 +42,6 @@
     [super awakeFromFetch];
     [self createPreview];
     [self updateTagsArray];
-    [self updateSystemTagsArray];
     [self updateSystemTagFlags];
 }
 
@@ -55,7 +56,6 @@
     self.modificationDate = [NSDate date];
     self.tags = @"[]";
     self.systemTags = @"[]";
-    [self updateSystemTagsArray];
     [self updateTagsArray];
 }
 
@@ -137,7 +137,7 @@
         return NSOrderedDescending;
     }
 
-	return [self.content caseInsensitiveCompare:note.content];
+	return [self.content noteContentCompare:note.content];
 }
 
 - (NSComparisonResult)compareAlphaReverse:(Note *)note
@@ -148,7 +148,7 @@
         return NSOrderedDescending;
     }
     
-	return [note.content caseInsensitiveCompare:self.content];
+	return [note.content noteContentCompare:self.content];
 }
 
 - (void)ensurePreviewStringsAreAvailable
@@ -259,7 +259,6 @@
     [self willChangeValueForKey:@"systemTags"];
     NSString *newString = [newTags copy];
     [self setPrimitiveValue:newString forKey:@"systemTags"]; 
-    [self updateSystemTagsArray];
 	[self updateSystemTagFlags];
     [self didChangeValueForKey:@"systemTags"];    
 }
@@ -345,12 +344,17 @@
 
 - (void)setTagsFromList:(NSArray *)tagList
 {
-    [self setTags: [tagList JSONString]];
+    [self setTags: [SPJSONStringArray JSONStringFromArray:tagList] ?: [tagList JSONString]];
 }
 
 - (void)updateTagsArray
 {
-    tagsArray = tags.length > 0 ? [[tags objectFromJSONString] mutableCopy] : [NSMutableArray arrayWithCapacity:2];
+    if (tags.length == 0) {
+        tagsArray = [NSMutableArray arrayWithCapacity:2];
+        return;
+    }
+
+    tagsArray = [SPJSONStringArray arrayFromJSONString:tags] ?: [[tags objectFromJSONString] mutableCopy];
 }
 
 - (BOOL)hasTag:(NSString *)tag {
@@ -368,25 +372,40 @@
 
 - (void)addTag:(NSString *)tag
 {
-	if (![self hasTag: tag]) {
-        NSString *newTag = [tag copy];
-        [tagsArray addObject:newTag];
-        self.tags = [tagsArray JSONString];
+    if ([self hasTag: tag]) {
+        return;
+    }
+
+    NSString *newTags = [SPJSONStringArray JSONString:(tags.length > 0 ? tags : @"[]") byAppendingString:tag];
+    if (!newTags) {
+        [tagsArray addObject:[tag copy]];
+        newTags = [tagsArray JSONString];
     }
+
+    self.tags = newTags;
 }
 
-- (void)updateSystemTagsArray
+// System Tags are looked up and edited right within their JSON, which is only parsed when the codec turns it down
+- (NSMutableArray *)parsedSystemTags
 {
-    systemTagsArray = systemTags.length > 0 ? [[systemTags objectFromJSONString] mutableCopy] : [NSMutableArray arrayWithCapacity:2];
+    id parsedSystemTags = [systemTags objectFromJSONString];
+    return [parsedSystemTags isKindOfClass:[NSArray class]] ? [parsedSystemTags mutableCopy] : [NSMutableArray array];
 }
 
 - (void)addSystemTag:(NSString *)tag
 {
-	if (![self hasSystemTag: tag]) {
-        NSString *newTag = [tag copy];
-        [systemTagsArray addObject:newTag];
-        self.systemTags = [systemTagsArray JSONString];
+    if ([self hasSystemTag: tag]) {
+        return;
+    }
+
+    NSString *newSystemTags = [SPJSONStringArray JSONString:(systemTags.length > 0 ? systemTags : @"[]") byAppendingString:tag];
+    if (!newSystemTags) {
+        NSMutableArray *systemTagsArray = [self parsedSystemTags];
+        [systemTagsArray addObject:[tag copy]];
+        newSystemTags = [systemTagsArray JSONString];
     }
+
+    self.systemTags = newSystemTags;
 }
 
 - (BOOL)hasSystemTag:(NSString *)tag
@@ -394,12 +413,22 @@
     if (systemTags == nil || systemTags.length == 0) {
         return NO;
     }
-    
-    for (NSString *tagCheck in systemTagsArray) {
-        if ([tagCheck compare:tag] == NSOrderedSame) {
+
+    BOOL malformed = NO;
+    if ([SPJSONStringArray JSONString:systemTags containsString:tag malformed:&malformed]) {
+        return YES;
+    }
+
+    if (!malformed) {
+        return NO;
+    }
+
+    for (NSString *tagCheck in [self parsedSystemTags]) {
+        if ([tagCheck isKindOfClass:[NSString class]] && [tagCheck compare:tag] == NSOrderedSame) {
             return YES;
         }
     }
+
     return NO;
 }
 
@@ -408,16 +437,19 @@
     if (tags.length == 0) {
         return;
     }
-    
-    NSMutableArray *tagsArrayCopy = [tagsArray copy];
-    for (NSString *tagCheck in tagsArrayCopy) {
-        if ([tagCheck compare:tag] == NSOrderedSame) {
-            [tagsArray removeObject:tagCheck];
-            continue;
+
+    NSString *newTags = [SPJSONStringArray JSONString:tags byRemovingString:tag];
+    if (!newTags) {
+        NSMutableArray *tagsArrayCopy = [tagsArray copy];
+        for (NSString *tagCheck in tagsArrayCopy) {
+            if ([tagCheck compare:tag] == NSOrderedSame) {
+                [tagsArray removeObject:tagCheck];
+            }
         }
+        newTags = [tagsArray JSONString];
     }
 
-	self.tags = [tagsArray JSONString];
+    self.tags = newTags;
 }
 
 - (void)stripSystemTag:(NSString *)tag
@@ -425,16 +457,19 @@
     if (systemTags.length == 0) {
         return;
     }
-    
-    NSMutableArray *systemTagsArrayCopy = [systemTagsArray copy];
-    for (NSString *tagCheck in systemTagsArrayCopy) {
-        if ([tagCheck compare:tag] == NSOrderedSame) {
-            [systemTagsArray removeObject:tagCheck];
-            continue;
+
+    NSString *newSystemTags = [SPJSONStringArray JSONString:systemTags byRemovingString:tag];
+    if (!newSystemTags) {
+        NSMutableArray *systemTagsArray = [self parsedSystemTags];
+        for (NSString *tagCheck in [systemTagsArray copy]) {
+            if ([tagCheck isKindOfClass:[NSString class]] && [tagCheck compare:tag] == NSOrderedSame) {
+                [systemTagsArray removeObject:tagCheck];
+            }
         }
+        newSystemTags = [systemTagsArray JSONString];
     }
-    
-	self.systemTags = [systemTagsArray JSONString];
+
+    self.systemTags = newSystemTags;
 }
 
 @end
@@ -11,9 +11,14 @@ class NoteListController: NSObject {
     ///
     private let viewContext: NSManagedObjectContext
     private lazy var notesController = ResultsController<Note>(viewContext: viewContext,
-                                                               matching: filter.predicateForNotes(),
+                                                               matching: filter.predicateForNotes(searchIndex: searchIndex, tagIndex: tagIndex),
                                                                sortedBy: filter.descriptorsForNotes(sortMode: sortMode))
 
+    /// Indexes narrowing Searches and Tags down
+    ///
+    private let searchIndex: SPSearchIndex
+    private let tagIndex: SPTagIndex
+
     /// Active Filter
     ///
     var filter: NoteListFilter = .everything {
@@ -48,8 +53,10 @@ class NoteListController: NSObject {
 
     /// Designated Initializer
     ///
-    init(viewContext: NSManagedObjectContext) {
+    init(viewContext: NSManagedObjectContext, searchIndex: SPSearchIndex = .shared, tagIndex: SPTagIndex = .shared) {
         self.viewContext = viewContext
+        self.searchIndex = searchIndex
+        self.tagIndex = tagIndex
         super.init()
         startListeningToNoteEvents()
     }
@@ -83,7 +90,11 @@ extension NoteListController {
     /// Returns the Indexes for the specified Note Keys (if any)
     ///
     func indexesOfNotes(withSimperiumKeys keys: [String]) -> IndexSet? {
-        let indexes = keys.compactMap { indexOfNote(withSimperiumKey: $0) }
+        let targetKeys = Set(keys)
+        let indexes = notesController.fetchedObjects.enumerated().compactMap { (index, note) in
+            targetKeys.contains(note.simperiumKey ?? "") ? index : nil
+        }
+
         return indexes.isEmpty ? nil : IndexSet(indexes)
     }
 
@@ -116,6 +127,20 @@ extension NoteListController {
     func performFetch() {
         try? notesController.performFetch()
     }
+
+    /// Applies the specified Filter and SortMode, reloads the FetchedObjects, and returns the Diff turning the previous
+    /// Results into the new ones
+    ///
+    func performFetch(filter: NoteListFilter, sortMode: SortMode) -> SPListDiff<NSManagedObjectID> {
+        let oldObjectIDs = notesController.fetchedObjects.map { $0.objectID }
+
+        self.filter = filter
+        self.sortMode = sortMode
+        performFetch()
+
+        let newObjectIDs = notesController.fetchedObjects.map { $0.objectID }
+        return SPListDiff(oldObjects: oldObjectIDs, newObjects: newObjectIDs)
+    }
 }
 
 // MARK: - Private API: ResultsController Refreshing
@@ -123,7 +148,7 @@ extension NoteListController {
 private extension NoteListController {
 
     func refreshPredicates() {
-        notesController.predicate = filter.predicateForNotes()
+        notesController.predicate = filter.predicateForNotes(searchIndex: searchIndex, tagIndex: tagIndex)
     }
 
     func refreshSortDescriptors() {
@@ -15,9 +15,10 @@ enum NoteListFilter: Equatable {
 //
 extension NoteListFilter {
 
-    /// Returns a NSPredicate to filter out Notes in the current state, with the specified Filter
+    /// Returns a NSPredicate to filter out Notes in the current state, with the specified Filter.
+    /// Searches and Tags are narrowed down by the Search and Tag Indexes first, whenever they're ready.
     ///
-    func predicateForNotes() -> NSPredicate {
+    func predicateForNotes(searchIndex: SPSearchIndex = .shared, tagIndex: SPTagIndex = .shared) -> NSPredicate {
         var subpredicates = [
             NSPredicate.predicateForNotes(deleted: self == .deleted)
         ]
@@ -27,12 +28,21 @@ extension NoteListFilter {
             break
 
         case .tag(let name):
+            if let indexPredicate = tagIndex.predicateForNotes(withTag: name) {
+                subpredicates.append(indexPredicate)
+            }
             subpredicates.append( NSPredicate.predicateForNotes(tag: name) )
 
         case .untagged:
+            if let indexPredicate = tagIndex.predicateForUntaggedNotes() {
+                subpredicates.append(indexPredicate)
+            }
             subpredicates.append( NSPredicate.predicateForUntaggedNotes() )
 
         case .search(let query):
+            if let indexPredicate = searchIndex.predicateForNotes(matchingKeywords: query.keywords, tags: query.tags) {
+                subpredicates.append(indexPredicate)
+            }
             subpredicates.append( NSPredicate.predicateForNotes(query: query) )
         }
 
@@ -364,11 +364,27 @@ private extension NoteListViewController {
     ///
     private func refreshListController() {
         let options = Options.shared
-        listController.filter = nextListFilter()
-        listController.sortMode = options.notesListSortMode
-        listController.performFetch()
+        let isTableInSync = tableView.numberOfRows == listController.numberOfNotes
+        let oldFilter = listController.filter
+        let oldSortMode = listController.sortMode
+        let listDiff = listController.performFetch(filter: nextListFilter(), sortMode: options.notesListSortMode)
+
+        /// Only the rows on screen can be updated in place. Moving more than a tenth of the rows one at a time (e.g. once
+        /// the Sort Mode flips the list over) costs more than a reload.
+        let maximumNumberOfMoves = Double(listController.numberOfNotes) * Settings.maximumMovedRowsRatio
+        guard isTableInSync, Double(listDiff.numberOfMoves) <= maximumNumberOfMoves else {
+            tableView.reloadData()
+            return
+        }
+
+        tableView.performBatchChanges(listDiff: listDiff)
 
-        tableView.reloadData()
+        /// Rows left in place still show the excerpt, keywords and prefix of the previous Search or Sort Mode
+        guard listController.filter != oldFilter || listController.sortMode != oldSortMode else {
+            return
+        }
+
+        tableView.reloadVisibleRows()
     }
 
     /// Refresh:  Actions
@@ -868,3 +884,9 @@ extension NoteListViewController {
         SPTracker.trackListNoteRestored()
     }
 }
+
+// MARK: - Settings!
+//
+private enum Settings {
+    static let maximumMovedRowsRatio = 0.1
+}
@@ -0,0 +1,53 @@
+//
+//  SPBacklinkIndex.h
+//  Simplenote
+//
+
+#import <Foundation/Foundation.h>
+#import "SPNoteIndexer.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  @class      SPBacklinkIndex
+ *  @brief      In-memory index of the interlinks between notes: the notes each one links to, and the ones linking to
+ *              it. Contents are scanned for `simplenote://note/<key>` references as they're saved.
+ */
+@interface SPBacklinkIndex : NSObject <SPNoteIndex>
+
+/// Index of the notes in the app's store, once added to the shared indexer
+///
+@property (class, nonatomic, readonly) SPBacklinkIndex *sharedIndex NS_SWIFT_NAME(shared);
+
+/// Indicates if every note has been indexed: until then, backlinks may be missing
+///
+@property (atomic, assign, getter=isReady) BOOL ready;
+
+/// Returns the keys of the notes a text links to, in order of appearance, without duplicates
+///
++ (NSArray<NSString *> *)keysLinkedFromText:(NSString *)text;
+
+/// Indexes the links in the content of a note, replacing whatever was indexed for its key
+///
+- (void)indexNoteWithKey:(NSString *)key content:(nullable NSString *)content;
+
+/// Drops a note's links from the index. Links to it are kept, should it come back.
+///
+- (void)removeNoteWithKey:(NSString *)key;
+
+/// Returns the keys of the notes a note links to
+///
+- (NSArray<NSString *> *)keysLinkedFromNoteWithKey:(NSString *)key NS_SWIFT_NAME(keysForNotes(linkedFrom:));
+
+/// Returns the keys of the notes linking to a note
+///
+- (NSArray<NSString *> *)keysLinkingToNoteWithKey:(NSString *)key NS_SWIFT_NAME(keysForNotes(linkingTo:));
+
+/// Returns a predicate letting through the notes which link to a note. Notes with unsaved changes, and the ones the
+/// index hasn't caught up with, are scanned as they're evaluated.
+///
+- (NSPredicate *)predicateForNotesLinkingToNoteWithKey:(NSString *)key NS_SWIFT_NAME(predicateForNotes(linkingTo:));
+
+@end
+
+NS_ASSUME_NONNULL_END
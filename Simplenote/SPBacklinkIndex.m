@@ -0,0 +1,273 @@
+//
+//  SPBacklinkIndex.m
+//  Simplenote
+//
+
+#import "SPBacklinkIndex.h"
+#import "Note.h"
+
+
+
+#pragma mark ================================================================================
+#pragma mark Constants
+#pragma mark ================================================================================
+
+// References look like `simplenote://note/<key>`, in any case but the key's
+static const char SPBacklinkScheme[] = "simplenote";
+static const char SPBacklinkSeparator[] = "://note/";
+
+
+
+#pragma mark ================================================================================
+#pragma mark Scanner
+#pragma mark ================================================================================
+
+static inline BOOL SPBacklinkIsAlphanumeric(UniChar character)
+{
+    return (character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z') || (character >= '0' && character <= '9');
+}
+
+static inline BOOL SPBacklinkIsSchemeCharacter(UniChar character)
+{
+    return SPBacklinkIsAlphanumeric(character) || character == '+' || character == '-' || character == '.';
+}
+
+// Simperium keys are made of letters, digits, and a few symbols
+static inline BOOL SPBacklinkIsKeyCharacter(UniChar character)
+{
+    return SPBacklinkIsAlphanumeric(character) || character == '-' || character == '_' || character == '.' ||
+           character == '~' || character == '%' || character == '@';
+}
+
+// Compares characters with lowercase ASCII, disregarding their case
+static BOOL SPBacklinkMatchesASCII(CFStringInlineBuffer *buffer, CFIndex length, CFIndex location, const char *ascii, CFIndex asciiLength)
+{
+    if (location < 0 || location + asciiLength > length) {
+        return NO;
+    }
+
+    for (CFIndex i = 0; i < asciiLength; i++) {
+        UniChar character = CFStringGetCharacterFromInlineBuffer(buffer, location + i);
+        if (character >= 'A' && character <= 'Z') {
+            character += 'a' - 'A';
+        }
+
+        if (character != (UniChar)ascii[i]) {
+            return NO;
+        }
+    }
+
+    return YES;
+}
+
+// Returns the range of the key of the next reference from `*location` on, and moves `*location` past it.
+// Colons are rare enough in notes that the scheme is only looked for before them.
+static CFRange SPBacklinkNextKeyRange(CFStringInlineBuffer *buffer, CFIndex length, CFIndex *location)
+{
+    const CFIndex schemeLength = sizeof(SPBacklinkScheme) - 1;
+    const CFIndex separatorLength = sizeof(SPBacklinkSeparator) - 1;
+
+    for (CFIndex i = *location; i < length; i++) {
+        if (CFStringGetCharacterFromInlineBuffer(buffer, i) != ':') {
+            continue;
+        }
+
+        CFIndex schemeLocation = i - schemeLength;
+        if (!SPBacklinkMatchesASCII(buffer, length, schemeLocation, SPBacklinkScheme, schemeLength) ||
+            !SPBacklinkMatchesASCII(buffer, length, i, SPBacklinkSeparator, separatorLength) ||
+            (schemeLocation > 0 && SPBacklinkIsSchemeCharacter(CFStringGetCharacterFromInlineBuffer(buffer, schemeLocation - 1)))) {
+            continue;
+        }
+
+        CFIndex keyLocation = i + separatorLength;
+        CFIndex keyEnd = keyLocation;
+        while (keyEnd < length && SPBacklinkIsKeyCharacter(CFStringGetCharacterFromInlineBuffer(buffer, keyEnd))) {
+            keyEnd++;
+        }
+
+        // Sentences may end right after a reference
+        while (keyEnd > keyLocation && CFStringGetCharacterFromInlineBuffer(buffer, keyEnd - 1) == '.') {
+            keyEnd--;
+        }
+
+        if (keyEnd == keyLocation) {
+            continue;
+        }
+
+        *location = keyEnd;
+        return CFRangeMake(keyLocation, keyEnd - keyLocation);
+    }
+
+    *location = length;
+    return CFRangeMake(kCFNotFound, 0);
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark Private
+#pragma mark ================================================================================
+
+@interface SPBacklinkIndex ()
+
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSArray<NSString *> *>       *linksByKey;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSMutableSet<NSString *> *>  *backlinksByKey;
+
+@end
+
+
+
+#pragma mark ================================================================================
+#pragma mark SPBacklinkIndex
+#pragma mark ================================================================================
+
+@implementation SPBacklinkIndex
+
++ (SPBacklinkIndex *)sharedIndex
+{
+    static SPBacklinkIndex *index;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        index = [SPBacklinkIndex new];
+        index.ready = NO;
+    });
+
+    return index;
+}
+
++ (NSArray<NSString *> *)keysLinkedFromText:(NSString *)text
+{
+    if (![text isKindOfClass:[NSString class]]) {
+        return @[];
+    }
+
+    CFIndex length = (CFIndex)text.length;
+    CFStringInlineBuffer buffer;
+    CFStringInitInlineBuffer((__bridge CFStringRef)text, &buffer, CFRangeMake(0, length));
+
+    NSMutableOrderedSet<NSString *> *keys = [NSMutableOrderedSet orderedSet];
+    CFIndex location = 0;
+
+    while (location < length) {
+        CFRange range = SPBacklinkNextKeyRange(&buffer, length, &location);
+        if (range.location != kCFNotFound) {
+            [keys addObject:[text substringWithRange:NSMakeRange(range.location, range.length)]];
+        }
+    }
+
+    return keys.array;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _linksByKey = [NSMutableDictionary dictionary];
+        _backlinksByKey = [NSMutableDictionary dictionary];
+        _ready = YES;
+    }
+
+    return self;
+}
+
+
+#pragma mark - Indexing
+
+- (void)indexNote:(SPIndexedNote *)note
+{
+    [self indexNoteWithKey:note.key content:note.content];
+}
+
+- (void)indexNoteWithKey:(NSString *)key content:(NSString *)content
+{
+    // Scanning, the longest part, doesn't need the lock
+    NSArray<NSString *> *links = [SPBacklinkIndex keysLinkedFromText:content];
+
+    @synchronized (self) {
+        // Most saves leave the links alone
+        NSArray<NSString *> *oldLinks = self.linksByKey[key];
+        if ([oldLinks isEqualToArray:links]) {
+            return;
+        }
+
+        [self removeLinksFromKey:key];
+
+        self.linksByKey[key] = links;
+        for (NSString *link in links) {
+            NSMutableSet<NSString *> *backlinks = self.backlinksByKey[link];
+            if (!backlinks) {
+                backlinks = [NSMutableSet set];
+                self.backlinksByKey[link] = backlinks;
+            }
+
+            [backlinks addObject:key];
+        }
+    }
+}
+
+- (void)removeNoteWithKey:(NSString *)key
+{
+    @synchronized (self) {
+        [self removeLinksFromKey:key];
+    }
+}
+
+- (void)removeAllNotes
+{
+    @synchronized (self) {
+        [self.linksByKey removeAllObjects];
+        [self.backlinksByKey removeAllObjects];
+    }
+}
+
+- (void)removeLinksFromKey:(NSString *)key
+{
+    for (NSString *link in self.linksByKey[key]) {
+        NSMutableSet<NSString *> *backlinks = self.backlinksByKey[link];
+        [backlinks removeObject:key];
+
+        if (backlinks.count == 0) {
+            [self.backlinksByKey removeObjectForKey:link];
+        }
+    }
+
+    [self.linksByKey removeObjectForKey:key];
+}
+
+
+#pragma mark - Looking Up
+
+- (NSArray<NSString *> *)keysLinkedFromNoteWithKey:(NSString *)key
+{
+    @synchronized (self) {
+        return self.linksByKey[key] ?: @[];
+    }
+}
+
+- (NSArray<NSString *> *)keysLinkingToNoteWithKey:(NSString *)key
+{
+    @synchronized (self) {
+        return self.backlinksByKey[key].allObjects ?: @[];
+    }
+}
+
+- (NSPredicate *)predicateForNotesLinkingToNoteWithKey:(NSString *)key
+{
+    __weak SPBacklinkIndex *weakSelf = self;
+    return [NSPredicate predicateWithBlock:^BOOL(Note *note, NSDictionary *bindings) {
+        NSString *noteKey = note.simperiumKey;
+        SPBacklinkIndex *index = weakSelf;
+
+        if (noteKey && index && !note.hasChanges) {
+            @synchronized (index) {
+                if (index.linksByKey[noteKey]) {
+                    return [index.backlinksByKey[key] containsObject:noteKey];
+                }
+            }
+        }
+
+        return [[SPBacklinkIndex keysLinkedFromText:note.content] containsObject:key];
+    }];
+}
+
+@end
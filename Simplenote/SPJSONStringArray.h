@@ -0,0 +1,47 @@
+//
+//  SPJSONStringArray.h
+//  Simplenote
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  @class      SPJSONStringArray
+ *  @brief      Reads and edits JSON arrays of strings, such as the tags of a note, in a single pass over their
+ *              characters. Strings without escapes are compared and copied straight from the JSON, and editing an
+ *              array doesn't decode the strings it keeps.
+ *              Anything other than a flat array of strings is rejected, and left to NSJSONSerialization.
+ */
+@interface SPJSONStringArray : NSObject
+
+/// Returns the strings in a JSON array, or nil when it's malformed or holds anything else
+///
++ (nullable NSMutableArray<NSString *> *)arrayFromJSONString:(NSString *)json NS_SWIFT_NAME(array(fromJSONString:));
+
+/// Returns the JSON for an array of strings, escaped like NSJSONSerialization does, or nil when it holds anything else
+///
++ (nullable NSString *)JSONStringFromArray:(NSArray<NSString *> *)array NS_SWIFT_NAME(jsonString(from:));
+
+/// Indicates if a JSON array holds a string, compared like -compare: does. Returns NO when it's malformed.
+///
++ (BOOL)JSONString:(NSString *)json containsString:(NSString *)string NS_SWIFT_NAME(jsonString(_:contains:));
+
+/// Indicates if a JSON array holds a string, compared like -compare: does. When it doesn't, tells whether the array
+/// was rejected as malformed.
+///
++ (BOOL)JSONString:(NSString *)json containsString:(NSString *)string malformed:(nullable BOOL *)malformed NS_SWIFT_NAME(jsonString(_:contains:malformed:));
+
+/// Returns a JSON array with a string appended, or nil when it's malformed
+///
++ (nullable NSString *)JSONString:(NSString *)json byAppendingString:(NSString *)string NS_SWIFT_NAME(jsonString(_:byAppending:));
+
+/// Returns a JSON array without the elements matching a string, the same one when there are none, or nil when it's
+/// malformed
+///
++ (nullable NSString *)JSONString:(NSString *)json byRemovingString:(NSString *)string NS_SWIFT_NAME(jsonString(_:byRemoving:));
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,436 @@
+//
+//  SPJSONStringArray.m
+//  Simplenote
+//
+
+#import "SPJSONStringArray.h"
+
+
+
+#pragma mark ================================================================================
+#pragma mark Reader
+#pragma mark ================================================================================
+
+typedef struct {
+    CFStringInlineBuffer buffer;
+    CFIndex length;
+    CFIndex location;
+    NSUInteger count;           // Elements read so far
+    BOOL finished;
+    BOOL failed;
+} SPJSONReader;
+
+// Characters between the quotes of an element, and the element itself, quotes included
+typedef struct {
+    CFRange range;
+    CFRange span;
+    BOOL escaped;
+} SPJSONElement;
+
+static inline UniChar SPJSONReaderCharacter(SPJSONReader *reader, CFIndex location)
+{
+    return location < reader->length ? CFStringGetCharacterFromInlineBuffer(&reader->buffer, location) : 0;
+}
+
+static inline BOOL SPJSONIsWhitespace(UniChar character)
+{
+    return character == ' ' || character == '\t' || character == '\n' || character == '\r';
+}
+
+static inline BOOL SPJSONIsHexDigit(UniChar character)
+{
+    return (character >= '0' && character <= '9') || (character >= 'a' && character <= 'f') || (character >= 'A' && character <= 'F');
+}
+
+static void SPJSONReaderSkipWhitespace(SPJSONReader *reader)
+{
+    while (reader->location < reader->length && SPJSONIsWhitespace(SPJSONReaderCharacter(reader, reader->location))) {
+        reader->location++;
+    }
+}
+
+static void SPJSONReaderFail(SPJSONReader *reader)
+{
+    reader->failed = YES;
+    reader->finished = YES;
+}
+
+// Reads up to the first element, or the end of an empty array
+static void SPJSONReaderOpen(SPJSONReader *reader, CFStringRef json)
+{
+    memset(reader, 0, sizeof(SPJSONReader));
+    reader->length = CFStringGetLength(json);
+    CFStringInitInlineBuffer(json, &reader->buffer, CFRangeMake(0, reader->length));
+
+    SPJSONReaderSkipWhitespace(reader);
+    if (SPJSONReaderCharacter(reader, reader->location) != '[') {
+        SPJSONReaderFail(reader);
+        return;
+    }
+
+    reader->location++;
+    SPJSONReaderSkipWhitespace(reader);
+
+    if (SPJSONReaderCharacter(reader, reader->location) == ']') {
+        reader->location++;
+        SPJSONReaderSkipWhitespace(reader);
+        reader->finished = YES;
+        reader->failed = reader->location != reader->length;
+    }
+}
+
+// Reads the next element, along with the comma or bracket following it. Returns NO past the last one, or on failure.
+static BOOL SPJSONReaderNext(SPJSONReader *reader, SPJSONElement *element)
+{
+    if (reader->finished) {
+        return NO;
+    }
+
+    if (SPJSONReaderCharacter(reader, reader->location) != '"') {
+        SPJSONReaderFail(reader);
+        return NO;
+    }
+
+    CFIndex start = reader->location++;
+    BOOL escaped = NO;
+
+    while (YES) {
+        if (reader->location >= reader->length) {
+            SPJSONReaderFail(reader);
+            return NO;
+        }
+
+        UniChar character = SPJSONReaderCharacter(reader, reader->location);
+        if (character == '"') {
+            break;
+        }
+
+        if (character < 0x20) {
+            SPJSONReaderFail(reader);
+            return NO;
+        }
+
+        if (character != '\\') {
+            reader->location++;
+            continue;
+        }
+
+        escaped = YES;
+        UniChar escape = SPJSONReaderCharacter(reader, reader->location + 1);
+
+        if (escape == 'u') {
+            for (CFIndex i = 2; i < 6; i++) {
+                if (!SPJSONIsHexDigit(SPJSONReaderCharacter(reader, reader->location + i))) {
+                    SPJSONReaderFail(reader);
+                    return NO;
+                }
+            }
+            reader->location += 6;
+        } else if (escape && escape < 0x80 && strchr("\"\\/bfnrt", (char)escape)) {
+            reader->location += 2;
+        } else {
+            SPJSONReaderFail(reader);
+            return NO;
+        }
+    }
+
+    element->range = CFRangeMake(start + 1, reader->location - start - 1);
+    element->span = CFRangeMake(start, reader->location - start + 1);
+    element->escaped = escaped;
+
+    reader->location++;
+    reader->count++;
+    SPJSONReaderSkipWhitespace(reader);
+
+    UniChar separator = SPJSONReaderCharacter(reader, reader->location++);
+    SPJSONReaderSkipWhitespace(reader);
+
+    if (separator == ']') {
+        reader->finished = YES;
+        reader->failed = reader->location != reader->length;
+        return !reader->failed;
+    }
+
+    if (separator != ',') {
+        SPJSONReaderFail(reader);
+        return NO;
+    }
+
+    return YES;
+}
+
+static UniChar SPJSONHexValue(UniChar character)
+{
+    if (character <= '9') {
+        return character - '0';
+    }
+
+    return (character | 0x20) - 'a' + 10;
+}
+
+static NSString *SPJSONElementString(SPJSONReader *reader, CFStringRef json, const SPJSONElement *element)
+{
+    if (!element->escaped) {
+        return (__bridge_transfer NSString *)CFStringCreateWithSubstring(kCFAllocatorDefault, json, element->range);
+    }
+
+    NSMutableString *string = [NSMutableString stringWithCapacity:element->range.length];
+    CFIndex end = element->range.location + element->range.length;
+
+    for (CFIndex i = element->range.location; i < end; i++) {
+        UniChar character = SPJSONReaderCharacter(reader, i);
+        if (character == '\\') {
+            UniChar escape = SPJSONReaderCharacter(reader, ++i);
+            switch (escape) {
+                case 'b':
+                    character = '\b';
+                    break;
+                case 'f':
+                    character = '\f';
+                    break;
+                case 'n':
+                    character = '\n';
+                    break;
+                case 'r':
+                    character = '\r';
+                    break;
+                case 't':
+                    character = '\t';
+                    break;
+                case 'u':
+                    character = 0;
+                    for (CFIndex j = 1; j <= 4; j++) {
+                        character = (UniChar)(character << 4 | SPJSONHexValue(SPJSONReaderCharacter(reader, i + j)));
+                    }
+                    i += 4;
+                    break;
+                default:
+                    character = escape;
+                    break;
+            }
+        }
+
+        // Surrogates escaped one at a time come back together as UTF-16
+        CFStringAppendCharacters((__bridge CFMutableStringRef)string, &character, 1);
+    }
+
+    return string;
+}
+
+// Compares like -compare: does, so canonically equivalent spellings match (e.g. a precomposed "é" and "e" + U+0301)
+static BOOL SPJSONElementEqualsString(SPJSONReader *reader, CFStringRef json, const SPJSONElement *element, NSString *string)
+{
+    if (!element->escaped) {
+        return CFStringCompareWithOptions(json, (__bridge CFStringRef)string, element->range, kCFCompareNonliteral) == kCFCompareEqualTo;
+    }
+
+    return [SPJSONElementString(reader, json, element) compare:string] == NSOrderedSame;
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark Writer
+#pragma mark ================================================================================
+
+// Escapes a string the way NSJSONSerialization does, slashes included
+static void SPJSONAppendString(NSMutableString *output, NSString *string)
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    CFIndex length = (CFIndex)string.length;
+    CFStringInlineBuffer buffer;
+    CFStringInitInlineBuffer((__bridge CFStringRef)string, &buffer, CFRangeMake(0, length));
+
+    CFMutableStringRef target = (__bridge CFMutableStringRef)output;
+    CFStringAppendCString(target, "\"", kCFStringEncodingASCII);
+
+    // Runs of characters needing no escape are appended at once
+    CFIndex runStart = 0;
+    for (CFIndex i = 0; i < length; i++) {
+        UniChar character = CFStringGetCharacterFromInlineBuffer(&buffer, i);
+        if (character >= 0x20 && character != '"' && character != '\\' && character != '/') {
+            continue;
+        }
+
+        if (i > runStart) {
+            [output appendString:[string substringWithRange:NSMakeRange(runStart, i - runStart)]];
+        }
+        runStart = i + 1;
+
+        char escape[7] = { '\\', 0, 0, 0, 0, 0, 0 };
+        switch (character) {
+            case '"':
+            case '\\':
+            case '/':
+                escape[1] = (char)character;
+                break;
+            case '\b':
+                escape[1] = 'b';
+                break;
+            case '\f':
+                escape[1] = 'f';
+                break;
+            case '\n':
+                escape[1] = 'n';
+                break;
+            case '\r':
+                escape[1] = 'r';
+                break;
+            case '\t':
+                escape[1] = 't';
+                break;
+            default:
+                escape[1] = 'u';
+                escape[2] = '0';
+                escape[3] = '0';
+                escape[4] = hexDigits[character >> 4];
+                escape[5] = hexDigits[character & 0xF];
+                break;
+        }
+
+        CFStringAppendCString(target, escape, kCFStringEncodingASCII);
+    }
+
+    if (runStart == 0) {
+        [output appendString:string];
+    } else if (runStart < length) {
+        [output appendString:[string substringFromIndex:runStart]];
+    }
+
+    CFStringAppendCString(target, "\"", kCFStringEncodingASCII);
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark SPJSONStringArray
+#pragma mark ================================================================================
+
+@implementation SPJSONStringArray
+
++ (NSMutableArray<NSString *> *)arrayFromJSONString:(NSString *)json
+{
+    CFStringRef source = (__bridge CFStringRef)json;
+    SPJSONReader reader;
+    SPJSONElement element;
+
+    SPJSONReaderOpen(&reader, source);
+
+    NSMutableArray<NSString *> *array = [NSMutableArray array];
+    while (SPJSONReaderNext(&reader, &element)) {
+        [array addObject:SPJSONElementString(&reader, source, &element)];
+    }
+
+    return reader.failed ? nil : array;
+}
+
++ (NSString *)JSONStringFromArray:(NSArray<NSString *> *)array
+{
+    NSMutableString *output = [NSMutableString stringWithString:@"["];
+
+    for (NSString *string in array) {
+        if (![string isKindOfClass:[NSString class]]) {
+            return nil;
+        }
+
+        if (output.length > 1) {
+            [output appendString:@","];
+        }
+        SPJSONAppendString(output, string);
+    }
+
+    [output appendString:@"]"];
+
+    return output;
+}
+
++ (BOOL)JSONString:(NSString *)json containsString:(NSString *)string
+{
+    return [self JSONString:json containsString:string malformed:NULL];
+}
+
++ (BOOL)JSONString:(NSString *)json containsString:(NSString *)string malformed:(BOOL *)malformed
+{
+    CFStringRef source = (__bridge CFStringRef)json;
+    SPJSONReader reader;
+    SPJSONElement element;
+
+    SPJSONReaderOpen(&reader, source);
+
+    while (SPJSONReaderNext(&reader, &element)) {
+        if (SPJSONElementEqualsString(&reader, source, &element, string)) {
+            return YES;
+        }
+    }
+
+    if (malformed) {
+        *malformed = reader.failed;
+    }
+
+    return NO;
+}
+
++ (NSString *)JSONString:(NSString *)json byAppendingString:(NSString *)string
+{
+    SPJSONReader reader;
+    SPJSONElement element;
+
+    SPJSONReaderOpen(&reader, (__bridge CFStringRef)json);
+    while (SPJSONReaderNext(&reader, &element)) { }
+
+    if (reader.failed) {
+        return nil;
+    }
+
+    // Everything up to the closing bracket is kept as is
+    NSRange closingBracket = [json rangeOfString:@"]" options:NSBackwardsSearch];
+    NSMutableString *output = [[json substringToIndex:closingBracket.location] mutableCopy];
+
+    if (reader.count > 0) {
+        [output appendString:@","];
+    }
+    SPJSONAppendString(output, string);
+    [output appendString:@"]"];
+
+    return output;
+}
+
++ (NSString *)JSONString:(NSString *)json byRemovingString:(NSString *)string
+{
+    CFStringRef source = (__bridge CFStringRef)json;
+    SPJSONReader reader;
+    SPJSONElement element;
+
+    SPJSONReaderOpen(&reader, source);
+
+    // Elements kept are copied as they are, escapes included
+    NSMutableString *output = [NSMutableString stringWithString:@"["];
+    BOOL removed = NO;
+
+    while (SPJSONReaderNext(&reader, &element)) {
+        if (SPJSONElementEqualsString(&reader, source, &element, string)) {
+            removed = YES;
+            continue;
+        }
+
+        if (output.length > 1) {
+            [output appendString:@","];
+        }
+        [output appendString:[json substringWithRange:NSMakeRange(element.span.location, element.span.length)]];
+    }
+
+    if (reader.failed) {
+        return nil;
+    }
+
+    if (!removed) {
+        return json;
+    }
+
+    [output appendString:@"]"];
+
+    return output;
+}
+
+@end
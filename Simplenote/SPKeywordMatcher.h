@@ -0,0 +1,55 @@
+//
+//  SPKeywordMatcher.h
+//  Simplenote
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  @class      SPKeywordSlice
+ *  @brief      Words of a text containing a keyword, along with the slice of the text around them.
+ */
+@interface SPKeywordSlice : NSObject
+
+/// Range of the slice, bounded by words
+///
+@property (nonatomic, assign, readonly) NSRange range;
+
+/// Ranges of the words containing a keyword, in order
+///
+@property (nonatomic, copy, readonly) NSArray<NSValue *> *matches;
+
+@end
+
+
+/**
+ *  @class      SPKeywordMatcher
+ *  @brief      Finds every keyword of a search in a single pass over a text, disregarding case and diacritics.
+ *              Keywords are folded and compiled into an Aho-Corasick automaton once.
+ */
+@interface SPKeywordMatcher : NSObject
+
+@property (nonatomic, copy, readonly) NSArray<NSString *> *keywords;
+
+/// Returns a matcher for the keywords, reusing the last one while they don't change: every cell of a search
+/// result list asks for the same ones.
+///
++ (SPKeywordMatcher *)matcherForKeywords:(NSArray<NSString *> *)keywords NS_SWIFT_NAME(matcher(for:));
+
+- (instancetype)initWithKeywords:(NSArray<NSString *> *)keywords NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Returns the words within a range of a text which contain a keyword, and the slice around them: full words up to
+/// a number of characters before the first one, and after it, or the whole range when a limit is zero.
+/// Returns nil when no word contains a keyword.
+///
+- (nullable SPKeywordSlice *)sliceOfText:(NSString *)text
+                                 inRange:(NSRange)range
+                            leadingLimit:(NSUInteger)leadingLimit
+                           trailingLimit:(NSUInteger)trailingLimit NS_SWIFT_NAME(slice(of:in:leadingLimit:trailingLimit:));
+
+@end
+
+NS_ASSUME_NONNULL_END
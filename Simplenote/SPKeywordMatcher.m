@@ -0,0 +1,513 @@
+//
+//  SPKeywordMatcher.m
+//  Simplenote
+//
+
+#import "SPKeywordMatcher.h"
+
+
+
+#pragma mark ================================================================================
+#pragma mark Folding
+#pragma mark ================================================================================
+
+// Units a character folds into: none for the marks dropped along with diacritics, several for ß or ligatures.
+// Surrogates are left alone.
+typedef struct {
+    uint8_t count;
+    UniChar units[3];
+} SPFoldedCharacter;
+
+// Folded characters, computed 256 at a time, the first time one of them shows up
+static SPFoldedCharacter *SPFoldedBlocks[256];
+
+static SPFoldedCharacter *SPFoldedBlockCreate(uint32_t block)
+{
+    SPFoldedCharacter *characters = calloc(256, sizeof(SPFoldedCharacter));
+    CFMutableStringRef string = CFStringCreateMutable(kCFAllocatorDefault, 0);
+
+    for (uint32_t i = 0; i < 256; i++) {
+        UniChar character = (UniChar)(block << 8 | i);
+        SPFoldedCharacter *folded = &characters[i];
+
+        if (CFStringIsSurrogateHighCharacter(character) || CFStringIsSurrogateLowCharacter(character)) {
+            folded->count = 1;
+            folded->units[0] = character;
+            continue;
+        }
+
+        CFStringReplaceAll(string, CFSTR(""));
+        CFStringAppendCharacters(string, &character, 1);
+        CFStringFold(string, kCFCompareCaseInsensitive | kCFCompareDiacriticInsensitive, NULL);
+
+        CFIndex length = MIN(CFStringGetLength(string), 3);
+        CFStringGetCharacters(string, CFRangeMake(0, length), folded->units);
+        folded->count = (uint8_t)length;
+    }
+
+    CFRelease(string);
+    return characters;
+}
+
+static inline const SPFoldedCharacter *SPFoldCharacter(UniChar character)
+{
+    uint32_t block = character >> 8;
+    SPFoldedCharacter *characters = __atomic_load_n(&SPFoldedBlocks[block], __ATOMIC_ACQUIRE);
+
+    if (!characters) {
+        @synchronized ([SPKeywordMatcher class]) {
+            characters = SPFoldedBlocks[block];
+            if (!characters) {
+                characters = SPFoldedBlockCreate(block);
+                __atomic_store_n(&SPFoldedBlocks[block], characters, __ATOMIC_RELEASE);
+            }
+        }
+    }
+
+    return &characters[character & 0xFF];
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark Automaton
+#pragma mark ================================================================================
+
+// Trie of the folded keywords. Children hang off their parent as a list, for the failure links to be built, and
+// are looked up through a hash table while matching.
+typedef struct {
+    uint32_t fail;
+    uint32_t output;            // Closest node down the failure links where a keyword ends, or 0
+    uint32_t length;            // Length of the keyword ending here, in folded units, or 0
+    uint32_t child;
+    uint32_t sibling;
+    UniChar unit;
+} SPMatcherNode;
+
+typedef struct {
+    uint64_t key;               // Parent node and unit, plus one: 0 for empty slots
+    uint32_t child;
+} SPMatcherEdge;
+
+typedef struct {
+    SPMatcherNode *nodes;
+    uint32_t nodeCount;
+    SPMatcherEdge *edges;
+    uint32_t edgeMask;
+    uint32_t longest;
+} SPMatcherAutomaton;
+
+typedef struct {
+    CFIndex start;
+    CFIndex end;
+} SPMatcherHit;
+
+static inline uint64_t SPMatcherEdgeKey(uint32_t node, UniChar unit)
+{
+    return ((uint64_t)node << 16 | unit) + 1;
+}
+
+static inline uint32_t SPMatcherEdgeSlot(const SPMatcherAutomaton *automaton, uint64_t key)
+{
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & automaton->edgeMask;
+}
+
+// Returns the child of a node for a unit, or 0: the root is never anybody's child
+static inline uint32_t SPMatcherChild(const SPMatcherAutomaton *automaton, uint32_t node, UniChar unit)
+{
+    uint64_t key = SPMatcherEdgeKey(node, unit);
+    uint32_t slot = SPMatcherEdgeSlot(automaton, key);
+
+    for (; automaton->edges[slot].key; slot = (slot + 1) & automaton->edgeMask) {
+        if (automaton->edges[slot].key == key) {
+            return automaton->edges[slot].child;
+        }
+    }
+
+    return 0;
+}
+
+static void SPMatcherAddChild(SPMatcherAutomaton *automaton, uint32_t parent, uint32_t child, UniChar unit)
+{
+    uint64_t key = SPMatcherEdgeKey(parent, unit);
+    uint32_t slot = SPMatcherEdgeSlot(automaton, key);
+
+    while (automaton->edges[slot].key) {
+        slot = (slot + 1) & automaton->edgeMask;
+    }
+
+    automaton->edges[slot].key = key;
+    automaton->edges[slot].child = child;
+
+    SPMatcherNode *node = &automaton->nodes[child];
+    node->unit = unit;
+    node->sibling = automaton->nodes[parent].child;
+    automaton->nodes[parent].child = child;
+}
+
+// Builds the automaton out of keywords folded into a single buffer, given their lengths
+static void SPMatcherAutomatonBuild(SPMatcherAutomaton *automaton, const UniChar *units, const uint32_t *lengths, uint32_t count)
+{
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        total += lengths[i];
+    }
+
+    uint32_t edgeCount = 16;
+    while (edgeCount < total * 2) {
+        edgeCount *= 2;
+    }
+
+    automaton->nodes = calloc(total + 1, sizeof(SPMatcherNode));
+    automaton->nodeCount = 1;
+    automaton->edges = calloc(edgeCount, sizeof(SPMatcherEdge));
+    automaton->edgeMask = edgeCount - 1;
+    automaton->longest = 1;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t node = 0;
+
+        for (uint32_t j = 0; j < lengths[i]; j++) {
+            uint32_t child = SPMatcherChild(automaton, node, units[j]);
+            if (!child) {
+                child = automaton->nodeCount++;
+                SPMatcherAddChild(automaton, node, child, units[j]);
+            }
+            node = child;
+        }
+
+        automaton->nodes[node].length = lengths[i];
+        automaton->longest = MAX(automaton->longest, lengths[i]);
+        units += lengths[i];
+    }
+
+    // Failure links, breadth first: a node fails over to the longest suffix of its path found in the trie
+    uint32_t *queue = malloc(automaton->nodeCount * sizeof(uint32_t));
+    uint32_t head = 0;
+    uint32_t tail = 0;
+
+    for (uint32_t child = automaton->nodes[0].child; child; child = automaton->nodes[child].sibling) {
+        queue[tail++] = child;
+    }
+
+    while (head < tail) {
+        uint32_t parent = queue[head++];
+
+        for (uint32_t child = automaton->nodes[parent].child; child; child = automaton->nodes[child].sibling) {
+            UniChar unit = automaton->nodes[child].unit;
+            uint32_t fail = automaton->nodes[parent].fail;
+            uint32_t next;
+
+            while (!(next = SPMatcherChild(automaton, fail, unit)) && fail) {
+                fail = automaton->nodes[fail].fail;
+            }
+
+            SPMatcherNode *node = &automaton->nodes[child];
+            node->fail = next;
+            node->output = automaton->nodes[next].length ? next : automaton->nodes[next].output;
+            queue[tail++] = child;
+        }
+    }
+
+    free(queue);
+}
+
+static void SPMatcherAutomatonFree(SPMatcherAutomaton *automaton)
+{
+    free(automaton->nodes);
+    free(automaton->edges);
+    memset(automaton, 0, sizeof(SPMatcherAutomaton));
+}
+
+// Returns every keyword found within a range of a string, as UTF-16 ranges of the string, ordered by location
+static SPMatcherHit *SPMatcherAutomatonScan(const SPMatcherAutomaton *automaton, CFStringRef string, CFRange range, size_t *count)
+{
+    size_t capacity = 16;
+    SPMatcherHit *hits = malloc(capacity * sizeof(SPMatcherHit));
+    *count = 0;
+
+    // Where the last folded units come from, to tell where keywords ending on the current one start
+    CFIndex *origins = malloc(automaton->longest * sizeof(CFIndex));
+    uint64_t position = 0;
+    uint32_t state = 0;
+
+    CFStringInlineBuffer buffer;
+    CFStringInitInlineBuffer(string, &buffer, range);
+
+    for (CFIndex i = 0; i < range.length; i++) {
+        const SPFoldedCharacter *folded = SPFoldCharacter(CFStringGetCharacterFromInlineBuffer(&buffer, i));
+
+        for (uint8_t k = 0; k < folded->count; k++) {
+            UniChar unit = folded->units[k];
+            uint32_t next;
+
+            while (!(next = SPMatcherChild(automaton, state, unit)) && state) {
+                state = automaton->nodes[state].fail;
+            }
+
+            state = next;
+            origins[position++ % automaton->longest] = range.location + i;
+
+            uint32_t node = automaton->nodes[state].length ? state : automaton->nodes[state].output;
+            for (; node; node = automaton->nodes[node].output) {
+                if (*count == capacity) {
+                    capacity *= 2;
+                    hits = realloc(hits, capacity * sizeof(SPMatcherHit));
+                }
+
+                hits[*count].start = origins[(position - automaton->nodes[node].length) % automaton->longest];
+                hits[*count].end = range.location + i + 1;
+                *count += 1;
+            }
+        }
+    }
+
+    free(origins);
+
+    // Hits come out by end, and several keywords may end together: shorter ones come out last
+    for (size_t i = 1; i < *count; i++) {
+        SPMatcherHit hit = hits[i];
+        size_t j = i;
+
+        for (; j > 0 && hits[j - 1].start > hit.start; j--) {
+            hits[j] = hits[j - 1];
+        }
+
+        hits[j] = hit;
+    }
+
+    return hits;
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark Characters
+#pragma mark ================================================================================
+
+// Indicates if there are more characters than a limit between two locations, counting like Swift does
+static BOOL SPCharacterDistanceExceeds(NSString *text, CFIndex from, CFIndex to, NSUInteger limit)
+{
+    // Characters span at least one unit each
+    if ((NSUInteger)(to - from) <= limit) {
+        return NO;
+    }
+
+    NSUInteger count = 0;
+    for (CFIndex location = from; location < to; count++) {
+        if (count == limit) {
+            return YES;
+        }
+
+        NSRange character = [text rangeOfComposedCharacterSequenceAtIndex:location];
+        location = NSMaxRange(character);
+    }
+
+    return NO;
+}
+
+// Returns the location a number of characters before another one, without going past a lower bound
+static CFIndex SPLocationBefore(NSString *text, CFIndex location, NSUInteger count, CFIndex lowerBound)
+{
+    for (NSUInteger i = 0; i < count && location > lowerBound; i++) {
+        location = [text rangeOfComposedCharacterSequenceAtIndex:location - 1].location;
+    }
+
+    return MAX(location, lowerBound);
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark SPKeywordSlice
+#pragma mark ================================================================================
+
+@interface SPKeywordSlice ()
+@property (nonatomic, assign, readwrite) NSRange range;
+@property (nonatomic, copy, readwrite) NSArray<NSValue *> *matches;
+@end
+
+@implementation SPKeywordSlice
+@end
+
+
+
+#pragma mark ================================================================================
+#pragma mark SPKeywordMatcher
+#pragma mark ================================================================================
+
+@interface SPKeywordMatcher ()
+{
+    SPMatcherAutomaton _automaton;
+}
+@end
+
+@implementation SPKeywordMatcher
+
++ (SPKeywordMatcher *)matcherForKeywords:(NSArray<NSString *> *)keywords
+{
+    static SPKeywordMatcher *lastMatcher;
+
+    @synchronized (self) {
+        if (![lastMatcher.keywords isEqualToArray:keywords]) {
+            lastMatcher = [[SPKeywordMatcher alloc] initWithKeywords:keywords];
+        }
+
+        return lastMatcher;
+    }
+}
+
+- (instancetype)initWithKeywords:(NSArray<NSString *> *)keywords
+{
+    self = [super init];
+    if (self) {
+        _keywords = [keywords copy];
+        [self buildAutomaton];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    SPMatcherAutomatonFree(&_automaton);
+}
+
+// Keywords are folded one character at a time, exactly like the texts they're matched against
+- (void)buildAutomaton
+{
+    NSUInteger capacity = 0;
+    for (NSString *keyword in self.keywords) {
+        capacity += keyword.length * 3;
+    }
+
+    UniChar *units = malloc(MAX(capacity, 1) * sizeof(UniChar));
+    uint32_t *lengths = malloc(MAX(self.keywords.count, 1) * sizeof(uint32_t));
+    uint32_t unitCount = 0;
+    uint32_t keywordCount = 0;
+
+    for (NSString *keyword in self.keywords) {
+        uint32_t length = 0;
+
+        for (NSUInteger i = 0; i < keyword.length; i++) {
+            const SPFoldedCharacter *folded = SPFoldCharacter([keyword characterAtIndex:i]);
+            for (uint8_t k = 0; k < folded->count; k++) {
+                units[unitCount + length++] = folded->units[k];
+            }
+        }
+
+        // Keywords folding into nothing would match everywhere, while they used to match nowhere
+        if (length > 0) {
+            lengths[keywordCount++] = length;
+            unitCount += length;
+        }
+    }
+
+    SPMatcherAutomatonBuild(&_automaton, units, lengths, keywordCount);
+
+    free(units);
+    free(lengths);
+}
+
+- (SPKeywordSlice *)sliceOfText:(NSString *)text inRange:(NSRange)range leadingLimit:(NSUInteger)leadingLimit trailingLimit:(NSUInteger)trailingLimit
+{
+    CFStringRef string = (__bridge CFStringRef)text;
+    size_t hitCount = 0;
+    SPMatcherHit *hits = SPMatcherAutomatonScan(&_automaton, string, CFRangeMake(range.location, range.length), &hitCount);
+
+    if (hitCount == 0) {
+        free(hits);
+        return nil;
+    }
+
+    CFLocaleRef locale = CFLocaleCopyCurrent();
+    CFStringTokenizerRef tokenizer = CFStringTokenizerCreate(kCFAllocatorDefault, string, CFRangeMake(range.location, range.length), kCFStringTokenizerUnitWord, locale);
+    CFRelease(locale);
+
+    // Words before the one with the first hit don't matter, besides the ones leading it
+    CFIndex firstWordLocation = hits[0].start;
+    if (CFStringTokenizerGoToTokenAtIndex(tokenizer, hits[0].start) != kCFStringTokenizerTokenNone) {
+        firstWordLocation = CFStringTokenizerGetCurrentTokenRange(tokenizer).location;
+    }
+
+    CFIndex location = leadingLimit > 0 ? SPLocationBefore(text, firstWordLocation, leadingLimit + 1, range.location) : firstWordLocation;
+    CFStringTokenizerTokenType type = kCFStringTokenizerTokenNone;
+
+    for (; location < (CFIndex)NSMaxRange(range) && type == kCFStringTokenizerTokenNone; location++) {
+        type = CFStringTokenizerGoToTokenAtIndex(tokenizer, location);
+    }
+
+    NSMutableArray<NSValue *> *matches = [NSMutableArray array];
+    NSRange firstMatch = NSMakeRange(NSNotFound, 0);
+    NSRange lastMatch = NSMakeRange(NSNotFound, 0);
+    NSRange lastTrailingWord = NSMakeRange(NSNotFound, 0);
+    NSMutableArray<NSValue *> *leadingWords = [NSMutableArray array];
+    size_t hitIndex = 0;
+
+    for (; type != kCFStringTokenizerTokenNone; type = CFStringTokenizerAdvanceToNextToken(tokenizer)) {
+        CFRange token = CFStringTokenizerGetCurrentTokenRange(tokenizer);
+        NSRange word = NSMakeRange(token.location, token.length);
+        BOOL matched = firstMatch.location != NSNotFound;
+
+        if (trailingLimit > 0 && matched) {
+            if (SPCharacterDistanceExceeds(text, NSMaxRange(firstMatch), NSMaxRange(word), trailingLimit)) {
+                break;
+            }
+
+            lastTrailingWord = word;
+        }
+
+        while (hitIndex < hitCount && hits[hitIndex].start < (CFIndex)word.location) {
+            hitIndex++;
+        }
+
+        for (size_t i = hitIndex; i < hitCount && hits[i].start < (CFIndex)NSMaxRange(word); i++) {
+            if (hits[i].end <= (CFIndex)NSMaxRange(word)) {
+                [matches addObject:[NSValue valueWithRange:word]];
+                if (!matched) {
+                    firstMatch = word;
+                }
+                lastMatch = word;
+                break;
+            }
+        }
+
+        if (leadingLimit > 0 && firstMatch.location == NSNotFound) {
+            [leadingWords addObject:[NSValue valueWithRange:word]];
+        }
+    }
+
+    free(hits);
+    CFRelease(tokenizer);
+
+    if (firstMatch.location == NSNotFound) {
+        return nil;
+    }
+
+    NSUInteger lowerBound = range.location;
+    if (leadingLimit > 0) {
+        lowerBound = firstMatch.location;
+
+        for (NSValue *value in leadingWords.reverseObjectEnumerator) {
+            NSRange word = value.rangeValue;
+            if (SPCharacterDistanceExceeds(text, word.location, firstMatch.location, leadingLimit)) {
+                break;
+            }
+
+            lowerBound = word.location;
+        }
+    }
+
+    NSUInteger upperBound = NSMaxRange(range);
+    if (trailingLimit > 0) {
+        upperBound = lastTrailingWord.location != NSNotFound ? NSMaxRange(lastTrailingWord) : NSMaxRange(lastMatch);
+    }
+
+    SPKeywordSlice *slice = [SPKeywordSlice new];
+    slice.range = NSMakeRange(lowerBound, upperBound - lowerBound);
+    slice.matches = matches;
+
+    return slice;
+}
+
+@end
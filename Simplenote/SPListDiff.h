@@ -0,0 +1,53 @@
+//
+//  SPListDiff.h
+//  Simplenote
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  @class      SPListDiff
+ *  @brief      Changes turning an ordered list of unique objects, such as note IDs, into another one: objects are
+ *              matched through a single hash table, and only the ones falling out of the longest run kept in order
+ *              are reported as moves, so that table views animate as few rows as possible.
+ *              Deletions and move sources refer to the old list, insertions and move destinations to the new one.
+ */
+@interface SPListDiff<ObjectType> : NSObject
+
+/// Indexes, in the old list, of the objects missing from the new one
+///
+@property (nonatomic, strong, readonly) NSIndexSet *deletedIndexes;
+
+/// Indexes, in the new list, of the objects missing from the old one
+///
+@property (nonatomic, strong, readonly) NSIndexSet *insertedIndexes;
+
+/// Number of objects found in both lists, but out of order
+///
+@property (nonatomic, assign, readonly) NSUInteger numberOfMoves;
+
+/// Indicates if the lists differ at all
+///
+@property (nonatomic, assign, readonly) BOOL hasChanges;
+
+/// Compares two lists. Objects repeated within a list are matched once, and the extra ones deleted or inserted.
+///
+- (instancetype)initWithOldObjects:(NSArray<ObjectType> *)oldObjects newObjects:(NSArray<ObjectType> *)newObjects NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Enumerates the moves, in the order of their destinations
+///
+- (void)enumerateMovesUsingBlock:(void (NS_NOESCAPE ^)(NSUInteger fromIndex, NSUInteger toIndex))block NS_SWIFT_NAME(enumerateMoves(_:));
+
+/// Enumerates the insertions and moves as steps to take one after the other, once the deleted objects are gone, the way
+/// NSTableView expects them: both indexes refer to the list left by the previous step. Insertions come from NSNotFound.
+/// Each step takes O(log n).
+///
+- (void)enumerateStepsUsingBlock:(void (NS_NOESCAPE ^)(NSUInteger fromIndex, NSUInteger toIndex))block NS_SWIFT_NAME(enumerateSteps(_:));
+
+@end
+
+NS_ASSUME_NONNULL_END
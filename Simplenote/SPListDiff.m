@@ -0,0 +1,314 @@
+//
+//  SPListDiff.m
+//  Simplenote
+//
+
+#import "SPListDiff.h"
+
+
+
+#pragma mark ================================================================================
+#pragma mark Diff Core
+#pragma mark ================================================================================
+
+// Objects found in both lists, in the order of the new one
+typedef struct {
+    NSUInteger *oldIndexes;
+    NSUInteger *newIndexes;
+    BOOL *inOrder;
+    NSUInteger count;
+} SPListDiffMatches;
+
+// Flags the matches belonging to a longest subsequence of increasing old indexes: the rest are the moves.
+// Patience sorting: each pile keeps the match ending the shortest subsequence of its length.
+static void SPListDiffFlagMatchesInOrder(SPListDiffMatches *matches)
+{
+    NSUInteger count = matches->count;
+    if (count == 0) {
+        return;
+    }
+
+    NSUInteger *piles = malloc(count * sizeof(NSUInteger));
+    NSUInteger *previous = malloc(count * sizeof(NSUInteger));
+    NSUInteger numberOfPiles = 0;
+
+    for (NSUInteger i = 0; i < count; i++) {
+        NSUInteger oldIndex = matches->oldIndexes[i];
+        NSUInteger low = 0;
+        NSUInteger high = numberOfPiles;
+
+        while (low < high) {
+            NSUInteger middle = low + (high - low) / 2;
+            if (matches->oldIndexes[piles[middle]] < oldIndex) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+
+        previous[i] = low > 0 ? piles[low - 1] : NSNotFound;
+        piles[low] = i;
+        numberOfPiles = MAX(numberOfPiles, low + 1);
+    }
+
+    for (NSUInteger i = piles[numberOfPiles - 1]; i != NSNotFound; i = previous[i]) {
+        matches->inOrder[i] = YES;
+    }
+
+    free(piles);
+    free(previous);
+}
+
+// Fenwick tree flagging the slots taken by rows, in the order rows have on screen: the row of an object is the number of
+// slots taken before its own, found in O(log n) however many rows moved ahead of it
+typedef struct {
+    NSUInteger *counts;
+    NSUInteger size;
+} SPListDiffRowTree;
+
+static void SPListDiffRowTreeSet(SPListDiffRowTree *tree, NSUInteger slot, BOOL taken)
+{
+    for (NSUInteger i = slot + 1; i <= tree->size; i += i & (~i + 1)) {
+        tree->counts[i - 1] = taken ? tree->counts[i - 1] + 1 : tree->counts[i - 1] - 1;
+    }
+}
+
+static NSUInteger SPListDiffRowTreeRow(const SPListDiffRowTree *tree, NSUInteger slot)
+{
+    NSUInteger row = 0;
+    for (NSUInteger i = slot; i > 0; i -= i & (~i + 1)) {
+        row += tree->counts[i - 1];
+    }
+
+    return row;
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark SPListDiff
+#pragma mark ================================================================================
+
+@interface SPListDiff ()
+@property (nonatomic, strong) NSIndexSet *deletedIndexes;
+@property (nonatomic, strong) NSIndexSet *insertedIndexes;
+@property (nonatomic, assign) SPListDiffMatches matches;
+@property (nonatomic, assign) NSUInteger numberOfMoves;
+@property (nonatomic, assign) NSUInteger oldCount;
+@end
+
+@implementation SPListDiff
+
+- (instancetype)initWithOldObjects:(NSArray *)oldObjects newObjects:(NSArray *)newObjects
+{
+    self = [super init];
+    if (self) {
+        [self compareOldObjects:oldObjects newObjects:newObjects];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_matches.oldIndexes);
+    free(_matches.newIndexes);
+    free(_matches.inOrder);
+}
+
+- (BOOL)hasChanges
+{
+    return self.deletedIndexes.count > 0 || self.insertedIndexes.count > 0 || self.numberOfMoves > 0;
+}
+
+- (void)enumerateMovesUsingBlock:(void (NS_NOESCAPE ^)(NSUInteger fromIndex, NSUInteger toIndex))block
+{
+    for (NSUInteger i = 0; i < _matches.count; i++) {
+        if (!_matches.inOrder[i]) {
+            block(_matches.oldIndexes[i], _matches.newIndexes[i]);
+        }
+    }
+}
+
+- (void)enumerateStepsUsingBlock:(void (NS_NOESCAPE ^)(NSUInteger fromIndex, NSUInteger toIndex))block
+{
+    NSUInteger oldCount = self.oldCount;
+    NSUInteger newCount = _matches.count + self.insertedIndexes.count;
+    NSUInteger numberOfGaps = _matches.count - self.numberOfMoves + 1;
+
+    // Objects kept in order never move, and split both lists into the same gaps. Within a gap, the objects placed so
+    // far come first, in the order of the new list, followed by the ones yet to move, in the order of the old list:
+    // every object gets a slot for each, and the slots taken are the rows on screen.
+    NSUInteger *matchesByOldIndex = malloc(MAX(oldCount, 1) * sizeof(NSUInteger));
+    NSUInteger *waitingCounts = calloc(numberOfGaps, sizeof(NSUInteger));
+    NSUInteger *waitingSlots = calloc(numberOfGaps, sizeof(NSUInteger));
+    NSUInteger *placedSlotsByNewIndex = malloc(MAX(newCount, 1) * sizeof(NSUInteger));
+    NSUInteger *waitingSlotsByMatch = malloc(MAX(_matches.count, 1) * sizeof(NSUInteger));
+
+    for (NSUInteger i = 0; i < oldCount; i++) {
+        matchesByOldIndex[i] = NSNotFound;
+    }
+
+    for (NSUInteger i = 0; i < _matches.count; i++) {
+        matchesByOldIndex[_matches.oldIndexes[i]] = i;
+    }
+
+    NSUInteger gap = 0;
+    for (NSUInteger i = 0; i < oldCount; i++) {
+        NSUInteger oldMatch = matchesByOldIndex[i];
+        if (oldMatch == NSNotFound) {
+            continue;
+        }
+
+        if (_matches.inOrder[oldMatch]) {
+            gap++;
+        } else {
+            waitingCounts[gap]++;
+        }
+    }
+
+    NSUInteger slot = 0;
+    NSUInteger match = 0;
+    gap = 0;
+
+    for (NSUInteger newIndex = 0; newIndex < newCount; newIndex++) {
+        BOOL inOrder = ![self.insertedIndexes containsIndex:newIndex] && _matches.inOrder[match++];
+        if (inOrder) {
+            waitingSlots[gap] = slot;
+            slot += waitingCounts[gap++];
+        }
+
+        placedSlotsByNewIndex[newIndex] = slot++;
+    }
+
+    waitingSlots[gap] = slot;
+    slot += waitingCounts[gap];
+
+    SPListDiffRowTree tree = {
+        .counts = calloc(MAX(slot, 1), sizeof(NSUInteger)),
+        .size = slot,
+    };
+
+    gap = 0;
+    for (NSUInteger i = 0; i < oldCount; i++) {
+        NSUInteger oldMatch = matchesByOldIndex[i];
+        if (oldMatch == NSNotFound) {
+            continue;
+        }
+
+        if (_matches.inOrder[oldMatch]) {
+            SPListDiffRowTreeSet(&tree, placedSlotsByNewIndex[_matches.newIndexes[oldMatch]], YES);
+            gap++;
+        } else {
+            waitingSlotsByMatch[oldMatch] = waitingSlots[gap]++;
+            SPListDiffRowTreeSet(&tree, waitingSlotsByMatch[oldMatch], YES);
+        }
+    }
+
+    free(matchesByOldIndex);
+    free(waitingCounts);
+    free(waitingSlots);
+
+    // Every object not kept in order lands right after the object preceding it in the new list, which is then in place
+    // relative to the kept ones: `next` is the row following that object.
+    NSUInteger next = 0;
+    match = 0;
+
+    for (NSUInteger newIndex = 0; newIndex < newCount; newIndex++) {
+        NSUInteger placedSlot = placedSlotsByNewIndex[newIndex];
+
+        if ([self.insertedIndexes containsIndex:newIndex]) {
+            SPListDiffRowTreeSet(&tree, placedSlot, YES);
+            block(NSNotFound, next);
+            next++;
+            continue;
+        }
+
+        if (_matches.inOrder[match]) {
+            next = SPListDiffRowTreeRow(&tree, placedSlot) + 1;
+            match++;
+            continue;
+        }
+
+        NSUInteger waitingSlot = waitingSlotsByMatch[match++];
+        NSUInteger row = SPListDiffRowTreeRow(&tree, waitingSlot);
+
+        SPListDiffRowTreeSet(&tree, waitingSlot, NO);
+        SPListDiffRowTreeSet(&tree, placedSlot, YES);
+
+        if (row == next) {
+            next++;
+            continue;
+        }
+
+        if (row < next) {
+            next--;
+        }
+
+        block(row, next);
+        next++;
+    }
+
+    free(placedSlotsByNewIndex);
+    free(waitingSlotsByMatch);
+    free(tree.counts);
+}
+
+- (void)compareOldObjects:(NSArray *)oldObjects newObjects:(NSArray *)newObjects
+{
+    NSUInteger oldCount = oldObjects.count;
+    NSUInteger newCount = newObjects.count;
+
+    // Old indexes by object. Repeated objects keep their first index, and the rest are deleted.
+    CFMutableDictionaryRef oldIndexes = CFDictionaryCreateMutable(kCFAllocatorDefault, (CFIndex)oldCount, &kCFTypeDictionaryKeyCallBacks, NULL);
+    NSMutableIndexSet *deletedIndexes = [NSMutableIndexSet indexSetWithIndexesInRange:NSMakeRange(0, oldCount)];
+    NSUInteger oldIndex = 0;
+
+    for (id object in oldObjects) {
+        if (!CFDictionaryContainsKey(oldIndexes, (__bridge CFTypeRef)object)) {
+            CFDictionarySetValue(oldIndexes, (__bridge CFTypeRef)object, (const void *)oldIndex);
+        }
+        oldIndex++;
+    }
+
+    SPListDiffMatches matches = {
+        .oldIndexes = malloc(MAX(newCount, 1) * sizeof(NSUInteger)),
+        .newIndexes = malloc(MAX(newCount, 1) * sizeof(NSUInteger)),
+        .inOrder = calloc(MAX(newCount, 1), sizeof(BOOL)),
+        .count = 0,
+    };
+
+    // Each old object is matched once: repeated new objects are inserted
+    NSMutableIndexSet *insertedIndexes = [NSMutableIndexSet indexSet];
+    NSUInteger newIndex = 0;
+
+    for (id object in newObjects) {
+        const void *value = NULL;
+        if (CFDictionaryGetValueIfPresent(oldIndexes, (__bridge CFTypeRef)object, &value)) {
+            CFDictionaryRemoveValue(oldIndexes, (__bridge CFTypeRef)object);
+            matches.oldIndexes[matches.count] = (NSUInteger)value;
+            matches.newIndexes[matches.count] = newIndex;
+            matches.count++;
+            [deletedIndexes removeIndex:(NSUInteger)value];
+        } else {
+            [insertedIndexes addIndex:newIndex];
+        }
+        newIndex++;
+    }
+
+    CFRelease(oldIndexes);
+    SPListDiffFlagMatchesInOrder(&matches);
+
+    NSUInteger numberOfMoves = 0;
+    for (NSUInteger i = 0; i < matches.count; i++) {
+        numberOfMoves += matches.inOrder[i] ? 0 : 1;
+    }
+
+    _matches = matches;
+    self.oldCount = oldCount;
+    self.deletedIndexes = deletedIndexes;
+    self.insertedIndexes = insertedIndexes;
+    self.numberOfMoves = numberOfMoves;
+}
+
+@end
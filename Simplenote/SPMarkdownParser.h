@@ -17,4 +17,8 @@
 
 + (NSString *)renderHTMLFromMarkdownString:(NSString *)markdown;
 
+/// Drops the rendered pages kept in memory and on disk
+///
++ (void)removeCachedPages;
+
 @end
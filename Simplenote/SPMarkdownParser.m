@@ -8,41 +8,190 @@
 
 #import "SPMarkdownParser.h"
 #import "html.h"
+#import "cache.h"
 #import "Simplenote-Swift.h"
 
+static const unsigned int SPMarkdownExtensions = HOEDOWN_EXT_AUTOLINK |
+                                                 HOEDOWN_EXT_FENCED_CODE |
+                                                 HOEDOWN_EXT_FOOTNOTES |
+                                                 HOEDOWN_EXT_TABLES |
+                                                 HOEDOWN_EXT_SPAN |
+                                                 HOEDOWN_EXT_SANITIZE_UTF8;
+
+static const unsigned int SPMarkdownHTMLFlags = HOEDOWN_HTML_SKIP_HTML |
+                                                HOEDOWN_HTML_USE_TASK_LIST;
+
+// Bits of the cache key variant: anything besides the Markdown and the flags the page depends on
+typedef NS_OPTIONS(unsigned int, SPMarkdownVariant) {
+    SPMarkdownVariantUTF16      = 1 << 0,
+    SPMarkdownVariantDarkMode   = 1 << 1,
+    SPMarkdownVariantFullWidth  = 1 << 2,
+};
+
+// Rendered pages are kept in memory up to this size, so switching between notes in preview doesn't render them again
+static const size_t SPMarkdownCacheSize = 8 * 1024 * 1024;
+
+// ... and on disk up to this size, so previews viewed in a previous launch don't either
+static const size_t SPMarkdownCacheFileSize = 32 * 1024 * 1024;
+static NSString * const SPMarkdownCacheFileName = @"markdown-render.cache";
+
 @implementation SPMarkdownParser
 
++ (hoedown_cache *)renderCache
+{
+    static hoedown_cache *cache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = hoedown_cache_new(SPMarkdownCacheSize);
+    });
+
+    return cache;
+}
+
++ (hoedown_cache_file *)renderCacheFile
+{
+    static hoedown_cache_file *file;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSURL *cachesURL = [[[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask] firstObject];
+        NSURL *fileURL = [cachesURL URLByAppendingPathComponent:SPMarkdownCacheFileName];
+
+        // Pages embed the bundled CSS: another build starts the file over
+        NSString *version = [[NSBundle mainBundle] objectForInfoDictionaryKey:(NSString *)kCFBundleVersionKey] ?: @"";
+        NSData *versionData = [version dataUsingEncoding:NSUTF8StringEncoding];
+        hoedown_cache_key generation = hoedown_cache_key_make(versionData.bytes, versionData.length, 0, 0, 0);
+
+        file = hoedown_cache_file_open(fileURL.fileSystemRepresentation, SPMarkdownCacheFileSize, (uint32_t)generation.lo);
+    });
+
+    return file;
+}
+
 + (NSString *)renderHTMLFromMarkdownString:(NSString *)markdown
 {
-    hoedown_renderer *renderer = hoedown_html_renderer_new(
-                                                           HOEDOWN_HTML_SKIP_HTML |
-                                                           HOEDOWN_HTML_USE_TASK_LIST,
-                                                           0);
-    hoedown_document *document = hoedown_document_new(
-                                                      renderer,
-                                                      HOEDOWN_EXT_AUTOLINK |
-                                                      HOEDOWN_EXT_FENCED_CODE |
-                                                      HOEDOWN_EXT_FOOTNOTES |
-                                                      HOEDOWN_EXT_TABLES |
-                                                      HOEDOWN_EXT_SPAN ,
-                                                      16, 0, NULL, NULL);
+    BOOL isDarkMode = SPUserInterface.isDark;
+    BOOL isFullWidth = [[Options shared] editorFullWidth];
+    SPMarkdownVariant variant = (isDarkMode ? SPMarkdownVariantDarkMode : 0) | (isFullWidth ? SPMarkdownVariantFullWidth : 0);
+
+    // Hash and hand Hoedown the string's own storage when we can get at it (a CFString only exposes
+    // 8-bit storage as UTF-8 when it is ASCII), rather than transcoding a copy
+    CFStringRef markdownRef = (__bridge CFStringRef)markdown;
+    const UniChar *characters = CFStringGetCharactersPtr(markdownRef);
+    const char *utf8 = characters ? NULL : CFStringGetCStringPtr(markdownRef, kCFStringEncodingUTF8);
+    size_t length = CFStringGetLength(markdownRef);
+    NSData *markdownData = nil;
+
+    if (characters) {
+        variant |= SPMarkdownVariantUTF16;
+    } else if (!utf8) {
+        markdownData = [markdown dataUsingEncoding:NSUTF8StringEncoding];
+        utf8 = markdownData.bytes;
+        length = markdownData.length;
+    }
+
+    const uint8_t *bytes = characters ? (const uint8_t *)characters : (const uint8_t *)utf8;
+    size_t byteLength = characters ? length * sizeof(UniChar) : length;
+    hoedown_cache_key key = hoedown_cache_key_make(bytes, byteLength, SPMarkdownExtensions, SPMarkdownHTMLFlags, variant);
     hoedown_buffer *html = hoedown_buffer_new(16);
-    
-    NSData *markdownData = [markdown dataUsingEncoding:NSUTF8StringEncoding];
-    hoedown_document_render(document, html, markdownData.bytes, markdownData.length);
-    
-    NSData *htmlData = [NSData dataWithBytes:html->data length:html->size];
-    
+
+    if (!hoedown_cache_get(self.renderCache, key, html) && ![self loadCachedPageForKey:key into:html]) {
+        hoedown_renderer *renderer = hoedown_html_renderer_new(SPMarkdownHTMLFlags, 0);
+        hoedown_html_renderer_state *state = renderer->opaque;
+        state->doc_template = [self templateForDarkMode:isDarkMode fullWidth:isFullWidth];
+        hoedown_document *document = hoedown_document_new(renderer, SPMarkdownExtensions, 16, 0, NULL, NULL);
+
+        // Long notes are split between cores, as our flags leave out header ids and SmartyPants: Hoedown only does
+        // so for renderers flagged as concurrent, and lends the chunks to a pool of threads kept across renders
+        hoedown_document_set_threads(document, (unsigned int)NSProcessInfo.processInfo.activeProcessorCount);
+
+        // The buffer grows sixteen bytes at a time: make room for the page and about as much HTML as Markdown upfront
+        hoedown_buffer_grow(html, state->doc_template->size + length);
+
+        if (characters) {
+            hoedown_document_render_utf16(document, html, characters, length);
+        } else {
+            hoedown_document_render(document, html, (const uint8_t *)utf8, length);
+        }
+
+        hoedown_document_free(document);
+        hoedown_html_renderer_free(renderer);
+
+        hoedown_cache_put(self.renderCache, key, html->data, html->size);
+        [self storeCachedPage:html forKey:key];
+    }
+
+    NSString *htmlString = [[NSString alloc] initWithBytes:html->data length:html->size encoding:NSUTF8StringEncoding];
     hoedown_buffer_free(html);
-    hoedown_document_free(document);
-    hoedown_html_renderer_free(renderer);
-    
-    NSString *htmlString = [[NSString alloc] initWithData:htmlData encoding:NSUTF8StringEncoding];
 
-    return [[[self htmlHeader] stringByAppendingString:htmlString] stringByAppendingString:[self htmlFooter]];
+    return htmlString;
+}
+
++ (void)removeCachedPages
+{
+    hoedown_cache_clear(self.renderCache);
+
+    hoedown_cache_file *file = self.renderCacheFile;
+    if (!file) {
+        return;
+    }
+
+    @synchronized (self) {
+        hoedown_cache_file_clear(file);
+    }
+}
+
++ (BOOL)loadCachedPageForKey:(hoedown_cache_key)key into:(hoedown_buffer *)html
+{
+    hoedown_cache_file *file = self.renderCacheFile;
+    if (!file) {
+        return NO;
+    }
+
+    // Mapped pages only remain valid until the next write, which may come from another thread
+    @synchronized (self) {
+        const uint8_t *page;
+        size_t pageSize;
+        if (!hoedown_cache_file_get(file, key, &page, &pageSize)) {
+            return NO;
+        }
+
+        hoedown_buffer_put(html, page, pageSize);
+    }
+
+    hoedown_cache_put(self.renderCache, key, html->data, html->size);
+    return YES;
+}
+
++ (void)storeCachedPage:(hoedown_buffer *)html forKey:(hoedown_cache_key)key
+{
+    hoedown_cache_file *file = self.renderCacheFile;
+    if (!file) {
+        return;
+    }
+
+    @synchronized (self) {
+        hoedown_cache_file_put(file, key, html->data, html->size);
+    }
 }
 
-+ (NSString *)htmlHeader
++ (hoedown_html_template *)templateForDarkMode:(BOOL)isDarkMode fullWidth:(BOOL)isFullWidth
+{
+    // Compiled once per variant, and kept for as long as the app runs
+    static hoedown_html_template *templates[4];
+    NSUInteger index = (isDarkMode ? 2 : 0) + (isFullWidth ? 1 : 0);
+
+    @synchronized (self) {
+        if (!templates[index]) {
+            NSData *header = [[self htmlHeaderForDarkMode:isDarkMode fullWidth:isFullWidth] dataUsingEncoding:NSUTF8StringEncoding];
+            NSData *footer = [[self htmlFooter] dataUsingEncoding:NSUTF8StringEncoding];
+            templates[index] = hoedown_html_template_new(header.bytes, header.length, footer.bytes, footer.length);
+        }
+
+        return templates[index];
+    }
+}
+
++ (NSString *)htmlHeaderForDarkMode:(BOOL)isDarkMode fullWidth:(BOOL)isFullWidth
 {
     NSString *headerStart =
         @"<html><head>"
@@ -51,12 +200,10 @@
             "<style media=\"screen\" type=\"text/css\">\n";
     
     // Limit the editor width if the full width setting is not enabled
-    if (![[Options shared] editorFullWidth]) {
+    if (!isFullWidth) {
         headerStart = [headerStart stringByAppendingString:@".note-detail-markdown { max-width:750px;margin:0 auto; }"];
     }
 
-    BOOL isDarkMode = SPUserInterface.isDark;
-    
     // set main background and font color
     NSString *colorCSS = @"html { background-color: transparent; color: #%@ }\n";
     NSString *textHexColor = isDarkMode ? @"FFFFFF" : @"000000";
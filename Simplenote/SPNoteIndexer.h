@@ -0,0 +1,89 @@
+//
+//  SPNoteIndexer.h
+//  Simplenote
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreData/CoreData.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  @class      SPIndexedNote
+ *  @brief      Values of a note, read on its context's queue, that indexes can work with anywhere else.
+ */
+@interface SPIndexedNote : NSObject
+
+@property (nonatomic, copy, readonly) NSString *key;
+@property (nonatomic, copy, readonly, nullable) NSString *content;
+@property (nonatomic, copy, readonly, nullable) NSArray<NSString *> *tags;
+@property (nonatomic, assign, readonly) BOOL deleted;
+
+- (instancetype)initWithKey:(NSString *)key
+                    content:(nullable NSString *)content
+                       tags:(nullable NSArray<NSString *> *)tags
+                    deleted:(BOOL)deleted NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+
+/**
+ *  @protocol   SPNoteIndex
+ *  @brief      In-memory index over the notes, fed by an indexer.
+ */
+@protocol SPNoteIndex <NSObject>
+
+/// Indicates if every note has been indexed. Indexes added to an indexer aren't, until it has read the store.
+///
+@property (atomic, assign, getter=isReady) BOOL ready;
+
+/// Indexes a note, replacing whatever was indexed for its key
+///
+- (void)indexNote:(SPIndexedNote *)note;
+
+/// Drops a note from the index
+///
+- (void)removeNoteWithKey:(NSString *)key;
+
+/// Drops every note from the index
+///
+- (void)removeAllNotes;
+
+@end
+
+
+/**
+ *  @class      SPNoteIndexer
+ *  @brief      Feeds the note indexes: reads every note in the store once, then follows the changes saved to it, all on
+ *              a serial queue of its own rather than the one saving.
+ *              Predicates built over the indexes are block predicates, which the app's XML store evaluates in memory
+ *              like every other one.
+ */
+@interface SPNoteIndexer : NSObject
+
+/// Indexer of the app's store, once `startIndexingNotesInContext:` has been called
+///
+@property (class, nonatomic, readonly) SPNoteIndexer *sharedIndexer NS_SWIFT_NAME(shared);
+
+/// Feeds an index from now on. It isn't ready until the store has been read.
+///
+- (void)addIndex:(id<SPNoteIndex>)index NS_SWIFT_NAME(add(_:));
+
+/// Reads the notes in the context's store in the background, then follows the changes saved to it
+///
+- (void)startIndexingNotesInContext:(NSManagedObjectContext *)context;
+
+/// Drops every note from the indexes
+///
+- (void)removeAllNotes;
+
+/// Returns a predicate letting through the notes indexes can't tell about, that is, the ones with unsaved changes or
+/// without a key yet, and asking the test about the rest
+///
++ (NSPredicate *)predicateForNotesPassingTest:(BOOL (^)(NSString *key))test;
+
+@end
+
+NS_ASSUME_NONNULL_END
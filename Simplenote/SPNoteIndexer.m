@@ -0,0 +1,301 @@
+//
+//  SPNoteIndexer.m
+//  Simplenote
+//
+
+#import "SPNoteIndexer.h"
+#import "Note.h"
+#import "SPJSONStringArray.h"
+
+
+
+#pragma mark ================================================================================
+#pragma mark Constants
+#pragma mark ================================================================================
+
+static NSString * const SPNoteIndexerNoteEntityName = @"Note";
+static const char * const SPNoteIndexerQueueLabel = "com.automattic.simplenote.noteindexer";
+
+
+
+#pragma mark ================================================================================
+#pragma mark Parsing
+#pragma mark ================================================================================
+
+static NSArray<NSString *> *SPNoteIndexerTagsFromJSON(NSString *json)
+{
+    if (![json isKindOfClass:[NSString class]]) {
+        return nil;
+    }
+
+    NSArray<NSString *> *strings = [SPJSONStringArray arrayFromJSONString:json];
+    if (strings) {
+        return strings;
+    }
+
+    NSData *data = [json dataUsingEncoding:NSUTF8StringEncoding];
+    id tags = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:nil] : nil;
+
+    return [tags isKindOfClass:[NSArray class]] ? tags : nil;
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark SPIndexedNote
+#pragma mark ================================================================================
+
+@implementation SPIndexedNote
+
+- (instancetype)initWithKey:(NSString *)key content:(NSString *)content tags:(NSArray<NSString *> *)tags deleted:(BOOL)deleted
+{
+    self = [super init];
+    if (self) {
+        _key = [key copy];
+        _content = [content isKindOfClass:[NSString class]] ? [content copy] : nil;
+        _tags = [tags isKindOfClass:[NSArray class]] ? [tags copy] : nil;
+        _deleted = deleted;
+    }
+
+    return self;
+}
+
+@end
+
+
+
+#pragma mark Private
+#pragma mark ================================================================================
+
+@interface SPNoteIndexer ()
+
+@property (nonatomic, strong) dispatch_queue_t                                          queue;
+@property (nonatomic, copy) NSArray<id<SPNoteIndex>>                                    *indexes;
+@property (nonatomic, strong) NSMutableDictionary<NSManagedObjectID *, NSString *>      *keysByObjectID;
+@property (nonatomic, weak, nullable) NSPersistentStoreCoordinator                      *coordinator;
+
+@end
+
+
+
+#pragma mark ================================================================================
+#pragma mark SPNoteIndexer
+#pragma mark ================================================================================
+
+@implementation SPNoteIndexer
+
++ (SPNoteIndexer *)sharedIndexer
+{
+    static SPNoteIndexer *indexer;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        indexer = [SPNoteIndexer new];
+    });
+
+    return indexer;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _queue = dispatch_queue_create(SPNoteIndexerQueueLabel, DISPATCH_QUEUE_SERIAL);
+        _indexes = @[];
+        _keysByObjectID = [NSMutableDictionary dictionary];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+- (void)addIndex:(id<SPNoteIndex>)index
+{
+    @synchronized (self) {
+        index.ready = NO;
+        self.indexes = [self.indexes arrayByAddingObject:index];
+    }
+}
+
+- (NSArray<id<SPNoteIndex>> *)currentIndexes
+{
+    @synchronized (self) {
+        return self.indexes;
+    }
+}
+
+
+#pragma mark - Indexing
+
+- (void)startIndexingNotesInContext:(NSManagedObjectContext *)context
+{
+    NSPersistentStoreCoordinator *coordinator = context.persistentStoreCoordinator;
+
+    @synchronized (self) {
+        if (!coordinator || self.coordinator) {
+            return;
+        }
+
+        self.coordinator = coordinator;
+    }
+
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(contextDidSave:)
+                                                 name:NSManagedObjectContextDidSaveNotification
+                                               object:nil];
+
+    NSManagedObjectContext *reader = [[NSManagedObjectContext alloc] initWithConcurrencyType:NSPrivateQueueConcurrencyType];
+    reader.persistentStoreCoordinator = coordinator;
+    reader.undoManager = nil;
+
+    // Saves are indexed on the same queue, once the store has been read: the ones it already holds are merely indexed
+    // twice, and there's no telling the read apart from later changes.
+    dispatch_async(self.queue, ^{
+        __block NSArray<NSDictionary *> *rows = nil;
+
+        [reader performBlockAndWait:^{
+            NSExpressionDescription *objectID = [NSExpressionDescription new];
+            objectID.name = @"objectID";
+            objectID.expression = [NSExpression expressionForEvaluatedObject];
+            objectID.expressionResultType = NSObjectIDAttributeType;
+
+            // Plain values rather than Notes, which would build their previews as they're fetched
+            NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:SPNoteIndexerNoteEntityName];
+            request.resultType = NSDictionaryResultType;
+            request.propertiesToFetch = @[objectID, @"simperiumKey", @"content", @"tags", @"deleted"];
+
+            rows = [reader executeFetchRequest:request error:nil];
+        }];
+
+        for (NSDictionary *row in rows) {
+            @autoreleasepool {
+                NSString *key = row[@"simperiumKey"];
+                if (![key isKindOfClass:[NSString class]]) {
+                    continue;
+                }
+
+                SPIndexedNote *note = [[SPIndexedNote alloc] initWithKey:key
+                                                                 content:row[@"content"]
+                                                                    tags:SPNoteIndexerTagsFromJSON(row[@"tags"])
+                                                                 deleted:[row[@"deleted"] boolValue]];
+
+                [self indexNote:note objectID:row[@"objectID"]];
+            }
+        }
+
+        for (id<SPNoteIndex> index in self.currentIndexes) {
+            index.ready = YES;
+        }
+    });
+}
+
+- (void)indexNote:(SPIndexedNote *)note objectID:(NSManagedObjectID *)objectID
+{
+    self.keysByObjectID[objectID] = note.key;
+
+    for (id<SPNoteIndex> index in self.currentIndexes) {
+        [index indexNote:note];
+    }
+}
+
+- (void)removeNoteWithObjectID:(NSManagedObjectID *)objectID
+{
+    NSString *key = self.keysByObjectID[objectID];
+    if (!key) {
+        return;
+    }
+
+    [self.keysByObjectID removeObjectForKey:objectID];
+
+    for (id<SPNoteIndex> index in self.currentIndexes) {
+        [index removeNoteWithKey:key];
+    }
+}
+
+- (void)removeAllNotes
+{
+    dispatch_async(self.queue, ^{
+        [self.keysByObjectID removeAllObjects];
+
+        for (id<SPNoteIndex> index in self.currentIndexes) {
+            [index removeAllNotes];
+        }
+    });
+}
+
+
+#pragma mark - Store Changes
+
+- (void)contextDidSave:(NSNotification *)notification
+{
+    NSManagedObjectContext *context = notification.object;
+    if (context.persistentStoreCoordinator != self.coordinator) {
+        return;
+    }
+
+    // The notification is posted on the context's queue, often the main one: notes are read there, and indexed on ours
+    NSMutableArray<SPIndexedNote *> *savedNotes = [NSMutableArray array];
+    NSMutableArray<NSManagedObjectID *> *savedObjectIDs = [NSMutableArray array];
+
+    for (NSString *changeKey in @[NSInsertedObjectsKey, NSUpdatedObjectsKey]) {
+        for (NSManagedObject *object in notification.userInfo[changeKey]) {
+            if (![object isKindOfClass:[Note class]]) {
+                continue;
+            }
+
+            Note *note = (Note *)object;
+            if (!note.simperiumKey) {
+                continue;
+            }
+
+            SPIndexedNote *indexedNote = [[SPIndexedNote alloc] initWithKey:note.simperiumKey
+                                                                    content:note.content
+                                                                       tags:note.tagsArray
+                                                                    deleted:note.deleted];
+
+            [savedNotes addObject:indexedNote];
+            [savedObjectIDs addObject:note.objectID];
+        }
+    }
+
+    NSMutableArray<NSManagedObjectID *> *deletedObjectIDs = [NSMutableArray array];
+    for (NSManagedObject *object in notification.userInfo[NSDeletedObjectsKey]) {
+        if ([object isKindOfClass:[Note class]]) {
+            [deletedObjectIDs addObject:object.objectID];
+        }
+    }
+
+    if (savedNotes.count == 0 && deletedObjectIDs.count == 0) {
+        return;
+    }
+
+    dispatch_async(self.queue, ^{
+        [savedNotes enumerateObjectsUsingBlock:^(SPIndexedNote *note, NSUInteger idx, BOOL *stop) {
+            [self indexNote:note objectID:savedObjectIDs[idx]];
+        }];
+
+        for (NSManagedObjectID *objectID in deletedObjectIDs) {
+            [self removeNoteWithObjectID:objectID];
+        }
+    });
+}
+
+
+#pragma mark - Predicates
+
++ (NSPredicate *)predicateForNotesPassingTest:(BOOL (^)(NSString *key))test
+{
+    return [NSPredicate predicateWithBlock:^BOOL(Note *note, NSDictionary *bindings) {
+        NSString *key = note.simperiumKey;
+        if (!key || note.hasChanges) {
+            return YES;
+        }
+
+        return test(key);
+    }];
+}
+
+@end
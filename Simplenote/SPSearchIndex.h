@@ -0,0 +1,47 @@
+//
+//  SPSearchIndex.h
+//  Simplenote
+//
+
+#import <Foundation/Foundation.h>
+#import "SPNoteIndexer.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  @class      SPSearchIndex
+ *  @brief      In-memory inverted index over the words, trigrams and tags of the notes, folded like a [cd]
+ *              predicate. It narrows a search down to the notes which may match, ahead of the search predicate.
+ */
+@interface SPSearchIndex : NSObject <SPNoteIndex>
+
+/// Index of the notes in the app's store, once added to the shared indexer
+///
+@property (class, nonatomic, readonly) SPSearchIndex *sharedIndex NS_SWIFT_NAME(shared);
+
+/// Indicates if every note has been indexed: until then, searches aren't narrowed down
+///
+@property (atomic, assign, getter=isReady) BOOL ready;
+
+/// Number of indexed notes
+///
+@property (nonatomic, readonly) NSUInteger count;
+
+/// Indexes the content and tags of a note, replacing whatever was indexed for its key
+///
+- (void)indexNoteWithKey:(NSString *)key content:(nullable NSString *)content tags:(nullable NSArray<NSString *> *)tags;
+
+/// Returns the keys of the notes containing every keyword, and where every tag appears within a tag, best matches
+/// first. Keywords of three bytes or more are found anywhere, across words and punctuation alike, while shorter ones
+/// only need their words to appear within a word.
+///
+- (NSArray<NSString *> *)keysForNotesMatchingKeywords:(NSArray<NSString *> *)keywords tags:(NSArray<NSString *> *)tags;
+
+/// Returns a predicate letting through the notes which may match the keywords and tags, along with the notes the index
+/// hasn't caught up with, or nil when it can't narrow the search down. The search predicate must still follow it.
+///
+- (nullable NSPredicate *)predicateForNotesMatchingKeywords:(NSArray<NSString *> *)keywords tags:(NSArray<NSString *> *)tags;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,1194 @@
+//
+//  SPSearchIndex.m
+//  Simplenote
+//
+
+#import "SPSearchIndex.h"
+
+#include <math.h>
+#include <string.h>
+
+
+
+#pragma mark ================================================================================
+#pragma mark Constants
+#pragma mark ================================================================================
+
+// Query words of a single ASCII character appear in about every note, and don't narrow anything down
+static const size_t SPSearchIndexMinimumQueryWordLength = 2;
+
+// Keywords this long, in bytes, are looked up by trigrams, shorter ones by words
+static const size_t SPSearchIndexMinimumKeywordLength = 3;
+
+// Dropped and replaced notes leave their postings behind, until they outnumber the live ones
+static const uint32_t SPSearchIndexMinimumCompaction = 1024;
+
+
+
+#pragma mark ================================================================================
+#pragma mark Byte Buffers
+#pragma mark ================================================================================
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} SPSearchBytes;
+
+static void SPSearchBytesReserve(SPSearchBytes *bytes, size_t extra)
+{
+    if (bytes->size + extra <= bytes->capacity) {
+        return;
+    }
+
+    size_t capacity = bytes->capacity ? bytes->capacity : 16;
+    while (capacity < bytes->size + extra) {
+        capacity *= 2;
+    }
+
+    bytes->data = realloc(bytes->data, capacity);
+    bytes->capacity = capacity;
+}
+
+static void SPSearchBytesAppend(SPSearchBytes *bytes, const void *data, size_t size)
+{
+    SPSearchBytesReserve(bytes, size);
+    if (size) {
+        memcpy(bytes->data + bytes->size, data, size);
+    }
+    bytes->size += size;
+}
+
+static void SPSearchBytesAppendVarint(SPSearchBytes *bytes, uint32_t value)
+{
+    SPSearchBytesReserve(bytes, 5);
+    while (value >= 0x80) {
+        bytes->data[bytes->size++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    bytes->data[bytes->size++] = (uint8_t)value;
+}
+
+static void SPSearchBytesAppendScalar(SPSearchBytes *bytes, uint32_t scalar)
+{
+    uint8_t utf8[4];
+    size_t length;
+
+    if (scalar < 0x80) {
+        utf8[0] = (uint8_t)scalar;
+        length = 1;
+    } else if (scalar < 0x800) {
+        utf8[0] = (uint8_t)(0xC0 | (scalar >> 6));
+        utf8[1] = (uint8_t)(0x80 | (scalar & 0x3F));
+        length = 2;
+    } else if (scalar < 0x10000) {
+        utf8[0] = (uint8_t)(0xE0 | (scalar >> 12));
+        utf8[1] = (uint8_t)(0x80 | ((scalar >> 6) & 0x3F));
+        utf8[2] = (uint8_t)(0x80 | (scalar & 0x3F));
+        length = 3;
+    } else {
+        utf8[0] = (uint8_t)(0xF0 | (scalar >> 18));
+        utf8[1] = (uint8_t)(0x80 | ((scalar >> 12) & 0x3F));
+        utf8[2] = (uint8_t)(0x80 | ((scalar >> 6) & 0x3F));
+        utf8[3] = (uint8_t)(0x80 | (scalar & 0x3F));
+        length = 4;
+    }
+
+    SPSearchBytesAppend(bytes, utf8, length);
+}
+
+static void SPSearchBytesFree(SPSearchBytes *bytes)
+{
+    free(bytes->data);
+    memset(bytes, 0, sizeof(SPSearchBytes));
+}
+
+static const uint8_t *SPSearchReadVarint(const uint8_t *bytes, uint32_t *value)
+{
+    uint32_t result = 0;
+    int shift = 0;
+
+    while (*bytes & 0x80) {
+        result |= (uint32_t)(*bytes++ & 0x7F) << shift;
+        shift += 7;
+    }
+
+    *value = result | ((uint32_t)*bytes++ << shift);
+    return bytes;
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark Index Core
+#pragma mark ================================================================================
+
+// Words are kept back to back in an arena, each followed by a NUL, so that a single pass finds every word containing
+// another. Postings list the documents containing a word, or a trigram, as ordinal delta varints: documents are only
+// ever appended, and indexing a note again drops its document and appends a new one.
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+    uint32_t documents;         // Live documents containing the word
+    uint32_t next;              // Ordinal following the last posting
+    SPSearchBytes postings;     // (ordinal delta, frequency) pairs
+} SPSearchTerm;
+
+// Trigrams are any three consecutive bytes of the folded text: across words, spaces and punctuation alike
+typedef struct {
+    uint32_t gram;
+    uint32_t next;
+    SPSearchBytes postings;
+} SPSearchGram;
+
+typedef struct {
+    CFStringRef key;            // NULL once the document has been dropped
+    SPSearchBytes terms;        // (term delta, frequency) varints, in ascending term order
+    SPSearchBytes text;         // Folded text, to verify trigram matches against
+    SPSearchBytes tags;         // Folded tags, each followed by a NUL
+} SPSearchDocument;
+
+typedef struct {
+    SPSearchTerm *terms;
+    uint32_t termCount;
+    uint32_t termCapacity;
+    uint32_t *slots;            // Hash table of term ids, plus one
+    uint32_t slotMask;
+    SPSearchBytes arena;
+    SPSearchGram *grams;
+    uint32_t gramCount;
+    uint32_t gramCapacity;
+    uint32_t *gramSlots;        // Hash table of gram ids, plus one
+    uint32_t gramSlotMask;
+    SPSearchDocument *documents;
+    uint32_t documentCount;
+    uint32_t documentCapacity;
+    uint32_t liveCount;
+} SPSearchCore;
+
+// Folded words, keywords and tags of a search
+typedef struct {
+    SPSearchBytes keywords;     // Keywords long enough to have trigrams, each followed by a NUL
+    SPSearchBytes words;        // Words of the shorter keywords
+    SPSearchBytes rankedWords;  // Words of every keyword, to rank the matches by
+    SPSearchBytes tags;
+} SPSearchCriteria;
+
+// Walks a list of NUL terminated strings
+static const uint8_t *SPSearchNextString(const SPSearchBytes *list, size_t *offset, size_t *length)
+{
+    if (*offset >= list->size) {
+        return NULL;
+    }
+
+    const uint8_t *string = list->data + *offset;
+    *length = strlen((const char *)string);
+    *offset += *length + 1;
+
+    return string;
+}
+
+static uint32_t SPSearchHash(const uint8_t *data, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static uint32_t SPSearchGramHash(uint32_t gram)
+{
+    return (uint32_t)(((uint64_t)gram * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+static void SPSearchCoreRehash(SPSearchCore *core, uint32_t slotCount)
+{
+    free(core->slots);
+    core->slots = calloc(slotCount, sizeof(uint32_t));
+    core->slotMask = slotCount - 1;
+
+    for (uint32_t termID = 0; termID < core->termCount; termID++) {
+        const SPSearchTerm *term = &core->terms[termID];
+        uint32_t slot = SPSearchHash(core->arena.data + term->offset, term->length) & core->slotMask;
+        while (core->slots[slot]) {
+            slot = (slot + 1) & core->slotMask;
+        }
+        core->slots[slot] = termID + 1;
+    }
+}
+
+static void SPSearchCoreRehashGrams(SPSearchCore *core, uint32_t slotCount)
+{
+    free(core->gramSlots);
+    core->gramSlots = calloc(slotCount, sizeof(uint32_t));
+    core->gramSlotMask = slotCount - 1;
+
+    for (uint32_t gramID = 0; gramID < core->gramCount; gramID++) {
+        uint32_t slot = SPSearchGramHash(core->grams[gramID].gram) & core->gramSlotMask;
+        while (core->gramSlots[slot]) {
+            slot = (slot + 1) & core->gramSlotMask;
+        }
+        core->gramSlots[slot] = gramID + 1;
+    }
+}
+
+// Returns the id of a word, adding it when needed
+static uint32_t SPSearchCoreTermID(SPSearchCore *core, const uint8_t *word, uint32_t length)
+{
+    if (!core->slots) {
+        SPSearchCoreRehash(core, 1024);
+    }
+
+    uint32_t slot = SPSearchHash(word, length) & core->slotMask;
+    for (; core->slots[slot]; slot = (slot + 1) & core->slotMask) {
+        uint32_t termID = core->slots[slot] - 1;
+        const SPSearchTerm *term = &core->terms[termID];
+        if (term->length == length && memcmp(core->arena.data + term->offset, word, length) == 0) {
+            return termID;
+        }
+    }
+
+    if (core->termCount == core->termCapacity) {
+        core->termCapacity = core->termCapacity ? core->termCapacity * 2 : 1024;
+        core->terms = realloc(core->terms, core->termCapacity * sizeof(SPSearchTerm));
+    }
+
+    uint32_t termID = core->termCount++;
+    SPSearchTerm *term = &core->terms[termID];
+    memset(term, 0, sizeof(SPSearchTerm));
+    term->offset = (uint32_t)core->arena.size;
+    term->length = length;
+
+    SPSearchBytesAppend(&core->arena, word, length);
+    SPSearchBytesAppend(&core->arena, "", 1);
+    core->slots[slot] = termID + 1;
+
+    // Keep the table at most half full
+    if (core->termCount * 2 > core->slotMask + 1) {
+        SPSearchCoreRehash(core, (core->slotMask + 1) * 2);
+    }
+
+    return termID;
+}
+
+// Returns the id of a trigram, adding it when asked to, or UINT32_MAX
+static uint32_t SPSearchCoreGramID(SPSearchCore *core, uint32_t gram, BOOL create)
+{
+    if (!core->gramSlots) {
+        if (!create) {
+            return UINT32_MAX;
+        }
+        SPSearchCoreRehashGrams(core, 4096);
+    }
+
+    uint32_t slot = SPSearchGramHash(gram) & core->gramSlotMask;
+    for (; core->gramSlots[slot]; slot = (slot + 1) & core->gramSlotMask) {
+        uint32_t gramID = core->gramSlots[slot] - 1;
+        if (core->grams[gramID].gram == gram) {
+            return gramID;
+        }
+    }
+
+    if (!create) {
+        return UINT32_MAX;
+    }
+
+    if (core->gramCount == core->gramCapacity) {
+        core->gramCapacity = core->gramCapacity ? core->gramCapacity * 2 : 4096;
+        core->grams = realloc(core->grams, core->gramCapacity * sizeof(SPSearchGram));
+    }
+
+    uint32_t gramID = core->gramCount++;
+    memset(&core->grams[gramID], 0, sizeof(SPSearchGram));
+    core->grams[gramID].gram = gram;
+    core->gramSlots[slot] = gramID + 1;
+
+    if (core->gramCount * 2 > core->gramSlotMask + 1) {
+        SPSearchCoreRehashGrams(core, (core->gramSlotMask + 1) * 2);
+    }
+
+    return gramID;
+}
+
+// Returns the id of the word starting at or containing an arena offset
+static uint32_t SPSearchCoreTermAtOffset(const SPSearchCore *core, size_t offset)
+{
+    uint32_t low = 0;
+    uint32_t high = core->termCount - 1;
+
+    while (low < high) {
+        uint32_t middle = low + (high - low + 1) / 2;
+        if (core->terms[middle].offset <= offset) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    return low;
+}
+
+static int SPSearchCompareValues(const void *lhs, const void *rhs)
+{
+    uint32_t left = *(const uint32_t *)lhs;
+    uint32_t right = *(const uint32_t *)rhs;
+
+    return left < right ? -1 : left > right;
+}
+
+// Returns the distinct trigrams of a text, in ascending order
+static uint32_t *SPSearchCreateGrams(const uint8_t *text, size_t length, uint32_t *count)
+{
+    *count = 0;
+    if (length < 3) {
+        return NULL;
+    }
+
+    uint32_t *grams = malloc((length - 2) * sizeof(uint32_t));
+    for (size_t i = 0; i + 2 < length; i++) {
+        grams[i] = (uint32_t)text[i] << 16 | (uint32_t)text[i + 1] << 8 | text[i + 2];
+    }
+
+    qsort(grams, length - 2, sizeof(uint32_t), SPSearchCompareValues);
+
+    uint32_t distinct = 0;
+    for (size_t i = 0; i < length - 2; i++) {
+        if (distinct == 0 || grams[distinct - 1] != grams[i]) {
+            grams[distinct++] = grams[i];
+        }
+    }
+
+    *count = distinct;
+    return grams;
+}
+
+// Appends a document made of NUL terminated words and its folded text, and returns its ordinal
+static uint32_t SPSearchCoreAddDocument(SPSearchCore *core, CFStringRef key, const SPSearchBytes *words, const SPSearchBytes *text, const SPSearchBytes *tags)
+{
+    size_t count = 0;
+    size_t capacity = 64;
+    uint32_t *termIDs = malloc(capacity * sizeof(uint32_t));
+    size_t offset = 0;
+    size_t length;
+    const uint8_t *word;
+
+    while ((word = SPSearchNextString(words, &offset, &length))) {
+        if (count == capacity) {
+            capacity *= 2;
+            termIDs = realloc(termIDs, capacity * sizeof(uint32_t));
+        }
+
+        termIDs[count++] = SPSearchCoreTermID(core, word, (uint32_t)length);
+    }
+
+    qsort(termIDs, count, sizeof(uint32_t), SPSearchCompareValues);
+
+    if (core->documentCount == core->documentCapacity) {
+        core->documentCapacity = core->documentCapacity ? core->documentCapacity * 2 : 256;
+        core->documents = realloc(core->documents, core->documentCapacity * sizeof(SPSearchDocument));
+    }
+
+    uint32_t ordinal = core->documentCount++;
+    SPSearchDocument *document = &core->documents[ordinal];
+    memset(document, 0, sizeof(SPSearchDocument));
+    document->key = CFRetain(key);
+    SPSearchBytesAppend(&document->text, text->data, text->size);
+    SPSearchBytesAppend(&document->tags, tags->data, tags->size);
+
+    uint32_t previousID = 0;
+    for (size_t i = 0; i < count; ) {
+        size_t j = i;
+        while (j < count && termIDs[j] == termIDs[i]) {
+            j++;
+        }
+
+        uint32_t termID = termIDs[i];
+        uint32_t frequency = (uint32_t)(j - i);
+        SPSearchTerm *term = &core->terms[termID];
+
+        SPSearchBytesAppendVarint(&term->postings, ordinal - term->next);
+        SPSearchBytesAppendVarint(&term->postings, frequency);
+        term->next = ordinal + 1;
+        term->documents++;
+
+        SPSearchBytesAppendVarint(&document->terms, termID - previousID);
+        SPSearchBytesAppendVarint(&document->terms, frequency);
+        previousID = termID;
+        i = j;
+    }
+
+    free(termIDs);
+
+    uint32_t gramCount;
+    uint32_t *grams = SPSearchCreateGrams(text->data, text->size, &gramCount);
+    for (uint32_t i = 0; i < gramCount; i++) {
+        uint32_t gramID = SPSearchCoreGramID(core, grams[i], YES);
+        SPSearchGram *gram = &core->grams[gramID];
+        SPSearchBytesAppendVarint(&gram->postings, ordinal - gram->next);
+        gram->next = ordinal + 1;
+    }
+
+    free(grams);
+    core->liveCount++;
+
+    return ordinal;
+}
+
+static void SPSearchCoreRemoveDocument(SPSearchCore *core, uint32_t ordinal)
+{
+    SPSearchDocument *document = &core->documents[ordinal];
+    if (!document->key) {
+        return;
+    }
+
+    const uint8_t *bytes = document->terms.data;
+    const uint8_t *end = bytes + document->terms.size;
+    uint32_t termID = 0;
+
+    while (bytes < end) {
+        uint32_t delta, frequency;
+        bytes = SPSearchReadVarint(bytes, &delta);
+        bytes = SPSearchReadVarint(bytes, &frequency);
+        termID += delta;
+        core->terms[termID].documents--;
+    }
+
+    CFRelease(document->key);
+    document->key = NULL;
+    SPSearchBytesFree(&document->terms);
+    SPSearchBytesFree(&document->text);
+    SPSearchBytesFree(&document->tags);
+    core->liveCount--;
+}
+
+static void SPSearchCoreFree(SPSearchCore *core)
+{
+    for (uint32_t ordinal = 0; ordinal < core->documentCount; ordinal++) {
+        SPSearchDocument *document = &core->documents[ordinal];
+        if (document->key) {
+            CFRelease(document->key);
+        }
+        SPSearchBytesFree(&document->terms);
+        SPSearchBytesFree(&document->text);
+        SPSearchBytesFree(&document->tags);
+    }
+
+    for (uint32_t termID = 0; termID < core->termCount; termID++) {
+        SPSearchBytesFree(&core->terms[termID].postings);
+    }
+
+    for (uint32_t gramID = 0; gramID < core->gramCount; gramID++) {
+        SPSearchBytesFree(&core->grams[gramID].postings);
+    }
+
+    free(core->documents);
+    free(core->terms);
+    free(core->slots);
+    free(core->grams);
+    free(core->gramSlots);
+    SPSearchBytesFree(&core->arena);
+    memset(core, 0, sizeof(SPSearchCore));
+}
+
+// Rebuilds the index out of its live documents, dropping stale postings and words found nowhere anymore
+static void SPSearchCoreCompact(SPSearchCore *core)
+{
+    SPSearchCore compacted = { 0 };
+    SPSearchBytes words = { 0 };
+
+    for (uint32_t ordinal = 0; ordinal < core->documentCount; ordinal++) {
+        const SPSearchDocument *document = &core->documents[ordinal];
+        if (!document->key) {
+            continue;
+        }
+
+        const uint8_t *bytes = document->terms.data;
+        const uint8_t *end = bytes + document->terms.size;
+        uint32_t termID = 0;
+        words.size = 0;
+
+        while (bytes < end) {
+            uint32_t delta, frequency;
+            bytes = SPSearchReadVarint(bytes, &delta);
+            bytes = SPSearchReadVarint(bytes, &frequency);
+            termID += delta;
+
+            const SPSearchTerm *term = &core->terms[termID];
+            for (uint32_t i = 0; i < frequency; i++) {
+                SPSearchBytesAppend(&words, core->arena.data + term->offset, term->length + 1);
+            }
+        }
+
+        SPSearchCoreAddDocument(&compacted, document->key, &words, &document->text, &document->tags);
+    }
+
+    SPSearchBytesFree(&words);
+    SPSearchCoreFree(core);
+    *core = compacted;
+}
+
+// Calls back with every word containing another one, and whether it is that very word.
+// Words never contain a NUL, so a match can't straddle two of them.
+static void SPSearchCoreEnumerateTerms(const SPSearchCore *core, const uint8_t *word, size_t length, void (^block)(uint32_t termID, BOOL exact))
+{
+    const uint8_t *arena = core->arena.data;
+    size_t offset = 0;
+
+    while (offset < core->arena.size) {
+        const uint8_t *match = memmem(arena + offset, core->arena.size - offset, word, length);
+        if (!match) {
+            return;
+        }
+
+        uint32_t termID = SPSearchCoreTermAtOffset(core, match - arena);
+        const SPSearchTerm *term = &core->terms[termID];
+
+        block(termID, term->length == length);
+        offset = term->offset + term->length + 1;
+    }
+}
+
+// Sets the bits of the live documents with a word containing another, and adds up the rarity of the matching words
+// and how often they appear to their scores
+static void SPSearchCoreMatchWord(const SPSearchCore *core, const uint8_t *word, size_t length, uint64_t *bits, float *scores)
+{
+    SPSearchCoreEnumerateTerms(core, word, length, ^(uint32_t termID, BOOL exact) {
+        const SPSearchTerm *term = &core->terms[termID];
+        if (!term->documents) {
+            return;
+        }
+
+        float weight = logf(1.0f + (float)core->liveCount / term->documents) * (exact ? 2.0f : 1.0f);
+        const uint8_t *bytes = term->postings.data;
+        const uint8_t *end = bytes + term->postings.size;
+        uint32_t ordinal = 0;
+
+        while (bytes < end) {
+            uint32_t delta, frequency;
+            bytes = SPSearchReadVarint(bytes, &delta);
+            bytes = SPSearchReadVarint(bytes, &frequency);
+            ordinal += delta;
+
+            if (core->documents[ordinal].key) {
+                if (bits) {
+                    bits[ordinal >> 6] |= 1ull << (ordinal & 63);
+                }
+                if (scores) {
+                    scores[ordinal] += weight * (1.0f + logf((float)frequency));
+                }
+            }
+
+            ordinal++;
+        }
+    });
+}
+
+static size_t SPSearchCountBits(const uint64_t *bits, size_t count)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += __builtin_popcountll(bits[i]);
+    }
+
+    return total;
+}
+
+// Keeps the bits of the documents containing a keyword of three bytes or more. The postings of its rarest trigrams
+// narrow the candidates down, until checking the text of the few left is cheaper than reading more postings.
+static void SPSearchCoreMatchKeyword(const SPSearchCore *core, const uint8_t *keyword, size_t length, uint64_t *bits, uint64_t *scratch)
+{
+    size_t bitCount = ((size_t)core->documentCount + 63) / 64;
+    uint32_t gramCount;
+    uint32_t *grams = SPSearchCreateGrams(keyword, length, &gramCount);
+
+    for (uint32_t i = 0; i < gramCount; i++) {
+        grams[i] = SPSearchCoreGramID((SPSearchCore *)core, grams[i], NO);
+        if (grams[i] == UINT32_MAX) {
+            memset(bits, 0, bitCount * sizeof(uint64_t));
+            free(grams);
+            return;
+        }
+    }
+
+    // Rarest first: keywords only have a handful of trigrams
+    for (uint32_t i = 1; i < gramCount; i++) {
+        for (uint32_t j = i; j > 0 && core->grams[grams[j]].postings.size < core->grams[grams[j - 1]].postings.size; j--) {
+            uint32_t gramID = grams[j];
+            grams[j] = grams[j - 1];
+            grams[j - 1] = gramID;
+        }
+    }
+
+    size_t candidates = SPSearchCountBits(bits, bitCount);
+
+    for (uint32_t i = 0; i < gramCount && candidates; i++) {
+        const SPSearchGram *gram = &core->grams[grams[i]];
+        if (candidates * 8 < gram->postings.size) {
+            break;
+        }
+
+        const uint8_t *bytes = gram->postings.data;
+        const uint8_t *end = bytes + gram->postings.size;
+        uint32_t ordinal = 0;
+
+        memset(scratch, 0, bitCount * sizeof(uint64_t));
+        while (bytes < end) {
+            uint32_t delta;
+            bytes = SPSearchReadVarint(bytes, &delta);
+            ordinal += delta;
+            scratch[ordinal >> 6] |= 1ull << (ordinal & 63);
+            ordinal++;
+        }
+
+        for (size_t j = 0; j < bitCount; j++) {
+            bits[j] &= scratch[j];
+        }
+
+        candidates = SPSearchCountBits(bits, bitCount);
+    }
+
+    free(grams);
+
+    // Trigrams don't tell where they appear: the candidates must contain the whole keyword
+    for (size_t i = 0; i < bitCount; i++) {
+        for (uint64_t word = bits[i]; word; word &= word - 1) {
+            uint32_t ordinal = (uint32_t)(i * 64 + __builtin_ctzll(word));
+            const SPSearchDocument *document = &core->documents[ordinal];
+
+            if (!memmem(document->text.data, document->text.size, keyword, length)) {
+                bits[i] &= ~(1ull << (ordinal & 63));
+            }
+        }
+    }
+}
+
+static BOOL SPSearchDocumentHasTags(const SPSearchDocument *document, const SPSearchBytes *tags)
+{
+    size_t offset = 0;
+    size_t length;
+    const uint8_t *tag;
+
+    while ((tag = SPSearchNextString(tags, &offset, &length))) {
+        size_t documentOffset = 0;
+        size_t documentLength;
+        const uint8_t *documentTag;
+        BOOL found = NO;
+
+        while (!found && (documentTag = SPSearchNextString(&document->tags, &documentOffset, &documentLength))) {
+            found = memmem(documentTag, documentLength, tag, length) != NULL;
+        }
+
+        if (!found) {
+            return NO;
+        }
+    }
+
+    return YES;
+}
+
+// Sets the bits of the live documents matching every criteria: keywords within their text, the words of shorter
+// keywords within their words, and tags within their tags. Scores, when wanted, rank them.
+static void SPSearchCoreMatch(const SPSearchCore *core, const SPSearchCriteria *criteria, uint64_t *bits, float *scores)
+{
+    size_t bitCount = ((size_t)core->documentCount + 63) / 64;
+    uint64_t *scratch = calloc(bitCount + 1, sizeof(uint64_t));
+    size_t offset;
+    size_t length;
+    const uint8_t *string;
+
+    for (uint32_t ordinal = 0; ordinal < core->documentCount; ordinal++) {
+        if (core->documents[ordinal].key) {
+            bits[ordinal >> 6] |= 1ull << (ordinal & 63);
+        }
+    }
+
+    offset = 0;
+    while ((string = SPSearchNextString(&criteria->words, &offset, &length))) {
+        memset(scratch, 0, bitCount * sizeof(uint64_t));
+        SPSearchCoreMatchWord(core, string, length, scratch, NULL);
+
+        for (size_t i = 0; i < bitCount; i++) {
+            bits[i] &= scratch[i];
+        }
+    }
+
+    offset = 0;
+    while ((string = SPSearchNextString(&criteria->keywords, &offset, &length))) {
+        SPSearchCoreMatchKeyword(core, string, length, bits, scratch);
+    }
+
+    offset = 0;
+    while (scores && (string = SPSearchNextString(&criteria->rankedWords, &offset, &length))) {
+        SPSearchCoreMatchWord(core, string, length, NULL, scores);
+    }
+
+    free(scratch);
+
+    if (!criteria->tags.size) {
+        return;
+    }
+
+    for (uint32_t ordinal = 0; ordinal < core->documentCount; ordinal++) {
+        uint64_t mask = 1ull << (ordinal & 63);
+        if ((bits[ordinal >> 6] & mask) && !SPSearchDocumentHasTags(&core->documents[ordinal], &criteria->tags)) {
+            bits[ordinal >> 6] &= ~mask;
+        }
+    }
+}
+
+// Checks a single document, the same way as SPSearchCoreMatch
+static BOOL SPSearchCoreDocumentMatches(const SPSearchCore *core, uint32_t ordinal, const SPSearchCriteria *criteria)
+{
+    const SPSearchDocument *document = &core->documents[ordinal];
+    if (!document->key) {
+        return NO;
+    }
+
+    size_t offset = 0;
+    size_t length;
+    const uint8_t *string;
+
+    while ((string = SPSearchNextString(&criteria->words, &offset, &length))) {
+        const uint8_t *bytes = document->terms.data;
+        const uint8_t *end = bytes + document->terms.size;
+        uint32_t termID = 0;
+        BOOL found = NO;
+
+        while (bytes < end && !found) {
+            uint32_t delta, frequency;
+            bytes = SPSearchReadVarint(bytes, &delta);
+            bytes = SPSearchReadVarint(bytes, &frequency);
+            termID += delta;
+
+            const SPSearchTerm *term = &core->terms[termID];
+            found = memmem(core->arena.data + term->offset, term->length, string, length) != NULL;
+        }
+
+        if (!found) {
+            return NO;
+        }
+    }
+
+    offset = 0;
+    while ((string = SPSearchNextString(&criteria->keywords, &offset, &length))) {
+        if (!memmem(document->text.data, document->text.size, string, length)) {
+            return NO;
+        }
+    }
+
+    return SPSearchDocumentHasTags(document, &criteria->tags);
+}
+
+static void SPSearchCriteriaFree(SPSearchCriteria *criteria)
+{
+    SPSearchBytesFree(&criteria->keywords);
+    SPSearchBytesFree(&criteria->words);
+    SPSearchBytesFree(&criteria->rankedWords);
+    SPSearchBytesFree(&criteria->tags);
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark Folding
+#pragma mark ================================================================================
+
+// Folds a text the way a [cd] predicate compares it
+static NSString *SPSearchFoldedString(NSString *text)
+{
+    NSMutableString *folded = [text mutableCopy];
+    CFStringFold((__bridge CFMutableStringRef)folded, kCFCompareCaseInsensitive | kCFCompareDiacriticInsensitive | kCFCompareWidthInsensitive, NULL);
+
+    return folded;
+}
+
+static void SPSearchAppendUTF8(SPSearchBytes *bytes, NSString *text)
+{
+    NSUInteger length = [text lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    SPSearchBytesReserve(bytes, length);
+
+    NSUInteger used = 0;
+    [text getBytes:bytes->data + bytes->size
+         maxLength:length
+        usedLength:&used
+          encoding:NSUTF8StringEncoding
+           options:0
+             range:NSMakeRange(0, text.length)
+    remainingRange:NULL];
+
+    bytes->size += used;
+}
+
+static BOOL SPSearchIsWordCharacter(UniChar character)
+{
+    static CFCharacterSetRef alphanumerics;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        alphanumerics = CFCharacterSetGetPredefined(kCFCharacterSetAlphaNumeric);
+    });
+
+    if (character < 0x80) {
+        return (character >= '0' && character <= '9') || (character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z');
+    }
+
+    return CFStringIsSurrogateHighCharacter(character) ||
+           CFStringIsSurrogateLowCharacter(character) ||
+           CFCharacterSetIsCharacterMember(alphanumerics, character);
+}
+
+// Appends the words of a folded text as UTF-8, each followed by a NUL. Letters and digits make up words, anything
+// else separates them. Words shorter than a minimum length, in bytes, are left out.
+static void SPSearchAppendWords(SPSearchBytes *words, NSString *folded, size_t minimumLength)
+{
+    CFStringRef string = (__bridge CFStringRef)folded;
+    CFIndex length = CFStringGetLength(string);
+    CFStringInlineBuffer buffer;
+    CFStringInitInlineBuffer(string, &buffer, CFRangeMake(0, length));
+
+    size_t start = words->size;
+
+    for (CFIndex i = 0; i <= length; i++) {
+        UniChar character = i < length ? CFStringGetCharacterFromInlineBuffer(&buffer, i) : 0;
+
+        if (i < length && SPSearchIsWordCharacter(character)) {
+            uint32_t scalar = character;
+            if (CFStringIsSurrogateHighCharacter(character) && i + 1 < length) {
+                UniChar low = CFStringGetCharacterFromInlineBuffer(&buffer, i + 1);
+                if (CFStringIsSurrogateLowCharacter(low)) {
+                    scalar = CFStringGetLongCharacterForSurrogatePair(character, low);
+                    i++;
+                }
+            }
+
+            SPSearchBytesAppendScalar(words, scalar);
+            continue;
+        }
+
+        if (words->size == start) {
+            continue;
+        }
+
+        if (words->size - start < minimumLength) {
+            words->size = start;
+        } else {
+            SPSearchBytesAppend(words, "", 1);
+            start = words->size;
+        }
+    }
+}
+
+static void SPSearchAppendTags(SPSearchBytes *bytes, NSArray<NSString *> *tags)
+{
+    for (NSString *tag in tags) {
+        SPSearchAppendUTF8(bytes, SPSearchFoldedString(tag));
+        SPSearchBytesAppend(bytes, "", 1);
+    }
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark SPSearchQuery
+#pragma mark ================================================================================
+
+// Criteria of a search, kept around by predicates checking the notes indexed after them
+@interface SPSearchQuery : NSObject
+{
+@public
+    SPSearchCriteria _criteria;
+}
+
+@property (nonatomic, readonly) BOOL narrowsDown;
+
+@end
+
+@implementation SPSearchQuery
+
+- (instancetype)initWithKeywords:(NSArray<NSString *> *)keywords tags:(NSArray<NSString *> *)tags
+{
+    self = [super init];
+    if (self) {
+        for (NSString *keyword in keywords) {
+            NSString *folded = SPSearchFoldedString(keyword);
+            size_t start = _criteria.keywords.size;
+
+            SPSearchAppendUTF8(&_criteria.keywords, folded);
+            if (_criteria.keywords.size - start < SPSearchIndexMinimumKeywordLength) {
+                _criteria.keywords.size = start;
+                SPSearchAppendWords(&_criteria.words, folded, SPSearchIndexMinimumQueryWordLength);
+            } else {
+                SPSearchBytesAppend(&_criteria.keywords, "", 1);
+            }
+
+            SPSearchAppendWords(&_criteria.rankedWords, folded, SPSearchIndexMinimumQueryWordLength);
+        }
+        SPSearchAppendTags(&_criteria.tags, tags);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    SPSearchCriteriaFree(&_criteria);
+}
+
+- (BOOL)narrowsDown
+{
+    return _criteria.keywords.size > 0 || _criteria.words.size > 0 || _criteria.tags.size > 0;
+}
+
+@end
+
+
+
+#pragma mark ================================================================================
+#pragma mark Private
+#pragma mark ================================================================================
+
+@interface SPSearchIndex ()
+{
+    SPSearchCore _core;
+}
+
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *>               *ordinalsByKey;
+@property (atomic, assign) NSUInteger                                                   generation;
+
+@end
+
+
+
+#pragma mark ================================================================================
+#pragma mark SPSearchIndex
+#pragma mark ================================================================================
+
+@implementation SPSearchIndex
+
++ (SPSearchIndex *)sharedIndex
+{
+    static SPSearchIndex *index;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        index = [SPSearchIndex new];
+        index.ready = NO;
+    });
+
+    return index;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _ordinalsByKey = [NSMutableDictionary dictionary];
+        _ready = YES;
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    SPSearchCoreFree(&_core);
+}
+
+- (NSUInteger)count
+{
+    @synchronized (self) {
+        return _core.liveCount;
+    }
+}
+
+
+#pragma mark - Indexing
+
+- (void)indexNote:(SPIndexedNote *)note
+{
+    [self indexNoteWithKey:note.key content:note.content tags:note.tags];
+}
+
+- (void)indexNoteWithKey:(NSString *)key content:(NSString *)content tags:(NSArray<NSString *> *)tags
+{
+    // Folding and splitting, by far the longest part, doesn't need the lock
+    SPSearchBytes words = { 0 };
+    SPSearchBytes text = { 0 };
+    SPSearchBytes foldedTags = { 0 };
+
+    if ([content isKindOfClass:[NSString class]]) {
+        NSString *folded = SPSearchFoldedString(content);
+        SPSearchAppendWords(&words, folded, 0);
+        SPSearchAppendUTF8(&text, folded);
+    }
+    SPSearchAppendTags(&foldedTags, tags);
+
+    @synchronized (self) {
+        [self removeDocumentWithKey:key];
+
+        uint32_t ordinal = SPSearchCoreAddDocument(&_core, (__bridge CFStringRef)key, &words, &text, &foldedTags);
+        self.ordinalsByKey[key] = @(ordinal);
+
+        [self compactIfNeeded];
+        self.generation += 1;
+    }
+
+    SPSearchBytesFree(&words);
+    SPSearchBytesFree(&text);
+    SPSearchBytesFree(&foldedTags);
+}
+
+- (void)removeNoteWithKey:(NSString *)key
+{
+    @synchronized (self) {
+        [self removeDocumentWithKey:key];
+        self.generation += 1;
+    }
+}
+
+- (void)removeAllNotes
+{
+    @synchronized (self) {
+        [self.ordinalsByKey removeAllObjects];
+        SPSearchCoreFree(&_core);
+        self.generation += 1;
+    }
+}
+
+- (void)removeDocumentWithKey:(NSString *)key
+{
+    NSNumber *ordinal = self.ordinalsByKey[key];
+    if (!ordinal) {
+        return;
+    }
+
+    SPSearchCoreRemoveDocument(&_core, ordinal.unsignedIntValue);
+    [self.ordinalsByKey removeObjectForKey:key];
+}
+
+- (void)compactIfNeeded
+{
+    uint32_t dropped = _core.documentCount - _core.liveCount;
+    if (dropped < SPSearchIndexMinimumCompaction || dropped < _core.liveCount) {
+        return;
+    }
+
+    SPSearchCoreCompact(&_core);
+
+    [self.ordinalsByKey removeAllObjects];
+    for (uint32_t ordinal = 0; ordinal < _core.documentCount; ordinal++) {
+        self.ordinalsByKey[(__bridge NSString *)_core.documents[ordinal].key] = @(ordinal);
+    }
+}
+
+
+#pragma mark - Searching
+
+- (NSArray<NSString *> *)keysForNotesMatchingKeywords:(NSArray<NSString *> *)keywords tags:(NSArray<NSString *> *)tags
+{
+    SPSearchQuery *query = [[SPSearchQuery alloc] initWithKeywords:keywords tags:tags];
+
+    @synchronized (self) {
+        uint32_t count = _core.documentCount;
+        uint64_t *bits = calloc((count + 63) / 64 + 1, sizeof(uint64_t));
+        float *scores = calloc(count + 1, sizeof(float));
+        uint32_t *ordinals = malloc((count + 1) * sizeof(uint32_t));
+        uint32_t matches = 0;
+
+        SPSearchCoreMatch(&_core, &query->_criteria, bits, scores);
+
+        for (uint32_t ordinal = 0; ordinal < count; ordinal++) {
+            if (bits[ordinal >> 6] & (1ull << (ordinal & 63))) {
+                ordinals[matches++] = ordinal;
+            }
+        }
+
+        // Best scores first, then the notes indexed last
+        qsort_b(ordinals, matches, sizeof(uint32_t), ^int(const void *lhs, const void *rhs) {
+            uint32_t left = *(const uint32_t *)lhs;
+            uint32_t right = *(const uint32_t *)rhs;
+
+            if (scores[left] != scores[right]) {
+                return scores[left] > scores[right] ? -1 : 1;
+            }
+
+            return left > right ? -1 : 1;
+        });
+
+        NSMutableArray<NSString *> *keys = [NSMutableArray arrayWithCapacity:matches];
+        for (uint32_t i = 0; i < matches; i++) {
+            [keys addObject:(__bridge NSString *)_core.documents[ordinals[i]].key];
+        }
+
+        free(bits);
+        free(scores);
+        free(ordinals);
+
+        return keys;
+    }
+}
+
+- (NSPredicate *)predicateForNotesMatchingKeywords:(NSArray<NSString *> *)keywords tags:(NSArray<NSString *> *)tags
+{
+    if (!self.ready) {
+        return nil;
+    }
+
+    SPSearchQuery *query = [[SPSearchQuery alloc] initWithKeywords:keywords tags:tags];
+    if (!query.narrowsDown) {
+        return nil;
+    }
+
+    NSMutableSet<NSString *> *candidates = [NSMutableSet set];
+    NSUInteger generation;
+
+    @synchronized (self) {
+        uint32_t count = _core.documentCount;
+        uint64_t *bits = calloc((count + 63) / 64 + 1, sizeof(uint64_t));
+
+        SPSearchCoreMatch(&_core, &query->_criteria, bits, NULL);
+
+        for (uint32_t ordinal = 0; ordinal < count; ordinal++) {
+            if (bits[ordinal >> 6] & (1ull << (ordinal & 63))) {
+                [candidates addObject:(__bridge NSString *)_core.documents[ordinal].key];
+            }
+        }
+
+        free(bits);
+        generation = self.generation;
+    }
+
+    // Notes saved since the candidates were gathered can't be told from them
+    __weak SPSearchIndex *weakSelf = self;
+    return [SPNoteIndexer predicateForNotesPassingTest:^BOOL(NSString *key) {
+        if ([candidates containsObject:key]) {
+            return YES;
+        }
+
+        SPSearchIndex *index = weakSelf;
+        if (!index) {
+            return YES;
+        }
+
+        return [index noteWithKey:key mayMatchQuery:query sinceGeneration:generation];
+    }];
+}
+
+- (BOOL)noteWithKey:(NSString *)key mayMatchQuery:(SPSearchQuery *)query sinceGeneration:(NSUInteger)generation
+{
+    @synchronized (self) {
+        // Notes the index doesn't know about can't be ruled out, however old the candidates are
+        NSNumber *ordinal = self.ordinalsByKey[key];
+        if (!ordinal) {
+            return YES;
+        }
+
+        if (self.generation == generation) {
+            return NO;
+        }
+
+        return SPSearchCoreDocumentMatches(&_core, ordinal.unsignedIntValue, &query->_criteria);
+    }
+}
+
+@end
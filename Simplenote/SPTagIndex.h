@@ -0,0 +1,64 @@
+//
+//  SPTagIndex.h
+//  Simplenote
+//
+
+#import <Foundation/Foundation.h>
+#import "SPNoteIndexer.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  @class      SPTagIndex
+ *  @brief      In-memory index of the tags of the notes: tag names are folded and numbered, and each one keeps the
+ *              ordinals of its notes in a compressed bitset. Filtering by tags, finding untagged notes, and counting
+ *              them don't need to read the notes.
+ *              Notes in the trash are left out.
+ */
+@interface SPTagIndex : NSObject <SPNoteIndex>
+
+/// Index of the notes in the app's store, once added to the shared indexer
+///
+@property (class, nonatomic, readonly) SPTagIndex *sharedIndex NS_SWIFT_NAME(shared);
+
+/// Indicates if every note has been indexed: until then, filters aren't narrowed down
+///
+@property (atomic, assign, getter=isReady) BOOL ready;
+
+/// Number of indexed notes, in the trash or not
+///
+@property (nonatomic, readonly) NSUInteger count;
+
+/// Indexes the tags of a note, replacing whatever was indexed for its key
+///
+- (void)indexNoteWithKey:(NSString *)key tags:(nullable NSArray<NSString *> *)tags deleted:(BOOL)deleted;
+
+/// Returns the number of notes with a tag, disregarding case and diacritics
+///
+- (NSUInteger)numberOfNotesWithTag:(NSString *)tag;
+
+/// Returns the number of notes without tags
+///
+- (NSUInteger)numberOfUntaggedNotes;
+
+/// Returns the keys of the notes with every tag
+///
+- (NSArray<NSString *> *)keysForNotesWithTags:(NSArray<NSString *> *)tags;
+
+/// Returns the keys of the notes without tags
+///
+- (NSArray<NSString *> *)keysForUntaggedNotes;
+
+/// Returns a predicate letting through the notes with a tag, along with the notes the index hasn't caught up with,
+/// or nil until it's ready. The tag predicate must still follow it, after the one leaving the trash out.
+///
+- (nullable NSPredicate *)predicateForNotesWithTag:(NSString *)tag;
+
+/// Returns a predicate letting through the notes without tags, along with the notes the index hasn't caught up with,
+/// or nil until it's ready. The untagged predicate must still follow it, after the one leaving the trash out.
+///
+- (nullable NSPredicate *)predicateForUntaggedNotes;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,617 @@
+//
+//  SPTagIndex.m
+//  Simplenote
+//
+
+#import "SPTagIndex.h"
+
+#include <string.h>
+
+
+
+#pragma mark ================================================================================
+#pragma mark Constants
+#pragma mark ================================================================================
+
+// Containers listing more ordinals than this take less room as bitmaps
+static const uint32_t SPTagArrayContainerLimit = 4096;
+
+// A bitmap container covers 65536 ordinals
+static const uint32_t SPTagBitmapWords = 1024;
+
+
+
+#pragma mark ================================================================================
+#pragma mark Bitsets
+#pragma mark ================================================================================
+
+// Roaring bitsets: ordinals are split by their upper 16 bits into containers, each one listing the lower 16 bits of its
+// ordinals as a sorted array while there are few of them, and as a bitmap once there are many.
+typedef struct {
+    uint16_t high;
+    uint32_t cardinality;
+    uint32_t arrayCapacity;
+    uint16_t *array;
+    uint64_t *bitmap;
+} SPTagContainer;
+
+typedef struct {
+    SPTagContainer *containers;     // Sorted by their upper bits
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t cardinality;
+} SPTagBitset;
+
+// Position of the container for some upper bits, or where it would be inserted
+static uint32_t SPTagBitsetContainerPosition(const SPTagBitset *set, uint16_t high, BOOL *found)
+{
+    uint32_t lower = 0;
+    uint32_t upper = set->count;
+
+    while (lower < upper) {
+        uint32_t middle = lower + (upper - lower) / 2;
+        if (set->containers[middle].high < high) {
+            lower = middle + 1;
+        } else {
+            upper = middle;
+        }
+    }
+
+    *found = lower < set->count && set->containers[lower].high == high;
+    return lower;
+}
+
+static uint32_t SPTagContainerArrayPosition(const SPTagContainer *container, uint16_t low, BOOL *found)
+{
+    uint32_t lower = 0;
+    uint32_t upper = container->cardinality;
+
+    while (lower < upper) {
+        uint32_t middle = lower + (upper - lower) / 2;
+        if (container->array[middle] < low) {
+            lower = middle + 1;
+        } else {
+            upper = middle;
+        }
+    }
+
+    *found = lower < container->cardinality && container->array[lower] == low;
+    return lower;
+}
+
+static void SPTagContainerConvertToBitmap(SPTagContainer *container)
+{
+    container->bitmap = calloc(SPTagBitmapWords, sizeof(uint64_t));
+    for (uint32_t i = 0; i < container->cardinality; i++) {
+        container->bitmap[container->array[i] >> 6] |= 1ull << (container->array[i] & 63);
+    }
+
+    free(container->array);
+    container->array = NULL;
+    container->arrayCapacity = 0;
+}
+
+static void SPTagContainerConvertToArray(SPTagContainer *container)
+{
+    container->arrayCapacity = container->cardinality;
+    container->array = malloc(MAX(container->arrayCapacity, 1) * sizeof(uint16_t));
+
+    uint32_t count = 0;
+    for (uint32_t word = 0; word < SPTagBitmapWords; word++) {
+        uint64_t bits = container->bitmap[word];
+        while (bits) {
+            container->array[count++] = (uint16_t)(word * 64 + __builtin_ctzll(bits));
+            bits &= bits - 1;
+        }
+    }
+
+    free(container->bitmap);
+    container->bitmap = NULL;
+}
+
+static BOOL SPTagBitsetContains(const SPTagBitset *set, uint32_t ordinal)
+{
+    BOOL found;
+    uint32_t position = SPTagBitsetContainerPosition(set, (uint16_t)(ordinal >> 16), &found);
+    if (!found) {
+        return NO;
+    }
+
+    const SPTagContainer *container = &set->containers[position];
+    uint16_t low = (uint16_t)ordinal;
+
+    if (container->bitmap) {
+        return (container->bitmap[low >> 6] >> (low & 63)) & 1;
+    }
+
+    SPTagContainerArrayPosition(container, low, &found);
+    return found;
+}
+
+static void SPTagBitsetAdd(SPTagBitset *set, uint32_t ordinal)
+{
+    BOOL found;
+    uint32_t position = SPTagBitsetContainerPosition(set, (uint16_t)(ordinal >> 16), &found);
+
+    if (!found) {
+        if (set->count == set->capacity) {
+            set->capacity = set->capacity ? set->capacity * 2 : 1;
+            set->containers = realloc(set->containers, set->capacity * sizeof(SPTagContainer));
+        }
+
+        memmove(set->containers + position + 1, set->containers + position, (set->count - position) * sizeof(SPTagContainer));
+        memset(&set->containers[position], 0, sizeof(SPTagContainer));
+        set->containers[position].high = (uint16_t)(ordinal >> 16);
+        set->count += 1;
+    }
+
+    SPTagContainer *container = &set->containers[position];
+    uint16_t low = (uint16_t)ordinal;
+
+    if (!container->bitmap) {
+        uint32_t index = SPTagContainerArrayPosition(container, low, &found);
+        if (found) {
+            return;
+        }
+
+        if (container->cardinality < SPTagArrayContainerLimit) {
+            if (container->cardinality == container->arrayCapacity) {
+                container->arrayCapacity = container->arrayCapacity ? container->arrayCapacity * 2 : 4;
+                container->array = realloc(container->array, container->arrayCapacity * sizeof(uint16_t));
+            }
+
+            memmove(container->array + index + 1, container->array + index, (container->cardinality - index) * sizeof(uint16_t));
+            container->array[index] = low;
+            container->cardinality += 1;
+            set->cardinality += 1;
+            return;
+        }
+
+        SPTagContainerConvertToBitmap(container);
+    }
+
+    uint64_t bit = 1ull << (low & 63);
+    if (container->bitmap[low >> 6] & bit) {
+        return;
+    }
+
+    container->bitmap[low >> 6] |= bit;
+    container->cardinality += 1;
+    set->cardinality += 1;
+}
+
+static void SPTagBitsetRemove(SPTagBitset *set, uint32_t ordinal)
+{
+    BOOL found;
+    uint32_t position = SPTagBitsetContainerPosition(set, (uint16_t)(ordinal >> 16), &found);
+    if (!found) {
+        return;
+    }
+
+    SPTagContainer *container = &set->containers[position];
+    uint16_t low = (uint16_t)ordinal;
+
+    if (container->bitmap) {
+        uint64_t bit = 1ull << (low & 63);
+        if (!(container->bitmap[low >> 6] & bit)) {
+            return;
+        }
+
+        container->bitmap[low >> 6] &= ~bit;
+        container->cardinality -= 1;
+
+        if (container->cardinality <= SPTagArrayContainerLimit) {
+            SPTagContainerConvertToArray(container);
+        }
+    } else {
+        uint32_t index = SPTagContainerArrayPosition(container, low, &found);
+        if (!found) {
+            return;
+        }
+
+        memmove(container->array + index, container->array + index + 1, (container->cardinality - index - 1) * sizeof(uint16_t));
+        container->cardinality -= 1;
+    }
+
+    set->cardinality -= 1;
+
+    if (container->cardinality == 0) {
+        free(container->array);
+        memmove(set->containers + position, set->containers + position + 1, (set->count - position - 1) * sizeof(SPTagContainer));
+        set->count -= 1;
+    }
+}
+
+// Writes every ordinal in the set, in ascending order, and returns how many there are
+static uint32_t SPTagBitsetCopyOrdinals(const SPTagBitset *set, uint32_t *ordinals)
+{
+    uint32_t count = 0;
+
+    for (uint32_t position = 0; position < set->count; position++) {
+        const SPTagContainer *container = &set->containers[position];
+        uint32_t high = (uint32_t)container->high << 16;
+
+        if (!container->bitmap) {
+            for (uint32_t i = 0; i < container->cardinality; i++) {
+                ordinals[count++] = high | container->array[i];
+            }
+            continue;
+        }
+
+        for (uint32_t word = 0; word < SPTagBitmapWords; word++) {
+            uint64_t bits = container->bitmap[word];
+            while (bits) {
+                ordinals[count++] = high | (word * 64 + __builtin_ctzll(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    return count;
+}
+
+static void SPTagBitsetFree(SPTagBitset *set)
+{
+    for (uint32_t position = 0; position < set->count; position++) {
+        free(set->containers[position].array);
+        free(set->containers[position].bitmap);
+    }
+
+    free(set->containers);
+    memset(set, 0, sizeof(SPTagBitset));
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark Index Core
+#pragma mark ================================================================================
+
+// Each tag, numbered as it's first seen, has the set of notes with it. Notes keep their ordinal as they're indexed
+// again, so that their tags can be updated in place.
+typedef struct {
+    SPTagBitset *tags;
+    uint32_t tagCount;
+    SPTagBitset untagged;
+} SPTagCore;
+
+static SPTagBitset *SPTagCoreBitset(SPTagCore *core, uint32_t tagID)
+{
+    if (tagID >= core->tagCount) {
+        core->tags = realloc(core->tags, (tagID + 1) * sizeof(SPTagBitset));
+        memset(core->tags + core->tagCount, 0, (tagID + 1 - core->tagCount) * sizeof(SPTagBitset));
+        core->tagCount = tagID + 1;
+    }
+
+    return &core->tags[tagID];
+}
+
+// Returns the notes found in every set, smallest set first, as the others are only checked for its ordinals
+static uint32_t SPTagCoreIntersect(const SPTagBitset **sets, uint32_t count, uint32_t **ordinals)
+{
+    uint32_t smallest = 0;
+    for (uint32_t i = 1; i < count; i++) {
+        if (sets[i]->cardinality < sets[smallest]->cardinality) {
+            smallest = i;
+        }
+    }
+
+    *ordinals = malloc(MAX(sets[smallest]->cardinality, 1) * sizeof(uint32_t));
+    uint32_t candidates = SPTagBitsetCopyOrdinals(sets[smallest], *ordinals);
+    uint32_t matches = 0;
+
+    for (uint32_t i = 0; i < candidates; i++) {
+        BOOL everywhere = YES;
+        for (uint32_t j = 0; j < count && everywhere; j++) {
+            everywhere = j == smallest || SPTagBitsetContains(sets[j], (*ordinals)[i]);
+        }
+
+        if (everywhere) {
+            (*ordinals)[matches++] = (*ordinals)[i];
+        }
+    }
+
+    return matches;
+}
+
+static void SPTagCoreFree(SPTagCore *core)
+{
+    for (uint32_t tagID = 0; tagID < core->tagCount; tagID++) {
+        SPTagBitsetFree(&core->tags[tagID]);
+    }
+
+    free(core->tags);
+    SPTagBitsetFree(&core->untagged);
+    memset(core, 0, sizeof(SPTagCore));
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark Folding
+#pragma mark ================================================================================
+
+// Folds a tag name the way a [cd] predicate compares it
+static NSString *SPTagFoldedName(NSString *name)
+{
+    NSMutableString *folded = [name mutableCopy];
+    CFStringFold((__bridge CFMutableStringRef)folded, kCFCompareCaseInsensitive | kCFCompareDiacriticInsensitive | kCFCompareWidthInsensitive, NULL);
+
+    return folded;
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark Private
+#pragma mark ================================================================================
+
+@interface SPTagIndex ()
+{
+    SPTagCore _core;
+}
+
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *>                   *ordinalsByKey;
+@property (nonatomic, strong) NSMutableArray<NSString *>                                    *keysByOrdinal;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSArray<NSNumber *> *>        *tagIDsByKey;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *>                   *tagIDsByName;
+
+@end
+
+
+
+#pragma mark ================================================================================
+#pragma mark SPTagIndex
+#pragma mark ================================================================================
+
+@implementation SPTagIndex
+
++ (SPTagIndex *)sharedIndex
+{
+    static SPTagIndex *index;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        index = [SPTagIndex new];
+        index.ready = NO;
+    });
+
+    return index;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _ordinalsByKey = [NSMutableDictionary dictionary];
+        _keysByOrdinal = [NSMutableArray array];
+        _tagIDsByKey = [NSMutableDictionary dictionary];
+        _tagIDsByName = [NSMutableDictionary dictionary];
+        _ready = YES;
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    SPTagCoreFree(&_core);
+}
+
+- (NSUInteger)count
+{
+    @synchronized (self) {
+        return self.tagIDsByKey.count;
+    }
+}
+
+
+#pragma mark - Indexing
+
+- (void)indexNote:(SPIndexedNote *)note
+{
+    [self indexNoteWithKey:note.key tags:note.tags deleted:note.deleted];
+}
+
+- (void)indexNoteWithKey:(NSString *)key tags:(NSArray<NSString *> *)tags deleted:(BOOL)deleted
+{
+    NSMutableOrderedSet<NSString *> *names = [NSMutableOrderedSet orderedSet];
+    if (!deleted) {
+        for (NSString *tag in tags) {
+            if ([tag isKindOfClass:[NSString class]]) {
+                [names addObject:SPTagFoldedName(tag)];
+            }
+        }
+    }
+
+    @synchronized (self) {
+        NSNumber *ordinal = self.ordinalsByKey[key];
+        if (!ordinal) {
+            ordinal = @(self.keysByOrdinal.count);
+            self.ordinalsByKey[key] = ordinal;
+            [self.keysByOrdinal addObject:key];
+        }
+
+        NSMutableArray<NSNumber *> *tagIDs = [NSMutableArray arrayWithCapacity:names.count];
+        for (NSString *name in names) {
+            NSNumber *tagID = self.tagIDsByName[name];
+            if (!tagID) {
+                tagID = @(self.tagIDsByName.count);
+                self.tagIDsByName[name] = tagID;
+            }
+            [tagIDs addObject:tagID];
+        }
+
+        // Most saves leave the tags alone
+        BOOL wasUntagged = SPTagBitsetContains(&_core.untagged, ordinal.unsignedIntValue);
+        BOOL untagged = tagIDs.count == 0 && !deleted;
+        if ([self.tagIDsByKey[key] isEqualToArray:tagIDs] && wasUntagged == untagged) {
+            return;
+        }
+
+        [self removeTagsOfNoteWithOrdinal:ordinal.unsignedIntValue key:key];
+
+        for (NSNumber *tagID in tagIDs) {
+            SPTagBitsetAdd(SPTagCoreBitset(&_core, tagID.unsignedIntValue), ordinal.unsignedIntValue);
+        }
+
+        if (untagged) {
+            SPTagBitsetAdd(&_core.untagged, ordinal.unsignedIntValue);
+        }
+
+        self.tagIDsByKey[key] = tagIDs;
+    }
+}
+
+- (void)removeNoteWithKey:(NSString *)key
+{
+    @synchronized (self) {
+        NSNumber *ordinal = self.ordinalsByKey[key];
+        if (!ordinal) {
+            return;
+        }
+
+        [self removeTagsOfNoteWithOrdinal:ordinal.unsignedIntValue key:key];
+        [self.tagIDsByKey removeObjectForKey:key];
+    }
+}
+
+- (void)removeAllNotes
+{
+    @synchronized (self) {
+        [self.ordinalsByKey removeAllObjects];
+        [self.keysByOrdinal removeAllObjects];
+        [self.tagIDsByKey removeAllObjects];
+        [self.tagIDsByName removeAllObjects];
+        SPTagCoreFree(&_core);
+    }
+}
+
+- (void)removeTagsOfNoteWithOrdinal:(uint32_t)ordinal key:(NSString *)key
+{
+    for (NSNumber *tagID in self.tagIDsByKey[key]) {
+        SPTagBitsetRemove(SPTagCoreBitset(&_core, tagID.unsignedIntValue), ordinal);
+    }
+
+    SPTagBitsetRemove(&_core.untagged, ordinal);
+}
+
+
+#pragma mark - Looking Up
+
+- (NSUInteger)numberOfNotesWithTag:(NSString *)tag
+{
+    NSString *name = SPTagFoldedName(tag);
+
+    @synchronized (self) {
+        NSNumber *tagID = self.tagIDsByName[name];
+        return tagID ? SPTagCoreBitset(&_core, tagID.unsignedIntValue)->cardinality : 0;
+    }
+}
+
+- (NSUInteger)numberOfUntaggedNotes
+{
+    @synchronized (self) {
+        return _core.untagged.cardinality;
+    }
+}
+
+- (NSArray<NSString *> *)keysForNotesWithTags:(NSArray<NSString *> *)tags
+{
+    if (tags.count == 0) {
+        return @[];
+    }
+
+    @synchronized (self) {
+        uint32_t count = (uint32_t)tags.count;
+        const SPTagBitset **sets = malloc(count * sizeof(SPTagBitset *));
+
+        for (uint32_t i = 0; i < count; i++) {
+            NSNumber *tagID = self.tagIDsByName[SPTagFoldedName(tags[i])];
+            if (!tagID) {
+                free(sets);
+                return @[];
+            }
+
+            sets[i] = SPTagCoreBitset(&_core, tagID.unsignedIntValue);
+        }
+
+        uint32_t *ordinals;
+        uint32_t matches = SPTagCoreIntersect(sets, count, &ordinals);
+
+        NSMutableArray<NSString *> *keys = [NSMutableArray arrayWithCapacity:matches];
+        for (uint32_t i = 0; i < matches; i++) {
+            [keys addObject:self.keysByOrdinal[ordinals[i]]];
+        }
+
+        free(sets);
+        free(ordinals);
+
+        return keys;
+    }
+}
+
+- (NSArray<NSString *> *)keysForUntaggedNotes
+{
+    @synchronized (self) {
+        uint32_t *ordinals = malloc(MAX(_core.untagged.cardinality, 1) * sizeof(uint32_t));
+        uint32_t count = SPTagBitsetCopyOrdinals(&_core.untagged, ordinals);
+
+        NSMutableArray<NSString *> *keys = [NSMutableArray arrayWithCapacity:count];
+        for (uint32_t i = 0; i < count; i++) {
+            [keys addObject:self.keysByOrdinal[ordinals[i]]];
+        }
+
+        free(ordinals);
+
+        return keys;
+    }
+}
+
+- (NSPredicate *)predicateForNotesWithTag:(NSString *)tag
+{
+    if (!self.ready) {
+        return nil;
+    }
+
+    NSString *name = SPTagFoldedName(tag);
+    __weak SPTagIndex *weakSelf = self;
+
+    return [SPNoteIndexer predicateForNotesPassingTest:^BOOL(NSString *key) {
+        SPTagIndex *index = weakSelf;
+        return !index || [index mayNoteWithKey:key matchTagWithName:name];
+    }];
+}
+
+- (NSPredicate *)predicateForUntaggedNotes
+{
+    if (!self.ready) {
+        return nil;
+    }
+
+    __weak SPTagIndex *weakSelf = self;
+
+    return [SPNoteIndexer predicateForNotesPassingTest:^BOOL(NSString *key) {
+        SPTagIndex *index = weakSelf;
+        return !index || [index mayNoteWithKey:key matchTagWithName:nil];
+    }];
+}
+
+// Tags of notes unknown to the index can't be told from it
+- (BOOL)mayNoteWithKey:(NSString *)key matchTagWithName:(nullable NSString *)name
+{
+    @synchronized (self) {
+        NSNumber *ordinal = self.ordinalsByKey[key];
+        if (!ordinal || !self.tagIDsByKey[key]) {
+            return YES;
+        }
+
+        if (!name) {
+            return SPTagBitsetContains(&_core.untagged, ordinal.unsignedIntValue);
+        }
+
+        NSNumber *tagID = self.tagIDsByName[name];
+        return tagID && SPTagBitsetContains(SPTagCoreBitset(&_core, tagID.unsignedIntValue), ordinal.unsignedIntValue);
+    }
+}
+
+@end
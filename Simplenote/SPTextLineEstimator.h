@@ -0,0 +1,45 @@
+//
+//  SPTextLineEstimator.h
+//  Simplenote
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  @class      SPTextLineEstimate
+ *  @brief      Lines a text is expected to take once laid out, and where some of its locations fall.
+ */
+@interface SPTextLineEstimate : NSObject
+
+/// Line of each location, counting from zero, in the order they were given
+///
+@property (nonatomic, copy, readonly) NSArray<NSNumber *> *lines;
+
+/// Lines taken by the whole range
+///
+@property (nonatomic, assign, readonly) NSUInteger lineCount;
+
+@end
+
+
+/**
+ *  @class      SPTextLineEstimator
+ *  @brief      Estimates how a text wraps without laying it out: paragraphs are wrapped at word boundaries once they
+ *              exceed a number of columns, wide characters taking two. A single pass over the text covers every
+ *              location, which makes it cheap enough for notes too long to be laid out at once.
+ */
+@interface SPTextLineEstimator : NSObject
+
+/// Returns the lines taken by a range of a text, and the line where each location falls within it. Locations
+/// before the range fall on its first line, and the ones past it on its last.
+///
++ (SPTextLineEstimate *)estimateLinesOfText:(NSString *)text
+                                    inRange:(NSRange)range
+                                    columns:(CGFloat)columns
+                                  locations:(NSArray<NSNumber *> *)locations NS_SWIFT_NAME(estimateLines(of:in:columns:locations:));
+
+@end
+
+NS_ASSUME_NONNULL_END
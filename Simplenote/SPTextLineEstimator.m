@@ -0,0 +1,192 @@
+//
+//  SPTextLineEstimator.m
+//  Simplenote
+//
+
+#import "SPTextLineEstimator.h"
+
+
+
+#pragma mark ================================================================================
+#pragma mark Constants
+#pragma mark ================================================================================
+
+// Default tab stops are about four characters apart
+static const CGFloat SPTextLineEstimatorTabColumns = 4;
+
+
+
+#pragma mark ================================================================================
+#pragma mark Characters
+#pragma mark ================================================================================
+
+typedef struct {
+    NSUInteger location;
+    NSUInteger index;
+} SPEstimatedLocation;
+
+static int SPCompareEstimatedLocations(const void *lhs, const void *rhs)
+{
+    const SPEstimatedLocation *left = lhs;
+    const SPEstimatedLocation *right = rhs;
+
+    if (left->location != right->location) {
+        return left->location < right->location ? -1 : 1;
+    }
+
+    return left->index < right->index ? -1 : left->index > right->index;
+}
+
+static inline BOOL SPIsLineBreak(UniChar character)
+{
+    return character == '\n' || character == '\r' || character == 0x2028 || character == 0x2029;
+}
+
+// East Asian wide characters take two columns, and lines may wrap right after them
+static inline BOOL SPIsWideCharacter(UniChar character)
+{
+    return (character >= 0x1100 && character <= 0x115F) ||
+           (character >= 0x2E80 && character <= 0xA4CF) ||
+           (character >= 0xAC00 && character <= 0xD7A3) ||
+           (character >= 0xF900 && character <= 0xFAFF) ||
+           (character >= 0xFE30 && character <= 0xFE4F) ||
+           (character >= 0xFF00 && character <= 0xFF60) ||
+           (character >= 0xFFE0 && character <= 0xFFE6);
+}
+
+// Combining marks sit on the previous character. Each surrogate of an emoji takes one column, two in all.
+static inline CGFloat SPColumnsForCharacter(UniChar character)
+{
+    if (character >= 0x0300 && character <= 0x036F) {
+        return 0;
+    }
+
+    return SPIsWideCharacter(character) ? 2 : 1;
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark SPTextLineEstimate
+#pragma mark ================================================================================
+
+@interface SPTextLineEstimate ()
+@property (nonatomic, copy, readwrite) NSArray<NSNumber *> *lines;
+@property (nonatomic, assign, readwrite) NSUInteger lineCount;
+@end
+
+@implementation SPTextLineEstimate
+@end
+
+
+
+#pragma mark ================================================================================
+#pragma mark SPTextLineEstimator
+#pragma mark ================================================================================
+
+@implementation SPTextLineEstimator
+
++ (SPTextLineEstimate *)estimateLinesOfText:(NSString *)text inRange:(NSRange)range columns:(CGFloat)columns locations:(NSArray<NSNumber *> *)locations
+{
+    NSUInteger count = locations.count;
+    SPEstimatedLocation *sorted = malloc(MAX(count, 1) * sizeof(SPEstimatedLocation));
+    NSUInteger *lines = calloc(MAX(count, 1), sizeof(NSUInteger));
+
+    for (NSUInteger i = 0; i < count; i++) {
+        sorted[i].location = locations[i].unsignedIntegerValue;
+        sorted[i].index = i;
+    }
+
+    qsort(sorted, count, sizeof(SPEstimatedLocation), SPCompareEstimatedLocations);
+
+    CFStringInlineBuffer buffer;
+    CFStringInitInlineBuffer((__bridge CFStringRef)text, &buffer, CFRangeMake(range.location, range.length));
+
+    columns = MAX(columns, 1);
+
+    NSUInteger line = 0;
+    CGFloat lineColumns = 0;
+    CGFloat wordColumns = 0;        // Columns of the word being read, which wraps as a whole
+    NSUInteger wordLocation = 0;    // First location falling within that word
+    NSUInteger next = 0;            // First location not reached yet
+    UniChar previous = 0;
+
+    for (NSUInteger i = 0; i < range.length; i++) {
+        NSUInteger firstLocationHere = next;
+        while (next < count && sorted[next].location <= range.location + i) {
+            lines[sorted[next++].index] = line;
+        }
+
+        UniChar character = CFStringGetCharacterFromInlineBuffer(&buffer, i);
+
+        if (SPIsLineBreak(character)) {
+            if (!(character == '\n' && previous == '\r')) {
+                line += 1;
+            }
+            lineColumns = 0;
+            wordColumns = 0;
+            wordLocation = next;
+            previous = character;
+            continue;
+        }
+
+        previous = character;
+
+        // Whitespace ends words, and hangs past the end of the line rather than wrapping
+        if (character == ' ' || character == '\t') {
+            lineColumns += character == '\t' ? SPTextLineEstimatorTabColumns : 1;
+            wordColumns = 0;
+            wordLocation = next;
+            continue;
+        }
+
+        CGFloat characterColumns = SPColumnsForCharacter(character);
+        if (SPIsWideCharacter(character)) {
+            wordColumns = 0;
+            wordLocation = firstLocationHere;
+        }
+
+        lineColumns += characterColumns;
+        wordColumns += characterColumns;
+
+        if (lineColumns <= columns) {
+            continue;
+        }
+
+        // The word moves onto the next line, unless it's the first one there, or too long for any: then it breaks
+        NSUInteger movedLocation = wordLocation;
+        if (wordColumns < lineColumns && wordColumns <= columns) {
+            lineColumns = wordColumns;
+        } else {
+            lineColumns = characterColumns;
+            wordColumns = characterColumns;
+            wordLocation = firstLocationHere;
+            movedLocation = firstLocationHere;
+        }
+
+        line += 1;
+        for (NSUInteger j = movedLocation; j < next; j++) {
+            lines[sorted[j].index] += 1;
+        }
+    }
+
+    while (next < count) {
+        lines[sorted[next++].index] = line;
+    }
+
+    NSMutableArray<NSNumber *> *estimatedLines = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        [estimatedLines addObject:@(lines[i])];
+    }
+
+    free(sorted);
+    free(lines);
+
+    SPTextLineEstimate *estimate = [SPTextLineEstimate new];
+    estimate.lines = estimatedLines;
+    estimate.lineCount = range.length > 0 ? line + 1 : 0;
+
+    return estimate;
+}
+
+@end
@@ -140,7 +140,23 @@ extension SPTextView {
     /// Returns position relative to the total text container height.
     /// Position value is from 0 to 1
     ///
+    /// Laying out a long note in full takes a while: text past the part laid out so far gets its positions estimated instead,
+    /// and they're refined as the layout catches up, next time they're asked for.
+    ///
     func relativeLocationsForText(in ranges: [NSRange]) -> [CGFloat] {
+        guard let layoutManager = layoutManager, let textStorage = textStorage else {
+            return []
+        }
+
+        let laidOutLength = layoutManager.firstUnlaidCharacterIndex()
+        guard laidOutLength < textStorage.length else {
+            return exactRelativeLocationsForText(in: ranges)
+        }
+
+        return estimatedRelativeLocationsForText(in: ranges, laidOutLength: laidOutLength)
+    }
+
+    private func exactRelativeLocationsForText(in ranges: [NSRange]) -> [CGFloat] {
         let textContainerHeight = textContainerHeightForSearchMap()
         guard textContainerHeight > CGFloat.leastNormalMagnitude else {
             return []
@@ -153,6 +169,59 @@ extension SPTextView {
         }
     }
 
+    /// Ranges within the laid out part keep their exact position. The rest of the note is wrapped by estimate, with the line
+    /// height measured on the laid out part whenever there's enough of it.
+    ///
+    private func estimatedRelativeLocationsForText(in ranges: [NSRange], laidOutLength: Int) -> [CGFloat] {
+        guard let layoutManager = layoutManager,
+              let textContainer = textContainer,
+              let scrollView = enclosingScrollView,
+              let font = typingAttributes[.font] as? NSFont ?? self.font else {
+            return []
+        }
+
+        let estimatedRanges = ranges.filter { $0.upperBound > laidOutLength }
+        let locations = [laidOutLength] + estimatedRanges.map { max($0.location, laidOutLength) }
+        let estimate = SPTextLineEstimator.estimateLines(of: string,
+                                                         in: NSRange(location: 0, length: (string as NSString).length),
+                                                         columns: columnsForSearchMap(in: textContainer, font: font),
+                                                         locations: locations.map { NSNumber(value: $0) })
+
+        let laidOutHeight = laidOutLength > 0 ? layoutManager.usedRect(for: textContainer).height : 0
+        let laidOutLines = estimate.lines.first?.intValue ?? 0
+        let lineHeight = laidOutLines >= Metrics.minimumLinesToMeasure ? laidOutHeight / CGFloat(laidOutLines) : layoutManager.defaultLineHeight(for: font)
+
+        let estimatedHeight = laidOutHeight + CGFloat(estimate.lineCount - laidOutLines) * lineHeight
+        let textContainerHeight = max(estimatedHeight, scrollView.frame.size.height - scrollView.scrollerInsets.top)
+        guard textContainerHeight > CGFloat.leastNormalMagnitude else {
+            return []
+        }
+
+        var estimatedLines = estimate.lines.dropFirst().makeIterator()
+
+        return ranges.map { range in
+            let midY: CGFloat
+            if range.upperBound <= laidOutLength {
+                midY = boundingRect(for: range).midY - textContainerOrigin.y
+            } else {
+                let line = CGFloat((estimatedLines.next()?.intValue ?? laidOutLines) - laidOutLines)
+                midY = laidOutHeight + (line + 0.5) * lineHeight
+            }
+
+            return max(midY / textContainerHeight, CGFloat.leastNormalMagnitude)
+        }
+    }
+
+    /// Average characters fitting on a line
+    ///
+    private func columnsForSearchMap(in textContainer: NSTextContainer, font: NSFont) -> CGFloat {
+        let sampleWidth = (Metrics.sampleText as NSString).size(withAttributes: [.font: font]).width
+        let characterWidth = sampleWidth / CGFloat((Metrics.sampleText as NSString).length)
+        let lineWidth = textContainer.size.width - textContainer.lineFragmentPadding * 2
+
+        return characterWidth > 0 ? lineWidth / characterWidth : 1
+    }
+
     private func textContainerHeightForSearchMap() -> CGFloat {
         guard let layoutManager = layoutManager,
               let textContainer = textContainer,
@@ -160,9 +229,20 @@ extension SPTextView {
             return 0.0
         }
 
-        ensureLayout()
         let textContainerHeight = layoutManager.usedRect(for: textContainer).size.height
         let textContainerMinHeight = scrollView.frame.size.height - scrollView.scrollerInsets.top
         return max(textContainerHeight, textContainerMinHeight)
     }
 }
+
+// MARK: - Metrics
+//
+private enum Metrics {
+    /// Lines of the laid out part needed to measure their height
+    ///
+    static let minimumLinesToMeasure = 10
+
+    /// Text measured to tell the average width of a character
+    ///
+    static let sampleText = "The quick brown fox jumps over the lazy dog, then 0123456789 more."
+}
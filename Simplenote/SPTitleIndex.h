@@ -0,0 +1,44 @@
+//
+//  SPTitleIndex.h
+//  Simplenote
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  @class      SPTitleIndex
+ *  @brief      Keeps note titles folded, disregarding case and diacritics, and sorted: titles starting with a keyword
+ *              are a binary search away, and the ones containing it a single pass over their bytes. Only the best
+ *              few results are ever collected, however many titles there are.
+ *              Meant to be updated as titles change, from a single thread.
+ */
+@interface SPTitleIndex<KeyType> : NSObject
+
+/// Number of titles in the index
+///
+@property (nonatomic, assign, readonly) NSUInteger count;
+
+/// Adds a title, or replaces the one with the same key
+///
+- (void)setTitle:(NSString *)title forKey:(KeyType <NSCopying>)key NS_SWIFT_NAME(setTitle(_:for:));
+
+/// Removes the title with a key, if any
+///
+- (void)removeTitleForKey:(KeyType)key NS_SWIFT_NAME(removeTitle(for:));
+
+/// Removes every title
+///
+- (void)removeAllTitles;
+
+/// Returns the keys of up to `limit` titles containing a keyword, skipping the excluded one: titles starting with the
+/// keyword come first, each group in alphabetical order.
+///
+- (NSArray<KeyType> *)keysForTitlesContainingKeyword:(NSString *)keyword
+                                          excludingKey:(nullable KeyType)excludedKey
+                                                 limit:(NSUInteger)limit NS_SWIFT_NAME(keysForTitles(containing:excluding:limit:));
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,421 @@
+//
+//  SPTitleIndex.m
+//  Simplenote
+//
+
+#import "SPTitleIndex.h"
+
+#include <string.h>
+
+
+
+#pragma mark ================================================================================
+#pragma mark Constants
+#pragma mark ================================================================================
+
+// Replaced and removed titles leave their bytes behind, until they outweigh the live ones
+static const size_t SPTitleIndexMinimumCompaction = 64 * 1024;
+
+
+
+#pragma mark ================================================================================
+#pragma mark Index Core
+#pragma mark ================================================================================
+
+// Folded titles are kept back to back in an arena, each followed by a NUL, in the order they were added: a single
+// pass finds every title containing a keyword, and entries, sharing that order, map the match back to its title.
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+    CFTypeRef key;              // NULL once the title is replaced or removed
+} SPTitleEntry;
+
+typedef struct {
+    char *arena;
+    size_t arenaSize;
+    size_t arenaCapacity;
+    size_t deadBytes;
+
+    SPTitleEntry *entries;
+    uint32_t entryCount;
+    uint32_t entryCapacity;
+
+    uint32_t *sorted;           // Live entries, by folded title
+    uint32_t sortedCount;
+    uint32_t sortedCapacity;
+} SPTitleCore;
+
+static inline const char *SPTitleCoreTitle(const SPTitleCore *core, uint32_t entryID)
+{
+    return core->arena + core->entries[entryID].offset;
+}
+
+// Orders entries by folded title, and by age when titles are the same, so that every entry has a single position
+static int SPTitleCoreCompare(const SPTitleCore *core, uint32_t lhs, uint32_t rhs)
+{
+    const SPTitleEntry *left = &core->entries[lhs];
+    const SPTitleEntry *right = &core->entries[rhs];
+
+    int result = memcmp(SPTitleCoreTitle(core, lhs), SPTitleCoreTitle(core, rhs), MIN(left->length, right->length));
+    if (result != 0) {
+        return result;
+    }
+
+    if (left->length != right->length) {
+        return left->length < right->length ? -1 : 1;
+    }
+
+    return lhs < rhs ? -1 : lhs > rhs;
+}
+
+// Position of the first entry sorted at or after another one
+static uint32_t SPTitleCoreSortedPosition(const SPTitleCore *core, uint32_t entryID)
+{
+    uint32_t lower = 0;
+    uint32_t upper = core->sortedCount;
+
+    while (lower < upper) {
+        uint32_t middle = lower + (upper - lower) / 2;
+        if (SPTitleCoreCompare(core, core->sorted[middle], entryID) < 0) {
+            lower = middle + 1;
+        } else {
+            upper = middle;
+        }
+    }
+
+    return lower;
+}
+
+// Position of the first title not sorting before a keyword: titles starting with it follow from there
+static uint32_t SPTitleCorePrefixPosition(const SPTitleCore *core, const char *keyword, size_t length)
+{
+    uint32_t lower = 0;
+    uint32_t upper = core->sortedCount;
+
+    while (lower < upper) {
+        uint32_t middle = lower + (upper - lower) / 2;
+        const SPTitleEntry *entry = &core->entries[core->sorted[middle]];
+
+        int result = memcmp(SPTitleCoreTitle(core, core->sorted[middle]), keyword, MIN(entry->length, length));
+        if (result < 0 || (result == 0 && entry->length < length)) {
+            lower = middle + 1;
+        } else {
+            upper = middle;
+        }
+    }
+
+    return lower;
+}
+
+static BOOL SPTitleCoreHasPrefix(const SPTitleCore *core, uint32_t entryID, const char *keyword, size_t length)
+{
+    return core->entries[entryID].length >= length && memcmp(SPTitleCoreTitle(core, entryID), keyword, length) == 0;
+}
+
+// Entry whose title holds an arena offset
+static uint32_t SPTitleCoreEntryAtOffset(const SPTitleCore *core, size_t offset)
+{
+    uint32_t lower = 0;
+    uint32_t upper = core->entryCount;
+
+    while (upper - lower > 1) {
+        uint32_t middle = lower + (upper - lower) / 2;
+        if (core->entries[middle].offset <= offset) {
+            lower = middle;
+        } else {
+            upper = middle;
+        }
+    }
+
+    return lower;
+}
+
+static uint32_t SPTitleCoreAddEntry(SPTitleCore *core, CFTypeRef key, const char *title, size_t length)
+{
+    if (core->arenaSize + length + 1 > core->arenaCapacity) {
+        size_t capacity = core->arenaCapacity ? core->arenaCapacity : 4096;
+        while (capacity < core->arenaSize + length + 1) {
+            capacity *= 2;
+        }
+        core->arena = realloc(core->arena, capacity);
+        core->arenaCapacity = capacity;
+    }
+
+    if (core->entryCount == core->entryCapacity) {
+        core->entryCapacity = core->entryCapacity ? core->entryCapacity * 2 : 256;
+        core->entries = realloc(core->entries, core->entryCapacity * sizeof(SPTitleEntry));
+    }
+
+    if (core->sortedCount == core->sortedCapacity) {
+        core->sortedCapacity = core->sortedCapacity ? core->sortedCapacity * 2 : 256;
+        core->sorted = realloc(core->sorted, core->sortedCapacity * sizeof(uint32_t));
+    }
+
+    uint32_t entryID = core->entryCount++;
+    SPTitleEntry *entry = &core->entries[entryID];
+    entry->offset = (uint32_t)core->arenaSize;
+    entry->length = (uint32_t)length;
+    entry->key = CFRetain(key);
+
+    if (length) {
+        memcpy(core->arena + core->arenaSize, title, length);
+    }
+    core->arena[core->arenaSize + length] = '\0';
+    core->arenaSize += length + 1;
+
+    uint32_t position = SPTitleCoreSortedPosition(core, entryID);
+    memmove(core->sorted + position + 1, core->sorted + position, (core->sortedCount - position) * sizeof(uint32_t));
+    core->sorted[position] = entryID;
+    core->sortedCount += 1;
+
+    return entryID;
+}
+
+static void SPTitleCoreRemoveEntry(SPTitleCore *core, uint32_t entryID)
+{
+    SPTitleEntry *entry = &core->entries[entryID];
+    if (!entry->key) {
+        return;
+    }
+
+    uint32_t position = SPTitleCoreSortedPosition(core, entryID);
+    memmove(core->sorted + position, core->sorted + position + 1, (core->sortedCount - position - 1) * sizeof(uint32_t));
+    core->sortedCount -= 1;
+
+    CFRelease(entry->key);
+    entry->key = NULL;
+    core->deadBytes += entry->length + 1;
+}
+
+// Drops the bytes of every removed title. Entries keep their relative order, and are renumbered.
+static void SPTitleCoreCompact(SPTitleCore *core)
+{
+    uint32_t *newIDs = malloc(MAX(core->entryCount, 1) * sizeof(uint32_t));
+    size_t arenaSize = 0;
+    uint32_t entryCount = 0;
+
+    for (uint32_t entryID = 0; entryID < core->entryCount; entryID++) {
+        SPTitleEntry entry = core->entries[entryID];
+        if (!entry.key) {
+            continue;
+        }
+
+        memmove(core->arena + arenaSize, core->arena + entry.offset, entry.length + 1);
+        entry.offset = (uint32_t)arenaSize;
+        arenaSize += entry.length + 1;
+
+        newIDs[entryID] = entryCount;
+        core->entries[entryCount++] = entry;
+    }
+
+    for (uint32_t position = 0; position < core->sortedCount; position++) {
+        core->sorted[position] = newIDs[core->sorted[position]];
+    }
+
+    core->arenaSize = arenaSize;
+    core->entryCount = entryCount;
+    core->deadBytes = 0;
+
+    free(newIDs);
+}
+
+static void SPTitleCoreFree(SPTitleCore *core)
+{
+    for (uint32_t entryID = 0; entryID < core->entryCount; entryID++) {
+        if (core->entries[entryID].key) {
+            CFRelease(core->entries[entryID].key);
+        }
+    }
+
+    free(core->arena);
+    free(core->entries);
+    free(core->sorted);
+    memset(core, 0, sizeof(SPTitleCore));
+}
+
+static BOOL SPTitleCoreIsExcluded(const SPTitleCore *core, uint32_t entryID, CFTypeRef excludedKey)
+{
+    return excludedKey && CFEqual(core->entries[entryID].key, excludedKey);
+}
+
+// Collects up to `limit` entries: titles starting with the keyword first, then the ones containing it elsewhere,
+// keeping only the first few of those, in order, as the arena is scanned.
+static uint32_t SPTitleCoreMatch(const SPTitleCore *core, const char *keyword, size_t length, CFTypeRef excludedKey, uint32_t *matches, uint32_t limit)
+{
+    uint32_t count = 0;
+
+    for (uint32_t position = SPTitleCorePrefixPosition(core, keyword, length);
+         position < core->sortedCount && count < limit && SPTitleCoreHasPrefix(core, core->sorted[position], keyword, length);
+         position++) {
+        if (!SPTitleCoreIsExcluded(core, core->sorted[position], excludedKey)) {
+            matches[count++] = core->sorted[position];
+        }
+    }
+
+    if (count == limit || length == 0) {
+        return count;
+    }
+
+    uint32_t prefixCount = count;
+    const char *arenaEnd = core->arena + core->arenaSize;
+    const char *cursor = core->arena;
+
+    while (cursor < arenaEnd) {
+        const char *found = memmem(cursor, arenaEnd - cursor, keyword, length);
+        if (!found) {
+            break;
+        }
+
+        uint32_t entryID = SPTitleCoreEntryAtOffset(core, found - core->arena);
+        const SPTitleEntry *entry = &core->entries[entryID];
+        cursor = core->arena + entry->offset + entry->length + 1;
+
+        // Titles starting with the keyword were collected already, or didn't make it
+        if (!entry->key || found + length > cursor - 1 || SPTitleCoreHasPrefix(core, entryID, keyword, length) ||
+            SPTitleCoreIsExcluded(core, entryID, excludedKey)) {
+            continue;
+        }
+
+        if (count == limit && SPTitleCoreCompare(core, matches[count - 1], entryID) < 0) {
+            continue;
+        }
+
+        uint32_t position = count < limit ? count++ : count - 1;
+        while (position > prefixCount && SPTitleCoreCompare(core, matches[position - 1], entryID) > 0) {
+            matches[position] = matches[position - 1];
+            position -= 1;
+        }
+        matches[position] = entryID;
+    }
+
+    return count;
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark Folding
+#pragma mark ================================================================================
+
+// Folds a title the way a [cd] predicate compares it
+static NSData *SPTitleFoldedData(NSString *title)
+{
+    NSMutableString *folded = [title mutableCopy];
+    CFStringFold((__bridge CFMutableStringRef)folded, kCFCompareCaseInsensitive | kCFCompareDiacriticInsensitive | kCFCompareWidthInsensitive, NULL);
+
+    return [folded dataUsingEncoding:NSUTF8StringEncoding] ?: [NSData data];
+}
+
+
+
+#pragma mark ================================================================================
+#pragma mark Private
+#pragma mark ================================================================================
+
+@interface SPTitleIndex () {
+    SPTitleCore _core;
+}
+@property (nonatomic, strong) NSMutableDictionary<id, NSNumber *> *entryIDsByKey;
+@end
+
+
+
+#pragma mark ================================================================================
+#pragma mark SPTitleIndex
+#pragma mark ================================================================================
+
+@implementation SPTitleIndex
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _entryIDsByKey = [NSMutableDictionary dictionary];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    SPTitleCoreFree(&_core);
+}
+
+- (NSUInteger)count
+{
+    return _core.sortedCount;
+}
+
+- (void)setTitle:(NSString *)title forKey:(id<NSCopying>)key
+{
+    NSData *folded = SPTitleFoldedData(title);
+    NSNumber *entryID = self.entryIDsByKey[key];
+
+    // Titles often stay the same as the rest of the note changes
+    if (entryID) {
+        const SPTitleEntry *entry = &_core.entries[entryID.unsignedIntValue];
+        if (entry->length == folded.length && memcmp(SPTitleCoreTitle(&_core, entryID.unsignedIntValue), folded.bytes, folded.length) == 0) {
+            return;
+        }
+
+        SPTitleCoreRemoveEntry(&_core, entryID.unsignedIntValue);
+    }
+
+    self.entryIDsByKey[key] = @(SPTitleCoreAddEntry(&_core, (__bridge CFTypeRef)key, folded.bytes, folded.length));
+    [self compactIfNeeded];
+}
+
+- (void)removeTitleForKey:(id)key
+{
+    NSNumber *entryID = self.entryIDsByKey[key];
+    if (!entryID) {
+        return;
+    }
+
+    SPTitleCoreRemoveEntry(&_core, entryID.unsignedIntValue);
+    [self.entryIDsByKey removeObjectForKey:key];
+    [self compactIfNeeded];
+}
+
+- (void)removeAllTitles
+{
+    SPTitleCoreFree(&_core);
+    [self.entryIDsByKey removeAllObjects];
+}
+
+- (NSArray *)keysForTitlesContainingKeyword:(NSString *)keyword excludingKey:(id)excludedKey limit:(NSUInteger)limit
+{
+    NSData *folded = SPTitleFoldedData(keyword);
+    uint32_t capacity = (uint32_t)MIN(limit, (NSUInteger)_core.sortedCount);
+    if (capacity == 0) {
+        return @[];
+    }
+
+    uint32_t *matches = malloc(capacity * sizeof(uint32_t));
+    uint32_t count = SPTitleCoreMatch(&_core, folded.bytes, folded.length, (__bridge CFTypeRef)excludedKey, matches, capacity);
+
+    NSMutableArray *keys = [NSMutableArray arrayWithCapacity:count];
+    for (uint32_t i = 0; i < count; i++) {
+        [keys addObject:(__bridge id)_core.entries[matches[i]].key];
+    }
+
+    free(matches);
+
+    return keys;
+}
+
+- (void)compactIfNeeded
+{
+    if (_core.deadBytes < SPTitleIndexMinimumCompaction || _core.deadBytes < _core.arenaSize - _core.deadBytes) {
+        return;
+    }
+
+    SPTitleCoreCompact(&_core);
+
+    [self.entryIDsByKey removeAllObjects];
+    for (uint32_t entryID = 0; entryID < _core.entryCount; entryID++) {
+        self.entryIDsByKey[(__bridge id)_core.entries[entryID].key] = @(entryID);
+    }
+}
+
+@end
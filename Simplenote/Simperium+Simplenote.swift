@@ -123,10 +123,13 @@ extension Simperium {
             return []
         }
 
-        return notesBucket.objects(ofType: Note.self, for: NSCompoundPredicate(andPredicateWithSubpredicates: [
-            .predicateForNotes(tag: name),
-            .predicateForNotes(deleted: false)
-        ]))
+        let subpredicates: [NSPredicate?] = [
+            .predicateForNotes(deleted: false),
+            SPTagIndex.shared.predicateForNotes(withTag: name),
+            .predicateForNotes(tag: name)
+        ]
+
+        return notesBucket.objects(ofType: Note.self, for: NSCompoundPredicate(andPredicateWithSubpredicates: subpredicates.compactMap { $0 }))
     }
 }
 
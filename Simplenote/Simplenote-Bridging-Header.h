@@ -14,9 +14,18 @@
 #import "AuthViewController.h"
 #import "NoteEditorViewController.h"
 #import "SimplenoteAppDelegate.h"
+#import "SPBacklinkIndex.h"
 #import "SPConstants.h"
+#import "SPJSONStringArray.h"
+#import "SPKeywordMatcher.h"
+#import "SPListDiff.h"
 #import "SPMarkdownParser.h"
+#import "SPNoteIndexer.h"
+#import "SPSearchIndex.h"
 #import "SPTableView.h"
+#import "SPTagIndex.h"
+#import "SPTextLineEstimator.h"
+#import "SPTitleIndex.h"
 #import "SPTracker.h"
 #import "TagListViewController.h"
 #import "Storage.h"
@@ -26,5 +35,6 @@
 
 #import "Simperium+Simplenote.h"
 #import "NSString+Metadata.h"
+#import "NSString+Sorting.h"
 #import "NSNotification+Simplenote.h"
 #import "NSMutableAttributedString+Styling.h"
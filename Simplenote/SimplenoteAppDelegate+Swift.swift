@@ -96,6 +96,15 @@ extension SimplenoteAppDelegate {
         noteEditorMetadataCache = NoteEditorMetadataCache(storage: FileStorage(fileURL: fileURL))
     }
 
+    @objc
+    func configureNoteIndexes() {
+        let indexer = SPNoteIndexer.shared
+        indexer.add(SPSearchIndex.shared)
+        indexer.add(SPBacklinkIndex.shared)
+        indexer.add(SPTagIndex.shared)
+        indexer.startIndexingNotes(in: managedObjectContext)
+    }
+
     @objc
     func configureAccountDeletionController() {
         accountDeletionController = AccountDeletionController()
@@ -14,6 +14,8 @@
 #import "NSNotification+Simplenote.h"
 #import "AuthViewController.h"
 #import "NoteEditorViewController.h"
+#import "SPMarkdownParser.h"
+#import "SPNoteIndexer.h"
 #import "StatusChecker.h"
 #import "SPConstants.h"
 #import "SPTracker.h"
@@ -91,6 +93,7 @@
     [self configureCrashLogging];
 
     [self configureEditorMetadataCache];
+    [self configureNoteIndexes];
     [self configureMainInterface];
     [self configureSplitViewController];
     [self configureMainWindowController];
@@ -251,6 +254,8 @@
     [self.crashLogging clearCachedUser];
 
     [self.noteEditorMetadataCache removeAll];
+    [SPMarkdownParser removeCachedPages];
+    [[SPNoteIndexer sharedIndexer] removeAllNotes];
 }
 
 - (void)simperium:(Simperium *)simperium didFailWithError:(NSError *)error
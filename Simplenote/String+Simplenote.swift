@@ -137,65 +137,17 @@ extension String {
         }
 
         let range = range ?? startIndex..<endIndex
+        let matcher = SPKeywordMatcher.matcher(for: keywords)
 
-        var leadingWordsRange: [Range<String.Index>] = []
-        var matchingWordsRange: [Range<String.Index>] = []
-        var trailingWordsRange: [Range<String.Index>] = []
-
-        enumerateSubstrings(in: range, options: [.byWords, .localized, .substringNotRequired]) { (_, wordRange, _, stop) in
-
-            if trailingLimit > 0, let firstMatch = matchingWordsRange.first {
-                if distance(from: firstMatch.upperBound, to: wordRange.upperBound) > trailingLimit {
-                    stop = true
-                    return
-                }
-
-                trailingWordsRange.append(wordRange)
-            }
-
-            for keyword in keywords {
-                if self.range(of: keyword, options: [.caseInsensitive, .diacriticInsensitive], range: wordRange, locale: Locale.current) != nil {
-                    matchingWordsRange.append(wordRange)
-                    break
-                }
-            }
-
-            if leadingLimit > 0 && matchingWordsRange.isEmpty {
-                leadingWordsRange.append(wordRange)
-            }
-        }
-
-        // No matches => return nil
-        guard let firstMatch = matchingWordsRange.first, let lastMatch = matchingWordsRange.last else {
+        guard let slice = matcher.slice(of: self, in: NSRange(range, in: self), leadingLimit: leadingLimit, trailingLimit: trailingLimit),
+              let sliceRange = Range(slice.range, in: self) else {
             return nil
         }
 
-        let lowerBound: String.Index = {
-            if leadingLimit == 0 {
-                return range.lowerBound
-            }
-
-            let upperBound = firstMatch.lowerBound
-            var lowerBound = upperBound
-
-            for range in leadingWordsRange.reversed() {
-                if distance(from: range.lowerBound, to: upperBound) > leadingLimit {
-                    break
-                }
-
-                lowerBound = range.lowerBound
-            }
-
-            return lowerBound
-        }()
-
-        let upperBound: String.Index = {
-            if trailingLimit == 0 {
-                return range.upperBound
-            }
-            return trailingWordsRange.last?.upperBound ?? lastMatch.upperBound
-        }()
+        let matches = slice.matches.compactMap {
+            Range($0.rangeValue, in: self)
+        }
 
-        return ContentSlice(content: self, range: lowerBound..<upperBound, matches: matchingWordsRange)
+        return ContentSlice(content: self, range: sliceRange, matches: matches)
     }
 }
@@ -0,0 +1,197 @@
+import Foundation
+
+// MARK: - UTF8OffsetIndex
+//     Converts offsets in a text between UTF-8 bytes (Hoextdown, native search) and UTF-16 units (`NSRange`, the editor).
+//     A checkpoint records the UTF-16 offset at the start of every 64 byte block, so a conversion walks at most one block.
+//     Lookups remember their last block, and are meant to be performed from one thread at a time.
+//     Nothing hands the editor UTF-8 ranges yet: search hits and styles are still found on the UTF-16 text. This is
+//     meant for Hoextdown source positions, once the preview maps back to the editor.
+//
+final class UTF8OffsetIndex {
+
+    /// Bytes covered by each checkpoint
+    ///
+    static let blockSize = 64
+
+    /// Indexed text, as UTF-8
+    ///
+    let utf8: [UInt8]
+
+    /// UTF-16 offset at the start of each block, followed by the UTF-16 length of the whole text
+    ///
+    private let checkpoints: [Int]
+
+    /// Block of the last UTF-16 lookup: ranges are mostly converted in ascending order
+    ///
+    private var cursor = 0
+
+    /// Length of the text in UTF-8 bytes
+    ///
+    var utf8Count: Int {
+        utf8.count
+    }
+
+    /// Length of the text in UTF-16 units
+    ///
+    var utf16Count: Int {
+        checkpoints[checkpoints.count - 1]
+    }
+
+    /// Indexes the UTF-8 encoding of a String
+    ///
+    convenience init(_ string: String) {
+        self.init(utf8: Array(string.utf8))
+    }
+
+    /// Indexes UTF-8 encoded bytes
+    ///
+    init(utf8: [UInt8]) {
+        self.utf8 = utf8
+        self.checkpoints = UTF8OffsetIndex.checkpoints(for: utf8)
+    }
+
+    /// Returns the UTF-16 offset of a UTF-8 offset. Offsets within a scalar round up to its end, out of bounds ones are clamped
+    ///
+    func utf16Offset(forUTF8Offset offset: Int) -> Int {
+        let offset = min(max(offset, 0), utf8.count)
+        let block = offset / UTF8OffsetIndex.blockSize
+        var units = checkpoints[block]
+
+        for position in block * UTF8OffsetIndex.blockSize ..< offset {
+            units += UTF8OffsetIndex.utf16Units(of: utf8[position])
+        }
+
+        return units
+    }
+
+    /// Returns the UTF-8 offset of a UTF-16 offset. Offsets within a surrogate pair round up to its end, out of bounds ones are clamped
+    ///
+    func utf8Offset(forUTF16Offset offset: Int) -> Int {
+        let offset = min(max(offset, 0), utf16Count)
+        let block = self.block(containingUTF16Offset: offset)
+        var units = checkpoints[block]
+        var position = block * UTF8OffsetIndex.blockSize
+
+        // The checkpoint already counts a scalar starting in the previous block
+        if block > 0 {
+            position = endOfScalar(from: position)
+        }
+
+        while units < offset, position < utf8.count {
+            units += UTF8OffsetIndex.utf16Units(of: utf8[position])
+            position = endOfScalar(from: position + 1)
+        }
+
+        return position
+    }
+
+    /// Returns the `NSRange` of a UTF-8 range
+    ///
+    func utf16Range(forUTF8Range range: Range<Int>) -> NSRange {
+        let location = utf16Offset(forUTF8Offset: range.lowerBound)
+        let end = utf16Offset(forUTF8Offset: range.upperBound)
+
+        return NSRange(location: location, length: end - location)
+    }
+
+    /// Returns the UTF-8 range of an `NSRange`
+    ///
+    func utf8Range(forUTF16Range range: NSRange) -> Range<Int> {
+        let lowerBound = utf8Offset(forUTF16Offset: range.location)
+        let upperBound = utf8Offset(forUTF16Offset: range.location + range.length)
+
+        return lowerBound ..< max(lowerBound, upperBound)
+    }
+}
+
+
+// MARK: - Private Methods
+//
+private extension UTF8OffsetIndex {
+
+    /// Returns the last block starting at or before a UTF-16 offset
+    ///
+    func block(containingUTF16Offset offset: Int) -> Int {
+        let blockCount = max(checkpoints.count - 1, 1)
+
+        if cursor < blockCount, checkpoints[cursor] <= offset, cursor + 1 == blockCount || checkpoints[cursor + 1] > offset {
+            return cursor
+        }
+
+        var low = 0
+        var high = blockCount - 1
+
+        while low < high {
+            let middle = (low + high + 1) / 2
+            if checkpoints[middle] <= offset {
+                low = middle
+            } else {
+                high = middle - 1
+            }
+        }
+
+        cursor = low
+        return low
+    }
+
+    /// Skips continuation bytes from a given position
+    ///
+    func endOfScalar(from position: Int) -> Int {
+        var position = position
+        while position < utf8.count, utf8[position] & 0xC0 == 0x80 {
+            position += 1
+        }
+
+        return position
+    }
+
+    /// Returns the UTF-16 offsets at the start of every block, counting whole blocks sixty four bytes at a time
+    ///
+    static func checkpoints(for utf8: [UInt8]) -> [Int] {
+        var checkpoints = [Int]()
+        checkpoints.reserveCapacity(utf8.count / blockSize + 2)
+
+        var units = 0
+        utf8.withUnsafeBytes { bytes in
+            var start = 0
+
+            while start + blockSize <= bytes.count {
+                checkpoints.append(units)
+
+                var block = SIMD64<UInt8>()
+                withUnsafeMutableBytes(of: &block) { vector in
+                    vector.copyMemory(from: UnsafeRawBufferPointer(rebasing: bytes[start ..< start + blockSize]))
+                }
+
+                units += utf16Units(in: block)
+                start += blockSize
+            }
+
+            guard start < bytes.count else {
+                return
+            }
+
+            checkpoints.append(units)
+            for byte in bytes[start...] {
+                units += utf16Units(of: byte)
+            }
+        }
+
+        checkpoints.append(units)
+        return checkpoints
+    }
+
+    /// Every byte but a continuation byte starts a scalar, and a four byte scalar takes a surrogate pair
+    ///
+    static func utf16Units(in block: SIMD64<UInt8>) -> Int {
+        let scalars = SIMD64<UInt8>().replacing(with: 1, where: (block & 0xC0) .!= 0x80)
+        let pairs = SIMD64<UInt8>().replacing(with: 1, where: block .>= 0xF0)
+
+        // At most 128, so the byte lanes can't overflow
+        return Int((scalars &+ pairs).wrappedSum())
+    }
+
+    static func utf16Units(of byte: UInt8) -> Int {
+        (byte & 0xC0 != 0x80 ? 1 : 0) + (byte >= 0xF0 ? 1 : 0)
+    }
+}
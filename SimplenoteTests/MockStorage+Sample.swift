@@ -20,6 +20,16 @@ extension MockStorage {
         return note
     }
 
+    /// Inserts a new (Sample) Note with a given Simperium Key, so that the Note Indexes can tell about it once saved
+    ///
+    @discardableResult
+    func insertSampleNote(simperiumKey: String, contents: String = "") -> Note {
+        let note = insertSampleNote(contents: contents)
+        note.simperiumKey = simperiumKey
+
+        return note
+    }
+
     /// Inserts a new (Sample) Tag into the receiver's Main MOC
     ///
     @discardableResult
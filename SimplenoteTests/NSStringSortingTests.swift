@@ -0,0 +1,44 @@
+import XCTest
+@testable import Simplenote
+
+// MARK: - NSString+Sorting Tests
+//
+class NSStringSortingTests: XCTestCase {
+
+    /// Contents covering case, shared prefixes, punctuation between the letter cases, and non-ASCII characters
+    ///
+    private let samples = [
+        "", "a", "A", "ab", "aB", "abc", "Abd", "b", "Z", "_note", "[note", "a_b", "aZ", "a[",
+        "Grocery list\nMilk", "grocery list\nEggs", "grocery lists", "Grocery", "groceries",
+        "Crème brûlée", "Creme", "cre\u{300}me", "Éclair", "eclair", "🍰 Cake", "1. First", "10 Things"
+    ]
+
+    /// Verifies that contents are ordered just like `caseInsensitiveCompare` orders them
+    ///
+    func testContentsAreOrderedLikeCaseInsensitiveCompare() {
+        for lhs in samples {
+            for rhs in samples {
+                let expected = (lhs as NSString).caseInsensitiveCompare(rhs)
+                XCTAssertEqual((lhs as NSString).noteContentCompare(rhs), expected, "\(lhs) <> \(rhs)")
+            }
+        }
+    }
+
+    /// Verifies that the alphabetical sort descriptors keep ordering notes the way they did
+    ///
+    func testSortDescriptorsOrderNotesAlphabetically() {
+        let storage = MockStorage()
+        let notes = samples.map { storage.insertSampleNote(contents: $0) }
+
+        for sortMode in [SortMode.alphabeticallyAscending, .alphabeticallyDescending] {
+            let descriptor = NSSortDescriptor.descriptorForNotes(sortMode: sortMode)
+            let sorted = (notes as NSArray).sortedArray(using: [descriptor]).compactMap { ($0 as? Note)?.content }
+            let expected = samples.sorted { lhs, rhs in
+                let result = (lhs as NSString).caseInsensitiveCompare(rhs)
+                return sortMode == .alphabeticallyAscending ? result == .orderedAscending : result == .orderedDescending
+            }
+
+            XCTAssertEqual(sorted.map { $0.lowercased() }, expected.map { $0.lowercased() })
+        }
+    }
+}
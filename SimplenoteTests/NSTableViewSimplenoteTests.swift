@@ -0,0 +1,88 @@
+import XCTest
+@testable import Simplenote
+
+// MARK: - NSTableView+Simplenote Unit Tests
+//
+class NSTableViewSimplenoteTests: XCTestCase {
+
+    /// TableView!
+    ///
+    private let tableView = NSTableView()
+
+    /// Window keeping the TableView's row views around
+    ///
+    private let window = NSWindow(contentRect: NSRect(x: .zero, y: .zero, width: 200, height: 1000),
+                                  styleMask: [.borderless],
+                                  backing: .buffered,
+                                  defer: false)
+
+    /// Rows displayed by the TableView
+    ///
+    private var rows = [String]()
+
+    // MARK: - Overridden Methods
+
+    override func setUp() {
+        super.setUp()
+        tableView.addTableColumn(NSTableColumn(identifier: NSUserInterfaceItemIdentifier("row")))
+        tableView.dataSource = self
+        tableView.delegate = self
+
+        let scrollView = NSScrollView(frame: window.contentLayoutRect)
+        scrollView.documentView = tableView
+        window.contentView = scrollView
+    }
+
+    /// Verifies that reversing the rows takes several moves, each one applied to the rows left by the previous one
+    ///
+    func testPerformBatchChangesReversesRows() {
+        assertBatchChanges(from: ["a", "b", "c"], to: ["c", "b", "a"])
+    }
+
+    /// Verifies that deletions, insertions and moves mixed together leave every row in its new place
+    ///
+    func testPerformBatchChangesDeletesInsertsAndMovesRows() {
+        assertBatchChanges(from: ["a", "b", "c", "d", "e", "f"], to: ["f", "x", "c", "a", "y", "e", "b"])
+        assertBatchChanges(from: ["x", "a", "b", "c"], to: ["a", "b", "c", "x"])
+    }
+}
+
+// MARK: - NSTableViewDataSource + NSTableViewDelegate
+//
+extension NSTableViewSimplenoteTests: NSTableViewDataSource, NSTableViewDelegate {
+
+    func numberOfRows(in tableView: NSTableView) -> Int {
+        rows.count
+    }
+
+    func tableView(_ tableView: NSTableView, viewFor tableColumn: NSTableColumn?, row: Int) -> NSView? {
+        NSTextField(labelWithString: rows[row])
+    }
+}
+
+// MARK: - Private Methods
+//
+private extension NSTableViewSimplenoteTests {
+
+    /// Displays the old rows, then applies the Diff to the new ones: the row views of the objects found in both lists are
+    /// moved rather than made again, so they only read right when every move landed where it should
+    ///
+    func assertBatchChanges(from oldRows: [String], to newRows: [String]) {
+        rows = oldRows
+        tableView.reloadData()
+        XCTAssertEqual(displayedRows(), oldRows)
+
+        rows = newRows
+        tableView.performBatchChanges(listDiff: SPListDiff(oldObjects: oldRows as [NSString], newObjects: newRows as [NSString]))
+        XCTAssertEqual(displayedRows(), newRows)
+    }
+
+    /// Returns the text of every row view
+    ///
+    func displayedRows() -> [String] {
+        (0 ..< tableView.numberOfRows).map { row in
+            let label = tableView.view(atColumn: .zero, row: row, makeIfNecessary: true) as? NSTextField
+            return label?.stringValue ?? ""
+        }
+    }
+}
@@ -16,7 +16,9 @@ class NoteListControllerTests: XCTestCase {
 
     override func setUp() {
         super.setUp()
-        noteListController = NoteListController(viewContext: storage.viewContext)
+        noteListController = NoteListController(viewContext: storage.viewContext,
+                                                searchIndex: unreadyIndex(SPSearchIndex()),
+                                                tagIndex: unreadyIndex(SPTagIndex()))
         noteListController.performFetch()
     }
 }
@@ -96,6 +98,26 @@ extension NoteListControllerTests {
             XCTAssertEqual(note.content, reversedNotes[index].content)
         }
     }
+
+    /// Verifies that applying a new Filter and SortMode relays the minimal changes between the old and new results
+    ///
+    func testPerformFetchWithFilterAndSortModeReturnsMinimalChanges() {
+        storage.insertSampleNote(contents: "A")
+        storage.insertSampleNote(contents: "B").setTagsFromList(["tag"])
+        storage.insertSampleNote(contents: "C").setTagsFromList(["tag"])
+        storage.save()
+
+        let sortDiff = noteListController.performFetch(filter: .everything, sortMode: .alphabeticallyDescending)
+        XCTAssertTrue(sortDiff.deletedIndexes.isEmpty)
+        XCTAssertTrue(sortDiff.insertedIndexes.isEmpty)
+        XCTAssertEqual(sortDiff.numberOfMoves, 2)
+
+        let filterDiff = noteListController.performFetch(filter: .tag(name: "tag"), sortMode: .alphabeticallyDescending)
+        XCTAssertEqual(filterDiff.deletedIndexes, IndexSet([2]))
+        XCTAssertTrue(filterDiff.insertedIndexes.isEmpty)
+        XCTAssertEqual(filterDiff.numberOfMoves, .zero)
+        XCTAssertEqual(noteListController.notes.map { $0.content }, ["C", "B"])
+    }
 }
 
 // MARK: - Tests: Search
@@ -416,4 +438,11 @@ private extension NoteListControllerTests {
             expectation.fulfill()
         }
     }
+
+    /// Returns an index which isn't ready, so that the shared ones, whatever their state, can't get in the way
+    ///
+    func unreadyIndex<T: SPNoteIndex>(_ index: T) -> T {
+        index.isReady = false
+        return index
+    }
 }
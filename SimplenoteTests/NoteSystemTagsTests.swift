@@ -0,0 +1,44 @@
+import XCTest
+@testable import Simplenote
+
+// MARK: - Note System Tags Tests
+//
+class NoteSystemTagsTests: XCTestCase {
+
+    /// InMemory Storage!
+    ///
+    private let storage = MockStorage()
+
+    /// Verifies that pretty printed System Tags are read and edited in place
+    ///
+    func testPrettyPrintedSystemTagsAreEditedInPlace() {
+        let note = storage.insertSampleNote()
+        note.systemTags = "[\n  \"markdown\"\n]"
+        XCTAssertTrue(note.markdown)
+        XCTAssertFalse(note.pinned)
+
+        note.pinned = true
+        XCTAssertTrue(note.pinned)
+        XCTAssertTrue(note.markdown)
+
+        note.markdown = false
+        XCTAssertEqual(note.systemTags, #"["pinned"]"#)
+    }
+
+    /// Verifies that System Tags the codec turns down are still read and edited, rather than lost or left behind
+    ///
+    func testSystemTagsRejectedByTheCodecFallBackToParsing() {
+        let note = storage.insertSampleNote()
+        note.systemTags = #"["markdown", 1]"#
+        XCTAssertTrue(note.markdown)
+        XCTAssertFalse(note.pinned)
+
+        note.pinned = true
+        XCTAssertTrue(note.pinned)
+        XCTAssertTrue(note.markdown)
+
+        note.markdown = false
+        XCTAssertTrue(note.pinned)
+        XCTAssertEqual(note.systemTags, #"[1,"pinned"]"#)
+    }
+}
@@ -0,0 +1,77 @@
+import XCTest
+@testable import Simplenote
+
+// MARK: - SPBacklinkIndex Tests
+//
+class SPBacklinkIndexTests: XCTestCase {
+
+    /// Index holding three notes linking to each other
+    ///
+    private var index: SPBacklinkIndex!
+
+    // MARK: - Overridden Methods
+
+    override func setUp() {
+        super.setUp()
+        index = SPBacklinkIndex()
+        index.indexNote(withKey: "groceries", content: "Grocery list\nSee [Recipes](simplenote://note/recipes)")
+        index.indexNote(withKey: "recipes", content: "Recipes\n[Pancakes](simplenote://note/pancakes), and the [list](simplenote://note/groceries)")
+        index.indexNote(withKey: "pancakes", content: "Pancakes\nBack to simplenote://note/recipes.")
+    }
+
+    /// Verifies that references are found in links and plain text alike, in any case but the key's, without duplicates
+    ///
+    func testKeysAreFoundInLinksAndPlainText() {
+        let text = "[A](simplenote://note/abc-123) SIMPLENOTE://Note/XyZ. simplenote://note/abc-123 mysimplenote://note/nope"
+        XCTAssertEqual(SPBacklinkIndex.keysLinked(fromText: text), ["abc-123", "XyZ"])
+    }
+
+    /// Verifies that other links, and references without a key, are skipped
+    ///
+    func testOtherLinksAreSkipped() {
+        let text = "https://note/abc simplenote://notes/abc simplenote://note/ simplenote:/note/abc"
+        XCTAssertEqual(SPBacklinkIndex.keysLinked(fromText: text), [])
+    }
+
+    /// Verifies that both the links from a note, and the ones to it, are looked up
+    ///
+    func testLinksAreLookedUpBothWays() {
+        XCTAssertEqual(index.keysForNotes(linkedFrom: "recipes"), ["pancakes", "groceries"])
+        XCTAssertEqual(Set(index.keysForNotes(linkingTo: "recipes")), ["groceries", "pancakes"])
+        XCTAssertEqual(index.keysForNotes(linkingTo: "groceries"), ["recipes"])
+        XCTAssertEqual(index.keysForNotes(linkingTo: "unknown"), [])
+    }
+
+    /// Verifies that indexing a note again replaces its links, and that removed notes no longer link anywhere
+    ///
+    func testIndexingAgainReplacesLinksAndRemovingDropsThem() {
+        index.indexNote(withKey: "pancakes", content: "Pancakes\nNo links")
+        XCTAssertEqual(index.keysForNotes(linkingTo: "recipes"), ["groceries"])
+
+        index.removeNote(withKey: "groceries")
+        XCTAssertEqual(index.keysForNotes(linkingTo: "recipes"), [])
+        XCTAssertEqual(index.keysForNotes(linkingTo: "groceries"), ["recipes"])
+
+        index.removeAllNotes()
+        XCTAssertEqual(index.keysForNotes(linkedFrom: "recipes"), [])
+        XCTAssertEqual(index.keysForNotes(linkingTo: "groceries"), [])
+    }
+
+    /// Verifies that the predicate looks indexed notes up, and scans the ones the index doesn't know about
+    ///
+    func testPredicateLooksUpIndexedNotesAndScansUnknownOnes() {
+        let storage = MockStorage()
+        let pancakes = storage.insertSampleNote(simperiumKey: "pancakes", contents: "Pancakes")
+        let unknown = storage.insertSampleNote(contents: "Link to simplenote://note/recipes")
+        let unrelated = storage.insertSampleNote(contents: "Nothing to see here")
+        storage.save()
+
+        let predicate = index.predicateForNotes(linkingTo: "recipes")
+        XCTAssertTrue(predicate.evaluate(with: pancakes))
+        XCTAssertTrue(predicate.evaluate(with: unknown))
+        XCTAssertFalse(predicate.evaluate(with: unrelated))
+
+        index.indexNote(withKey: "pancakes", content: "Pancakes")
+        XCTAssertFalse(predicate.evaluate(with: pancakes))
+    }
+}
@@ -0,0 +1,97 @@
+import XCTest
+@testable import Simplenote
+
+// MARK: - SPJSONStringArray Tests
+//
+class SPJSONStringArrayTests: XCTestCase {
+
+    /// Strings needing most kinds of escapes
+    ///
+    private let samples = ["Home", "", "Quote \" and \\ back", "a/b", "Tab\tNew\nLine\r", "Crème 🍰"]
+
+    /// Verifies that arrays are read, whatever their whitespace
+    ///
+    func testArraysAreReadWhateverTheirWhitespace() {
+        XCTAssertEqual(SPJSONStringArray.array(fromJSONString: "[]"), [])
+        XCTAssertEqual(SPJSONStringArray.array(fromJSONString: " [ ] "), [])
+        XCTAssertEqual(SPJSONStringArray.array(fromJSONString: "[\"a\",\"b\"]"), ["a", "b"])
+        XCTAssertEqual(SPJSONStringArray.array(fromJSONString: "[\n  \"a\",\n  \"b\"\n]"), ["a", "b"])
+    }
+
+    /// Verifies that escapes are decoded, surrogate pairs included
+    ///
+    func testEscapesAreDecoded() {
+        let json = #"["\"\\\/\b\f\n\r\t", "\u00e9\u00C9", "\ud83c\udf70"]"#
+        XCTAssertEqual(SPJSONStringArray.array(fromJSONString: json), ["\"\\/\u{8}\u{C}\n\r\t", "éÉ", "🍰"])
+    }
+
+    /// Verifies that anything other than a flat array of strings is rejected
+    ///
+    func testAnythingElseIsRejected() {
+        for json in ["", "{}", "[1]", "[\"a\",]", "[\"a\" \"b\"]", "[\"a\"]x", "[\"a", "[\"\\q\"]", "[\"\\u12\"]", "[[\"a\"]]"] {
+            XCTAssertNil(SPJSONStringArray.array(fromJSONString: json), json)
+        }
+    }
+
+    /// Verifies that arrays are written the way NSJSONSerialization writes them
+    ///
+    func testArraysAreWrittenLikeJSONSerialization() throws {
+        let json = try XCTUnwrap(SPJSONStringArray.jsonString(from: samples))
+        let expected = String(data: try JSONSerialization.data(withJSONObject: samples), encoding: .utf8)
+
+        XCTAssertEqual(json, expected)
+        XCTAssertEqual(SPJSONStringArray.array(fromJSONString: json), samples)
+    }
+
+    /// Verifies that other control characters are escaped as code units, and read back
+    ///
+    func testControlCharactersAreEscaped() throws {
+        let json = try XCTUnwrap(SPJSONStringArray.jsonString(from: ["\u{1}\u{8}\u{1F}"]))
+
+        XCTAssertEqual(json, #"["\u0001\b\u001f"]"#)
+        XCTAssertEqual(SPJSONStringArray.array(fromJSONString: json), ["\u{1}\u{8}\u{1F}"])
+    }
+
+    /// Verifies that strings are found whether they're escaped or not
+    ///
+    func testStringsAreFoundWhetherEscapedOrNot() {
+        let json = #"["pinned","mark\u0064own"]"#
+
+        XCTAssertTrue(SPJSONStringArray.jsonString(json, contains: "pinned"))
+        XCTAssertTrue(SPJSONStringArray.jsonString(json, contains: "markdown"))
+        XCTAssertFalse(SPJSONStringArray.jsonString(json, contains: "pin"))
+        XCTAssertFalse(SPJSONStringArray.jsonString("[\"pinned\"", contains: "pinned"))
+    }
+
+    /// Verifies that appending keeps the array as it is, and escapes the new string
+    ///
+    func testAppendingKeepsTheArrayAsItIs() {
+        XCTAssertEqual(SPJSONStringArray.jsonString("[]", byAppending: "a/b"), #"["a\/b"]"#)
+        XCTAssertEqual(SPJSONStringArray.jsonString("[\n  \"a\"\n]", byAppending: "b"), "[\n  \"a\"\n,\"b\"]")
+        XCTAssertNil(SPJSONStringArray.jsonString("[\"a\",]", byAppending: "b"))
+    }
+
+    /// Verifies that removing drops every matching element, and leaves the others untouched
+    ///
+    func testRemovingDropsEveryMatchingElement() {
+        let json = #"["a", "b\/c", "a", "d"]"#
+
+        XCTAssertEqual(SPJSONStringArray.jsonString(json, byRemoving: "a"), #"["b\/c","d"]"#)
+        XCTAssertEqual(SPJSONStringArray.jsonString(json, byRemoving: "b/c"), #"["a","a","d"]"#)
+        XCTAssertEqual(SPJSONStringArray.jsonString(json, byRemoving: "z"), json)
+        XCTAssertNil(SPJSONStringArray.jsonString("[1]", byRemoving: "a"))
+    }
+
+    /// Verifies that precomposed and decomposed spellings of a string match, as they do with `compare:`
+    ///
+    func testCanonicallyEquivalentStringsMatch() {
+        let precomposed = "caf\u{E9}"
+        let decomposed = "cafe\u{301}"
+        let json = "[\"\(decomposed)\", \"cafe\\u0301\", \"tea\"]"
+
+        XCTAssertTrue(SPJSONStringArray.jsonString(json, contains: precomposed))
+        XCTAssertTrue(SPJSONStringArray.jsonString(#"["caf\u00e9"]"#, contains: decomposed))
+        XCTAssertEqual(SPJSONStringArray.jsonString(json, byRemoving: precomposed), #"["tea"]"#)
+        XCTAssertEqual(SPJSONStringArray.jsonString("[\"\(precomposed)\"]", byRemoving: decomposed), "[]")
+    }
+}
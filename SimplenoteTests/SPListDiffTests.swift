@@ -0,0 +1,112 @@
+import XCTest
+@testable import Simplenote
+
+// MARK: - SPListDiff Tests
+//
+class SPListDiffTests: XCTestCase {
+
+    /// Verifies that identical lists have no changes
+    ///
+    func testIdenticalListsHaveNoChanges() {
+        let diff = SPListDiff<NSString>(oldObjects: ["a", "b", "c"], newObjects: ["a", "b", "c"])
+
+        XCTAssertFalse(diff.hasChanges)
+        XCTAssertEqual(diff.numberOfMoves, .zero)
+    }
+
+    /// Verifies that deletions refer to the old list, and insertions to the new one
+    ///
+    func testDeletionsAndInsertionsReferToTheirOwnLists() {
+        let diff = SPListDiff<NSString>(oldObjects: ["a", "b", "c"], newObjects: ["x", "a", "c", "y"])
+
+        XCTAssertEqual(diff.deletedIndexes, IndexSet([1]))
+        XCTAssertEqual(diff.insertedIndexes, IndexSet([0, 3]))
+        XCTAssertEqual(diff.numberOfMoves, .zero)
+    }
+
+    /// Verifies that only the objects out of the longest ordered run are moved
+    ///
+    func testOnlyObjectsOutOfOrderAreMoved() {
+        let diff = SPListDiff<NSString>(oldObjects: ["a", "b", "c", "d", "e"], newObjects: ["a", "c", "f", "b", "e"])
+
+        XCTAssertEqual(diff.deletedIndexes, IndexSet([3]))
+        XCTAssertEqual(diff.insertedIndexes, IndexSet([2]))
+        XCTAssertEqual(moves(in: diff), [[2, 1]])
+    }
+
+    /// Verifies that reversing a list moves all but one object
+    ///
+    func testReversingMovesAllButOneObject() {
+        let objects = (0..<1000).map { NSString(string: "note-\($0)") }
+        let diff = SPListDiff<NSString>(oldObjects: objects, newObjects: objects.reversed())
+
+        XCTAssertTrue(diff.deletedIndexes.isEmpty)
+        XCTAssertTrue(diff.insertedIndexes.isEmpty)
+        XCTAssertEqual(diff.numberOfMoves, objects.count - 1)
+    }
+
+    /// Verifies that repeated objects are matched once
+    ///
+    func testRepeatedObjectsAreMatchedOnce() {
+        let diff = SPListDiff<NSString>(oldObjects: ["a", "a", "b"], newObjects: ["b", "a", "b"])
+
+        XCTAssertEqual(diff.deletedIndexes, IndexSet([1]))
+        XCTAssertEqual(diff.insertedIndexes, IndexSet([2]))
+        XCTAssertEqual(diff.numberOfMoves, 1)
+    }
+
+    /// Verifies that the steps, taken one after the other once the deleted objects are gone, turn the old list into the
+    /// new one
+    ///
+    func testStepsTurnTheOldListIntoTheNewOne() {
+        let samples: [([NSString], [NSString])] = [
+            (["a", "b", "c"], ["c", "b", "a"]),
+            (["x", "a", "b", "c"], ["a", "b", "c", "x"]),
+            (["a", "b", "c", "d", "e", "f"], ["f", "x", "c", "a", "y", "e", "b"]),
+        ]
+
+        for (oldObjects, newObjects) in samples {
+            let diff = SPListDiff<NSString>(oldObjects: oldObjects, newObjects: newObjects)
+            var objects = oldObjects.enumerated().filter { !diff.deletedIndexes.contains($0.offset) }.map { $0.element }
+
+            /// Inserted objects aren't named by the steps: the list they land in will tell
+            diff.enumerateSteps { fromIndex, toIndex in
+                let object: NSString = fromIndex == NSNotFound ? "+" : objects.remove(at: fromIndex)
+                objects.insert(object, at: toIndex)
+            }
+
+            let expected = newObjects.enumerated().map { diff.insertedIndexes.contains($0.offset) ? "+" : $0.element }
+            XCTAssertEqual(objects, expected)
+        }
+    }
+
+    /// Verifies that reversing a large list takes a step per move, each one bringing the last row up to its new place
+    ///
+    func testStepsReverseALargeList() {
+        let objects = (0..<50_000).map { NSString(string: "note-\($0)") }
+        let diff = SPListDiff<NSString>(oldObjects: objects, newObjects: objects.reversed())
+        let lastRow = objects.count - 1
+        var steps = [[Int]]()
+
+        diff.enumerateSteps { fromIndex, toIndex in
+            steps.append([fromIndex, toIndex])
+        }
+
+        XCTAssertEqual(steps.count, diff.numberOfMoves)
+        XCTAssertEqual(steps, (0..<lastRow).map { [lastRow, $0] })
+    }
+}
+
+// MARK: - Private Methods
+//
+private extension SPListDiffTests {
+
+    func moves(in diff: SPListDiff<NSString>) -> [[Int]] {
+        var moves = [[Int]]()
+        diff.enumerateMoves { fromIndex, toIndex in
+            moves.append([fromIndex, toIndex])
+        }
+
+        return moves
+    }
+}
@@ -0,0 +1,71 @@
+import XCTest
+@testable import Simplenote
+
+// MARK: - SPNoteIndexer Tests
+//
+class SPNoteIndexerTests: XCTestCase {
+
+    /// Let's launch an actual CoreData testing stack 🤟
+    ///
+    private let storage = MockStorage()
+
+    /// Verifies that the indexes are fed from the store, become ready, and then follow the changes saved to it
+    ///
+    func testIndexesAreFedFromTheStoreAndFollowSaves() {
+        let groceries = storage.insertSampleNote(simperiumKey: "groceries", contents: "Grocery list")
+        groceries.setTagsFromList(["Home"])
+        storage.insertSampleNote(simperiumKey: "meeting", contents: "Meeting notes").setTagsFromList(["Work"])
+        storage.save()
+
+        let indexer = SPNoteIndexer()
+        let index = SPTagIndex()
+        indexer.add(index)
+        XCTAssertFalse(index.isReady)
+
+        indexer.startIndexingNotes(in: storage.viewContext)
+        waitUntil { index.isReady && index.count == 2 }
+        XCTAssertEqual(index.keysForNotes(withTags: ["home"]), ["groceries"])
+
+        groceries.setTagsFromList(["Work"])
+        storage.save()
+        waitUntil { index.numberOfNotes(withTag: "work") == 2 }
+
+        storage.delete(groceries)
+        storage.save()
+        waitUntil { index.numberOfNotes(withTag: "work") == 1 }
+    }
+
+    /// Verifies that the predicate lets through the notes indexes can't tell about, and tests the rest
+    ///
+    func testPredicateLetsThroughUnsavedNotesAndTestsTheRest() {
+        let saved = storage.insertSampleNote(simperiumKey: "saved", contents: "Saved")
+        let unsynced = storage.insertSampleNote(contents: "Not synced yet")
+        storage.save()
+
+        var testedKeys = [String]()
+        let predicate = SPNoteIndexer.predicateForNotesPassingTest { key in
+            testedKeys.append(key)
+            return false
+        }
+
+        XCTAssertFalse(predicate.evaluate(with: saved))
+        XCTAssertTrue(predicate.evaluate(with: unsynced))
+
+        saved.content = "Edited"
+        XCTAssertTrue(predicate.evaluate(with: saved))
+        XCTAssertEqual(testedKeys, ["saved"])
+    }
+}
+
+// MARK: - Private Methods
+//
+private extension SPNoteIndexerTests {
+
+    /// Waits for the indexer to catch up, as it reads the store in the background
+    ///
+    func waitUntil(_ condition: @escaping () -> Bool) {
+        let predicate = NSPredicate { _, _ in condition() }
+        let expectation = XCTNSPredicateExpectation(predicate: predicate, object: nil)
+        wait(for: [expectation], timeout: Constants.expectationTimeout)
+    }
+}
@@ -0,0 +1,131 @@
+import XCTest
+@testable import Simplenote
+
+// MARK: - SPSearchIndex Tests
+//
+class SPSearchIndexTests: XCTestCase {
+
+    /// Index holding a grocery list, meeting notes and a recipe
+    ///
+    private var index: SPSearchIndex!
+
+    // MARK: - Overridden Methods
+
+    override func setUp() {
+        super.setUp()
+        index = SPSearchIndex()
+        index.indexNote(withKey: "groceries", content: "Grocery list: Milk, Eggs and Crème fraîche", tags: ["Home"])
+        index.indexNote(withKey: "meeting", content: "Meeting notes: milestones for the next release", tags: ["Work", "Planning"])
+        index.indexNote(withKey: "recipe", content: "Pancakes: milk, eggs, flour. Whisk the eggs first, then add the milk", tags: ["home", "cooking"])
+    }
+
+    /// Verifies that keywords match anywhere within a word, like the search predicate does
+    ///
+    func testKeywordsMatchWithinWords() {
+        XCTAssertEqual(Set(index.keysForNotes(matchingKeywords: ["ilest"], tags: [])), ["meeting"])
+        XCTAssertEqual(Set(index.keysForNotes(matchingKeywords: ["ilk"], tags: [])), ["groceries", "recipe"])
+    }
+
+    /// Verifies that keywords match across words and punctuation, like part numbers and links
+    ///
+    func testKeywordsMatchAcrossWordsAndPunctuation() {
+        index.indexNote(withKey: "links", content: "Order AB-1234 shipped, see https://example.com/orders/1234", tags: nil)
+
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["b-12"], tags: []), ["links"])
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["ample.com/ord"], tags: []), ["links"])
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["example.org"], tags: []), [])
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["list: milk"], tags: []), ["groceries"])
+    }
+
+    /// Verifies that case and diacritics are disregarded, both in the notes and in the keywords
+    ///
+    func testKeywordsDisregardCaseAndDiacritics() {
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["CREME"], tags: []), ["groceries"])
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["fraîche"], tags: []), ["groceries"])
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["Fraiche"], tags: []), ["groceries"])
+    }
+
+    /// Verifies that notes must contain every keyword
+    ///
+    func testEveryKeywordMustMatch() {
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["milk", "flour"], tags: []), ["recipe"])
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["milk", "release"], tags: []), [])
+    }
+
+    /// Verifies that notes must have every tag
+    ///
+    func testEveryTagMustMatch() {
+        XCTAssertEqual(Set(index.keysForNotes(matchingKeywords: [], tags: ["HOME"])), ["groceries", "recipe"])
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["eggs"], tags: ["home", "cook"]), ["recipe"])
+    }
+
+    /// Verifies that notes where the keywords appear most, as whole words, come first
+    ///
+    func testBestMatchesComeFirst() {
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["milk"], tags: []), ["recipe", "groceries"])
+    }
+
+    /// Verifies that indexing a note again replaces its words, and that removed notes are no longer found
+    ///
+    func testIndexingAgainReplacesNotesAndRemovingDropsThem() {
+        index.indexNote(withKey: "meeting", content: "Cancelled", tags: nil)
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["release"], tags: []), [])
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["cancel"], tags: []), ["meeting"])
+
+        index.removeNote(withKey: "recipe")
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["milk"], tags: []), ["groceries"])
+        XCTAssertEqual(index.count, 2)
+
+        index.removeAllNotes()
+        XCTAssertEqual(index.count, .zero)
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["milk"], tags: []), [])
+    }
+
+    /// Verifies that replacing notes over and over again, which compacts the index, keeps the results intact
+    ///
+    func testResultsSurviveCompaction() {
+        for revision in 0..<3000 {
+            index.indexNote(withKey: "draft", content: "Draft revision \(revision)", tags: nil)
+        }
+
+        XCTAssertEqual(index.count, 4)
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["2999"], tags: []), ["draft"])
+        XCTAssertEqual(index.keysForNotes(matchingKeywords: ["1234"], tags: []), [])
+        XCTAssertEqual(Set(index.keysForNotes(matchingKeywords: ["milk"], tags: [])), ["groceries", "recipe"])
+    }
+
+    /// Verifies that no predicate is returned when nothing narrows the search down
+    ///
+    func testPredicateIsNilWithoutKeywordsOrTags() {
+        XCTAssertNil(index.predicateForNotes(matchingKeywords: [], tags: []))
+        XCTAssertNil(index.predicateForNotes(matchingKeywords: ["a", "!?"], tags: []))
+        XCTAssertNotNil(index.predicateForNotes(matchingKeywords: ["milk"], tags: []))
+    }
+
+    /// Verifies that the predicate lets through candidates, and checks the notes indexed since it was built again
+    ///
+    func testPredicateChecksNotesIndexedSinceAgain() {
+        let storage = MockStorage()
+        let groceries = storage.insertSampleNote(simperiumKey: "groceries", contents: "Grocery list")
+        let meeting = storage.insertSampleNote(simperiumKey: "meeting", contents: "Meeting notes")
+        storage.save()
+
+        let predicate = index.predicateForNotes(matchingKeywords: ["milk"], tags: [])!
+        XCTAssertTrue(predicate.evaluate(with: groceries))
+        XCTAssertFalse(predicate.evaluate(with: meeting))
+
+        index.indexNote(withKey: "meeting", content: "Bring milk", tags: nil)
+        XCTAssertTrue(predicate.evaluate(with: meeting))
+    }
+
+    /// Verifies that the predicate lets through the notes the index doesn't know about, even if nothing was indexed since
+    ///
+    func testPredicateLetsThroughUnknownNotes() {
+        let storage = MockStorage()
+        let unknown = storage.insertSampleNote(simperiumKey: "unknown", contents: "Shopping list")
+        storage.save()
+
+        let predicate = index.predicateForNotes(matchingKeywords: ["milk"], tags: [])!
+        XCTAssertTrue(predicate.evaluate(with: unknown))
+    }
+}
@@ -0,0 +1,101 @@
+import XCTest
+@testable import Simplenote
+
+// MARK: - SPTagIndex Tests
+//
+class SPTagIndexTests: XCTestCase {
+
+    /// Index holding a few tagged notes, an untagged one and a trashed one
+    ///
+    private var index: SPTagIndex!
+
+    // MARK: - Overridden Methods
+
+    override func setUp() {
+        super.setUp()
+        index = SPTagIndex()
+        index.indexNote(withKey: "groceries", tags: ["Home", "Lists"], deleted: false)
+        index.indexNote(withKey: "recipe", tags: ["home", "Cooking"], deleted: false)
+        index.indexNote(withKey: "meeting", tags: ["Work"], deleted: false)
+        index.indexNote(withKey: "journal", tags: [], deleted: false)
+        index.indexNote(withKey: "trashed", tags: ["Home"], deleted: true)
+    }
+
+    /// Verifies that tags are matched disregarding case and diacritics, and that notes in the trash are left out
+    ///
+    func testNotesWithTagDisregardCaseAndTrash() {
+        XCTAssertEqual(Set(index.keysForNotes(withTags: ["HOME"])), ["groceries", "recipe"])
+        XCTAssertEqual(index.numberOfNotes(withTag: "hoMe"), 2)
+        XCTAssertEqual(index.numberOfNotes(withTag: "unknown"), .zero)
+    }
+
+    /// Verifies that notes must have every tag
+    ///
+    func testEveryTagMustMatch() {
+        XCTAssertEqual(index.keysForNotes(withTags: ["home", "cooking"]), ["recipe"])
+        XCTAssertEqual(index.keysForNotes(withTags: ["home", "work"]), [])
+        XCTAssertEqual(index.keysForNotes(withTags: ["home", "unknown"]), [])
+    }
+
+    /// Verifies that untagged notes are found, leaving the trash out
+    ///
+    func testUntaggedNotesLeaveTrashOut() {
+        index.indexNote(withKey: "draft", tags: nil, deleted: true)
+
+        XCTAssertEqual(index.keysForUntaggedNotes(), ["journal"])
+        XCTAssertEqual(index.numberOfUntaggedNotes(), 1)
+    }
+
+    /// Verifies that indexing a note again updates its tags, and that removed notes are no longer found
+    ///
+    func testIndexingAgainUpdatesTagsAndRemovingDropsThem() {
+        index.indexNote(withKey: "journal", tags: ["Home"], deleted: false)
+        index.indexNote(withKey: "groceries", tags: [], deleted: false)
+        XCTAssertEqual(Set(index.keysForNotes(withTags: ["home"])), ["journal", "recipe"])
+        XCTAssertEqual(index.keysForUntaggedNotes(), ["groceries"])
+
+        index.indexNote(withKey: "trashed", tags: ["Home"], deleted: false)
+        XCTAssertEqual(index.numberOfNotes(withTag: "home"), 3)
+
+        index.removeNote(withKey: "recipe")
+        XCTAssertEqual(Set(index.keysForNotes(withTags: ["home"])), ["journal", "trashed"])
+        XCTAssertEqual(index.count, 4)
+
+        index.removeAllNotes()
+        XCTAssertEqual(index.count, .zero)
+        XCTAssertEqual(index.keysForNotes(withTags: ["home"]), [])
+    }
+
+    /// Verifies that large tags, kept as bitmaps, stay intact as notes come and go
+    ///
+    func testLargeTagsSurviveUpdates() {
+        for ordinal in 0..<10000 {
+            index.indexNote(withKey: "note-\(ordinal)", tags: ordinal.isMultiple(of: 2) ? ["Even"] : ["Odd"], deleted: false)
+        }
+
+        for ordinal in stride(from: 0, to: 10000, by: 4) {
+            index.removeNote(withKey: "note-\(ordinal)")
+        }
+
+        XCTAssertEqual(index.numberOfNotes(withTag: "even"), 2500)
+        XCTAssertEqual(index.numberOfNotes(withTag: "odd"), 5000)
+        XCTAssertEqual(index.keysForNotes(withTags: ["even"]).first, "note-2")
+    }
+
+    /// Verifies that the predicates look the tags of saved notes up
+    ///
+    func testPredicatesLookTagsUp() {
+        let storage = MockStorage()
+        let groceries = storage.insertSampleNote(simperiumKey: "groceries", contents: "Grocery list")
+        let meeting = storage.insertSampleNote(simperiumKey: "meeting", contents: "Meeting notes")
+        storage.save()
+
+        let predicate = index.predicateForNotes(withTag: "home")!
+        XCTAssertTrue(predicate.evaluate(with: groceries))
+        XCTAssertFalse(predicate.evaluate(with: meeting))
+
+        index.indexNote(withKey: "meeting", tags: [], deleted: false)
+        XCTAssertTrue(index.predicateForUntaggedNotes()!.evaluate(with: meeting))
+        XCTAssertFalse(index.predicateForUntaggedNotes()!.evaluate(with: groceries))
+    }
+}
@@ -0,0 +1,58 @@
+import XCTest
+@testable import Simplenote
+
+// MARK: - SPTextLineEstimator Tests
+//
+class SPTextLineEstimatorTests: XCTestCase {
+
+    /// Verifies that words wrap as a whole onto the next line
+    ///
+    func testWordsWrapAsAWhole() {
+        let text = "hello world foo bar"
+        let estimate = estimateLines(of: text, columns: 10, locations: ["hello", "world", "foo", "bar"])
+
+        XCTAssertEqual(estimate.lines, [0, 1, 1, 2])
+        XCTAssertEqual(estimate.lineCount, 3)
+    }
+
+    /// Verifies that words longer than a line break anywhere
+    ///
+    func testLongWordsBreakAnywhere() {
+        let text = "abcdefghijklmnopqrstuvwxyz ab"
+        let estimate = estimateLines(of: text, columns: 10, locations: ["k", "u", " ab"])
+
+        XCTAssertEqual(estimate.lines, [1, 2, 2])
+    }
+
+    /// Verifies that every kind of line break starts a new line, and that CRLF counts once
+    ///
+    func testLineBreaksStartNewLines() {
+        let text = "one\ntwo\r\nthree\u{2029}four"
+        let estimate = estimateLines(of: text, columns: 80, locations: ["two", "three", "four"])
+
+        XCTAssertEqual(estimate.lines, [1, 2, 3])
+        XCTAssertEqual(estimate.lineCount, 4)
+    }
+
+    /// Verifies that wide characters take two columns
+    ///
+    func testWideCharactersTakeTwoColumns() {
+        let text = "日本語のノートです"
+        let estimate = estimateLines(of: text, columns: 10, locations: ["ノ", "で"])
+
+        XCTAssertEqual(estimate.lines, [0, 1])
+    }
+}
+
+// MARK: - Private Helpers
+//
+private extension SPTextLineEstimatorTests {
+
+    func estimateLines(of text: String, columns: CGFloat, locations words: [String]) -> (lines: [Int], lineCount: Int) {
+        let nsText = text as NSString
+        let locations = words.map { NSNumber(value: nsText.range(of: $0).location) }
+        let estimate = SPTextLineEstimator.estimateLines(of: text, in: NSRange(location: 0, length: nsText.length), columns: columns, locations: locations)
+
+        return (estimate.lines.map { $0.intValue }, estimate.lineCount)
+    }
+}
@@ -0,0 +1,74 @@
+import XCTest
+@testable import Simplenote
+
+// MARK: - SPTitleIndex Tests
+//
+class SPTitleIndexTests: XCTestCase {
+
+    /// Index under test
+    ///
+    private var index: SPTitleIndex<NSString>!
+
+    // MARK: - Overridden Methods
+
+    override func setUp() {
+        super.setUp()
+        index = SPTitleIndex<NSString>()
+        index.setTitle("Grocery list", for: "groceries" as NSString)
+        index.setTitle("Meeting notes", for: "meeting" as NSString)
+        index.setTitle("Crème brûlée", for: "dessert" as NSString)
+        index.setTitle("Notes about Groceries", for: "about" as NSString)
+        index.setTitle("Shopping: groceries", for: "shopping" as NSString)
+    }
+
+    /// Verifies that titles starting with the keyword come first, then the ones containing it, each group sorted
+    ///
+    func testTitlesStartingWithKeywordComeFirst() {
+        XCTAssertEqual(index.keysForTitles(containing: "groc", excluding: nil, limit: 15), ["groceries", "about", "shopping"])
+        XCTAssertEqual(index.keysForTitles(containing: "notes", excluding: nil, limit: 15), ["about", "meeting"])
+    }
+
+    /// Verifies that case and diacritics are disregarded, both in the titles and in the keyword
+    ///
+    func testKeywordDisregardsCaseAndDiacritics() {
+        XCTAssertEqual(index.keysForTitles(containing: "CREME", excluding: nil, limit: 15), ["dessert"])
+        XCTAssertEqual(index.keysForTitles(containing: "Brûlée", excluding: nil, limit: 15), ["dessert"])
+    }
+
+    /// Verifies that the excluded key is skipped, and that no more than the limit is returned
+    ///
+    func testExcludedKeyIsSkippedAndLimitIsHonored() {
+        XCTAssertEqual(index.keysForTitles(containing: "groc", excluding: "groceries" as NSString, limit: 15), ["about", "shopping"])
+        XCTAssertEqual(index.keysForTitles(containing: "groc", excluding: nil, limit: 2), ["groceries", "about"])
+        XCTAssertEqual(index.keysForTitles(containing: "s", excluding: nil, limit: 0), [])
+    }
+
+    /// Verifies that setting a title again replaces it, and that removed titles are no longer found
+    ///
+    func testSettingAgainReplacesTitlesAndRemovingDropsThem() {
+        index.setTitle("Cancelled", for: "meeting" as NSString)
+        XCTAssertEqual(index.keysForTitles(containing: "meeting", excluding: nil, limit: 15), [])
+        XCTAssertEqual(index.keysForTitles(containing: "cancel", excluding: nil, limit: 15), ["meeting"])
+        XCTAssertEqual(index.count, 5)
+
+        index.removeTitle(for: "shopping" as NSString)
+        XCTAssertEqual(index.keysForTitles(containing: "groc", excluding: nil, limit: 15), ["groceries", "about"])
+        XCTAssertEqual(index.count, 4)
+
+        index.removeAllTitles()
+        XCTAssertEqual(index.count, .zero)
+        XCTAssertEqual(index.keysForTitles(containing: "groc", excluding: nil, limit: 15), [])
+    }
+
+    /// Verifies that replacing titles over and over again, which compacts the index, keeps the results intact
+    ///
+    func testResultsSurviveCompaction() {
+        for revision in 0..<20000 {
+            index.setTitle("Draft revision \(revision)", for: "draft" as NSString)
+        }
+
+        XCTAssertEqual(index.count, 6)
+        XCTAssertEqual(index.keysForTitles(containing: "19999", excluding: nil, limit: 15), ["draft"])
+        XCTAssertEqual(index.keysForTitles(containing: "groc", excluding: nil, limit: 15), ["groceries", "about", "shopping"])
+    }
+}
@@ -49,6 +49,15 @@ class StringContentSliceTests: XCTestCase {
         XCTAssertEqual(actual, expected)
     }
 
+    /// Test that full width characters only match themselves, like a case and diacritic insensitive search does
+    ///
+    func testFullWidthCharactersOnlyMatchThemselves() {
+        let content = "Ｓｉｍｐｌｅｎｏｔｅ and Simplenote"
+
+        XCTAssertEqual(content.contentSlice(matching: ["simplenote"])?.matches, [content.range(of: "Simplenote")!])
+        XCTAssertEqual(content.contentSlice(matching: ["ｓｉｍｐｌｅｎｏｔｅ"])?.matches, [content.range(of: "Ｓｉｍｐｌｅｎｏｔｅ")!])
+    }
+
     /// Test that by providing range matching is limited to that range
     ///
     func testProvidingRangeWillLimitMatching() {
@@ -96,6 +105,27 @@ class StringContentSliceTests: XCTestCase {
         let actual = sample.contentSlice(matching: keywords)
         XCTAssertEqual(actual, expected)
     }
+
+    /// Test that keywords are only matched within words, and that overlapping keywords match a word once
+    ///
+    func testOverlappingKeywordsMatchWordsOnce() {
+        let expected = ContentSlice(content: sample,
+                                    range: sample.fullRange,
+                                    matches: sample.ranges(of: "Simplenote"))
+        let actual = sample.contentSlice(matching: ["simple", "plenote", "note Simplenote"])
+        XCTAssertEqual(actual, expected)
+    }
+
+    /// Test that decomposed diacritics in the content are disregarded too
+    ///
+    func testMatchingDisregardsDecomposedDiacritics() {
+        let content = "Un cafe\u{0301} noir"
+        let expected = ContentSlice(content: content,
+                                    range: content.fullRange,
+                                    matches: [content.range(of: "cafe\u{0301}")!])
+        let actual = content.contentSlice(matching: ["CAFÉ"])
+        XCTAssertEqual(actual, expected)
+    }
 }
 
 private extension String {
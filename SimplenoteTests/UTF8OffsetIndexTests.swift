@@ -0,0 +1,107 @@
+import XCTest
+@testable import Simplenote
+
+// MARK: - UTF8OffsetIndex Tests
+//
+class UTF8OffsetIndexTests: XCTestCase {
+
+    /// Spans several checkpoint blocks, with one to four byte scalars straddling their boundaries
+    ///
+    private let sample = String(repeating: "Plain ascii, naïve café, 日本語のノート, emoji 👩‍💻🎉 and more. ", count: 12)
+
+    /// Verifies that the lengths match the String views
+    ///
+    func testCountsMatchStringViews() {
+        let index = UTF8OffsetIndex(sample)
+
+        XCTAssertEqual(index.utf8Count, sample.utf8.count)
+        XCTAssertEqual(index.utf16Count, (sample as NSString).length)
+    }
+
+    /// Verifies that every scalar boundary converts in both directions
+    ///
+    func testEveryScalarBoundaryConvertsInBothDirections() {
+        let index = UTF8OffsetIndex(sample)
+
+        for (utf8Offset, utf16Offset) in scalarBoundaries(of: sample) {
+            XCTAssertEqual(index.utf16Offset(forUTF8Offset: utf8Offset), utf16Offset)
+            XCTAssertEqual(index.utf8Offset(forUTF16Offset: utf16Offset), utf8Offset)
+        }
+    }
+
+    /// Verifies that lookups in descending order, which can't reuse the last block, convert correctly
+    ///
+    func testDescendingLookupsConvertCorrectly() {
+        let index = UTF8OffsetIndex(sample)
+
+        for (utf8Offset, utf16Offset) in scalarBoundaries(of: sample).reversed() {
+            XCTAssertEqual(index.utf8Offset(forUTF16Offset: utf16Offset), utf8Offset)
+        }
+    }
+
+    /// Verifies that offsets within a scalar round up to its end
+    ///
+    func testOffsetsWithinScalarsRoundUp() {
+        let index = UTF8OffsetIndex("é😀")
+
+        XCTAssertEqual(index.utf16Offset(forUTF8Offset: 1), 1)
+        XCTAssertEqual(index.utf16Offset(forUTF8Offset: 3), 3)
+        XCTAssertEqual(index.utf8Offset(forUTF16Offset: 2), 6)
+    }
+
+    /// Verifies that out of bounds offsets are clamped
+    ///
+    func testOutOfBoundsOffsetsAreClamped() {
+        let index = UTF8OffsetIndex("naïve")
+
+        XCTAssertEqual(index.utf16Offset(forUTF8Offset: -1), 0)
+        XCTAssertEqual(index.utf16Offset(forUTF8Offset: 100), 5)
+        XCTAssertEqual(index.utf8Offset(forUTF16Offset: 100), 6)
+    }
+
+    /// Verifies that an empty text maps everything to zero
+    ///
+    func testEmptyTextMapsToZero() {
+        let index = UTF8OffsetIndex("")
+
+        XCTAssertEqual(index.utf16Count, .zero)
+        XCTAssertEqual(index.utf16Offset(forUTF8Offset: .zero), .zero)
+        XCTAssertEqual(index.utf8Offset(forUTF16Offset: .zero), .zero)
+    }
+
+    /// Verifies that ranges round trip between NSRange and UTF-8
+    ///
+    func testRangesRoundTrip() {
+        let index = UTF8OffsetIndex(sample)
+        let text = sample as NSString
+        let range = text.range(of: "🎉 and", options: .backwards)
+        let stringRange = Range(range, in: sample)!
+
+        let utf8Range = index.utf8Range(forUTF16Range: range)
+        XCTAssertEqual(utf8Range.lowerBound, sample.utf8.distance(from: sample.startIndex, to: stringRange.lowerBound))
+        XCTAssertEqual(utf8Range.upperBound, sample.utf8.distance(from: sample.startIndex, to: stringRange.upperBound))
+        XCTAssertEqual(index.utf16Range(forUTF8Range: utf8Range), range)
+    }
+}
+
+
+// MARK: - Private Methods
+//
+private extension UTF8OffsetIndexTests {
+
+    func scalarBoundaries(of string: String) -> [(utf8: Int, utf16: Int)] {
+        var boundaries = [(utf8: Int, utf16: Int)]()
+        var boundary = string.unicodeScalars.startIndex
+
+        while true {
+            boundaries.append((utf8: string.utf8.distance(from: string.startIndex, to: boundary),
+                               utf16: string.utf16.distance(from: string.startIndex, to: boundary)))
+
+            guard boundary < string.unicodeScalars.endIndex else {
+                return boundaries
+            }
+
+            boundary = string.unicodeScalars.index(after: boundary)
+        }
+    }
+}